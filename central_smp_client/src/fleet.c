@@ -0,0 +1,533 @@
+/** @file
+ *  @brief SMP management fan-out over several connections
+ *
+ * Servers found by the scanner are collected as nodes. A job runs one task
+ * on a number of them: the scheduler connects to pending nodes until every
+ * connection slot is taken, runs the task over the node's own pipeline as
+ * soon as its SMP service is discovered, and disconnects when it is done,
+ * which frees the slot for the next node. Only one connection is created
+ * at a time, as the controller initiates one at a time.
+ *
+ * The Bluetooth callbacks only record what happened; the scheduler work
+ * acts on it, so the node table is only changed under the lock and the
+ * tasks are only started from the system work queue.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <bluetooth/scan.h>
+
+#include <zcbor_encode.h>
+
+#include "fleet.h"
+#include "smp_cbor.h"
+#include "smp_pipe.h"
+#include "smp_upload.h"
+
+#define CBOR_ENCODER_STATE_NUM 2
+#define CBOR_MAP_MAX_ELEMENT_CNT 2
+
+#define SMP_OP_READ    0
+#define SMP_GROUP_STAT 2
+#define SMP_ID_STAT_SHOW 0
+
+/* One job per node count of a sweep, 1 to 128 and all, for each task. */
+#define FLEET_JOBS_MAX 18
+
+enum fleet_task {
+	FLEET_TASK_STATS,
+	FLEET_TASK_UPLOAD,
+};
+
+struct fleet_job {
+	uint8_t task;
+	uint8_t nodes;
+};
+
+enum node_state {
+	/* Not part of the running job. */
+	NODE_IDLE,
+	NODE_PENDING,
+	NODE_CONNECTING,
+	/* Connected and discovered, or failed to; the task is to start. */
+	NODE_READY,
+	NODE_BUSY,
+	/* Task over, to disconnect. */
+	NODE_FINISHED,
+	NODE_CLOSING,
+	NODE_DONE,
+};
+
+struct fleet_node {
+	bt_addr_le_t addr;
+	struct bt_conn *conn;
+	enum node_state state;
+	int err;
+	int64_t start_ms;
+	uint32_t elapsed_ms;
+	/* Statistics read by the stats task. */
+	uint32_t stats;
+};
+
+static struct fleet_node nodes[CONFIG_SMP_FLEET_NODES_MAX];
+static size_t node_count;
+static struct k_spinlock lock;
+
+static struct {
+	bool running;
+	struct fleet_job job;
+	int64_t start_ms;
+} fleet;
+
+K_MSGQ_DEFINE(fleet_jobs, sizeof(struct fleet_job), FLEET_JOBS_MAX, 4);
+
+static void fleet_work_fn(struct k_work *work);
+
+static K_WORK_DEFINE(fleet_work, fleet_work_fn);
+
+static const char *task_name(uint8_t task)
+{
+	return (task == FLEET_TASK_UPLOAD) ? "upload" : "stats";
+}
+
+/* Called with the lock held. */
+static struct fleet_node *node_by_conn(struct bt_conn *conn)
+{
+	for (size_t i = 0; i < node_count; i++) {
+		if (nodes[i].conn == conn) {
+			return &nodes[i];
+		}
+	}
+
+	return NULL;
+}
+
+/* Called with the lock held. */
+static void node_done(struct fleet_node *node, int err)
+{
+	if (node->err == 0) {
+		node->err = err;
+	}
+
+	node->elapsed_ms = (uint32_t)(k_uptime_get() - node->start_ms);
+	node->state = NODE_DONE;
+}
+
+static void task_end(struct fleet_node *node, int err)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	if (node->state == NODE_BUSY) {
+		node->err = err;
+		node->state = NODE_FINISHED;
+	}
+	k_spin_unlock(&lock, key);
+
+	k_work_submit(&fleet_work);
+}
+
+static int stats_rsp_item(const struct smp_cbor_item *item, void *user_data)
+{
+	struct fleet_node *node = user_data;
+
+	/* Entries of the "fields" map. */
+	if (item->depth == 2 && item->type == SMP_CBOR_UINT) {
+		node->stats++;
+	}
+
+	return 0;
+}
+
+static void stats_rsp(int err, const struct bt_dfu_smp_header *rsp, void *user_data)
+{
+	task_end(user_data, err);
+}
+
+static int stats_start(struct fleet_node *node)
+{
+	zcbor_state_t zse[CBOR_ENCODER_STATE_NUM];
+	struct smp_pipe_buf *buf;
+	int err;
+
+	buf = smp_pipe_buf_alloc();
+	if (buf == NULL) {
+		return -ENOBUFS;
+	}
+
+	zcbor_new_encode_state(zse, ARRAY_SIZE(zse), buf->payload, sizeof(buf->payload), 0);
+
+	zcbor_map_start_encode(zse, CBOR_MAP_MAX_ELEMENT_CNT);
+	zcbor_tstr_put_lit(zse, "name");
+	zcbor_tstr_put_lit(zse, CONFIG_SMP_FLEET_STAT_NAME);
+	zcbor_map_end_encode(zse, CBOR_MAP_MAX_ELEMENT_CNT);
+
+	if (!zcbor_check_error(zse)) {
+		smp_pipe_buf_free(buf);
+		return -EFAULT;
+	}
+
+	buf->header.op = SMP_OP_READ;
+	buf->header.group_l8 = SMP_GROUP_STAT;
+	buf->header.id = SMP_ID_STAT_SHOW;
+
+	node->stats = 0;
+
+	err = smp_pipe_send(node->conn, buf, (size_t)(zse->payload - buf->payload),
+			    stats_rsp_item, stats_rsp, node);
+	if (err) {
+		smp_pipe_buf_free(buf);
+	}
+
+	return err;
+}
+
+static void upload_done(struct bt_conn *conn, int err)
+{
+	struct fleet_node *node;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	node = node_by_conn(conn);
+	k_spin_unlock(&lock, key);
+
+	if (node != NULL) {
+		task_end(node, err);
+	}
+}
+
+static int task_start(struct fleet_node *node)
+{
+#if defined(CONFIG_SMP_FLEET_UPLOAD)
+	if (fleet.job.task == FLEET_TASK_UPLOAD) {
+		return smp_upload_start(node->conn, false, upload_done);
+	}
+#endif
+
+	return stats_start(node);
+}
+
+static void node_close(struct fleet_node *node)
+{
+	int err;
+
+	err = bt_conn_disconnect(node->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	if (err) {
+		printk("Fleet: node %zu not disconnected (err %d)\n", (size_t)(node - nodes),
+		       err);
+	}
+}
+
+static int node_connect(struct fleet_node *node)
+{
+	struct bt_conn *conn;
+	k_spinlock_key_t key;
+	int err;
+
+	err = bt_conn_le_create(&node->addr, BT_CONN_LE_CREATE_CONN, BT_LE_CONN_PARAM_DEFAULT,
+				&conn);
+	if (err) {
+		return err;
+	}
+
+	key = k_spin_lock(&lock);
+	node->conn = conn;
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+static void job_begin(void)
+{
+	k_spinlock_key_t key;
+	int err;
+
+	err = bt_scan_stop();
+	if (err && err != -EALREADY) {
+		printk("Fleet: scanning not stopped (err %d)\n", err);
+	}
+
+	key = k_spin_lock(&lock);
+	fleet.job.nodes = MIN(fleet.job.nodes, node_count);
+	for (size_t i = 0; i < fleet.job.nodes; i++) {
+		nodes[i].state = NODE_PENDING;
+		nodes[i].err = 0;
+	}
+	k_spin_unlock(&lock, key);
+
+	fleet.running = true;
+	fleet.start_ms = k_uptime_get();
+
+	printk("Fleet: %s on %u nodes, %u slots\n", task_name(fleet.job.task), fleet.job.nodes,
+	       CONFIG_BT_MAX_CONN);
+}
+
+static void job_report(void)
+{
+	uint32_t elapsed_ms = (uint32_t)(k_uptime_get() - fleet.start_ms);
+	uint32_t failed = 0;
+
+	for (size_t i = 0; i < fleet.job.nodes; i++) {
+		if (nodes[i].err != 0) {
+			failed++;
+		}
+
+		if (fleet.job.task == FLEET_TASK_STATS && nodes[i].err == 0) {
+			printk("Fleet: node %zu done in %u ms, %u stats\n", i, nodes[i].elapsed_ms,
+			       nodes[i].stats);
+		} else {
+			printk("Fleet: node %zu done in %u ms (err %d)\n", i, nodes[i].elapsed_ms,
+			       nodes[i].err);
+		}
+
+		nodes[i].state = NODE_IDLE;
+	}
+
+	printk("Fleet: %s on %u nodes in %u ms, %u ms per node, %u failed\n",
+	       task_name(fleet.job.task), fleet.job.nodes, elapsed_ms,
+	       elapsed_ms / fleet.job.nodes, failed);
+}
+
+static void job_end(void)
+{
+	int err;
+
+	job_report();
+	fleet.running = false;
+
+	err = bt_scan_start(BT_SCAN_TYPE_SCAN_ACTIVE);
+	if (err) {
+		printk("Scanning failed to start (err %d)\n", err);
+	}
+}
+
+static void fleet_work_fn(struct k_work *work)
+{
+	struct fleet_node *node;
+	k_spinlock_key_t key;
+	size_t active = 0;
+	size_t done = 0;
+	bool connecting = false;
+	int err;
+
+	if (!fleet.running) {
+		if (k_msgq_get(&fleet_jobs, &fleet.job, K_NO_WAIT) != 0) {
+			return;
+		}
+
+		job_begin();
+	}
+
+	for (size_t i = 0; i < fleet.job.nodes; i++) {
+		node = &nodes[i];
+
+		if (node->state == NODE_READY) {
+			key = k_spin_lock(&lock);
+			node->state = NODE_BUSY;
+			k_spin_unlock(&lock, key);
+
+			err = (node->err != 0) ? node->err : task_start(node);
+			if (err) {
+				task_end(node, err);
+			}
+		} else if (node->state == NODE_FINISHED) {
+			key = k_spin_lock(&lock);
+			node->state = NODE_CLOSING;
+			k_spin_unlock(&lock, key);
+
+			node_close(node);
+		}
+	}
+
+	key = k_spin_lock(&lock);
+	for (size_t i = 0; i < fleet.job.nodes; i++) {
+		switch (nodes[i].state) {
+		case NODE_CONNECTING:
+			connecting = true;
+			active++;
+			break;
+		case NODE_READY:
+		case NODE_BUSY:
+		case NODE_FINISHED:
+		case NODE_CLOSING:
+			active++;
+			break;
+		case NODE_DONE:
+			done++;
+			break;
+		default:
+			break;
+		}
+	}
+
+	/* Fill the free slots, one connection at a time. */
+	node = NULL;
+	for (size_t i = 0; i < fleet.job.nodes && !connecting && active < CONFIG_BT_MAX_CONN;
+	     i++) {
+		if (nodes[i].state == NODE_PENDING) {
+			node = &nodes[i];
+			node->state = NODE_CONNECTING;
+			node->start_ms = k_uptime_get();
+			break;
+		}
+	}
+	k_spin_unlock(&lock, key);
+
+	if (node != NULL) {
+		err = node_connect(node);
+		if (err) {
+			printk("Fleet: node %zu not connected (err %d)\n", (size_t)(node - nodes),
+			       err);
+
+			key = k_spin_lock(&lock);
+			node_done(node, err);
+			k_spin_unlock(&lock, key);
+
+			/* On to the next node. */
+			k_work_submit(&fleet_work);
+		}
+
+		return;
+	}
+
+	if (done == fleet.job.nodes) {
+		job_end();
+		k_work_submit(&fleet_work);
+	}
+}
+
+static void connected(struct bt_conn *conn, uint8_t conn_err)
+{
+	struct fleet_node *node;
+	k_spinlock_key_t key;
+
+	if (!conn_err) {
+		return;
+	}
+
+	key = k_spin_lock(&lock);
+	node = node_by_conn(conn);
+	if (node != NULL) {
+		bt_conn_unref(node->conn);
+		node->conn = NULL;
+		node_done(node, -ENOTCONN);
+	}
+	k_spin_unlock(&lock, key);
+
+	if (node != NULL) {
+		k_work_submit(&fleet_work);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct fleet_node *node;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	node = node_by_conn(conn);
+	if (node != NULL) {
+		bt_conn_unref(node->conn);
+		node->conn = NULL;
+		node_done(node, (node->state == NODE_CLOSING) ? 0 : -ENOTCONN);
+	}
+	k_spin_unlock(&lock, key);
+
+	if (node != NULL) {
+		k_work_submit(&fleet_work);
+	}
+}
+
+BT_CONN_CB_DEFINE(fleet_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+
+void fleet_found(const bt_addr_le_t *addr)
+{
+	char str[BT_ADDR_LE_STR_LEN];
+	k_spinlock_key_t key;
+	size_t index = SIZE_MAX;
+
+	key = k_spin_lock(&lock);
+	for (size_t i = 0; i < node_count; i++) {
+		if (bt_addr_le_eq(&nodes[i].addr, addr)) {
+			k_spin_unlock(&lock, key);
+			return;
+		}
+	}
+
+	if (node_count < ARRAY_SIZE(nodes)) {
+		index = node_count++;
+		bt_addr_le_copy(&nodes[index].addr, addr);
+		nodes[index].state = NODE_IDLE;
+	}
+	k_spin_unlock(&lock, key);
+
+	if (index != SIZE_MAX) {
+		bt_addr_le_to_str(addr, str, sizeof(str));
+		printk("Fleet: node %zu is %s\n", index, str);
+	}
+}
+
+void fleet_ready(struct bt_conn *conn, int err)
+{
+	struct fleet_node *node;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	node = node_by_conn(conn);
+	if (node != NULL && node->state == NODE_CONNECTING) {
+		node->err = err;
+		node->state = NODE_READY;
+	}
+	k_spin_unlock(&lock, key);
+
+	k_work_submit(&fleet_work);
+}
+
+static int job_queue(uint8_t task, size_t count)
+{
+	struct fleet_job job = {
+		.task = task,
+	};
+	size_t n = IS_ENABLED(CONFIG_SMP_FLEET_SWEEP) ? 1 : count;
+
+	for (;; n = MIN(n * 2, count)) {
+		job.nodes = n;
+		if (k_msgq_put(&fleet_jobs, &job, K_NO_WAIT) != 0) {
+			return -ENOMEM;
+		}
+
+		if (n == count) {
+			return 0;
+		}
+	}
+}
+
+int fleet_run(void)
+{
+	size_t count = node_count;
+	int err;
+
+	if (count == 0) {
+		return -ENOENT;
+	}
+
+	err = job_queue(FLEET_TASK_STATS, count);
+	if (!err && IS_ENABLED(CONFIG_SMP_FLEET_UPLOAD)) {
+		err = job_queue(FLEET_TASK_UPLOAD, count);
+	}
+
+	k_work_submit(&fleet_work);
+
+	return err;
+}
@@ -0,0 +1,39 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <zephyr/bluetooth/addr.h>
+#include <zephyr/bluetooth/conn.h>
+
+/**
+ * @brief Add an SMP server found by the scanner to the fleet
+ *
+ * Servers already known, and any beyond CONFIG_SMP_FLEET_NODES_MAX, are
+ * ignored.
+ */
+void fleet_found(const bt_addr_le_t *addr);
+
+/**
+ * @brief Report the end of the SMP service discovery of a fleet connection
+ *
+ * @param err 0 if the pipeline was attached, negative errno otherwise
+ */
+void fleet_ready(struct bt_conn *conn, int err);
+
+/**
+ * @brief Queue the fleet jobs
+ *
+ * Reads statistics from all nodes and, with CONFIG_SMP_FLEET_UPLOAD,
+ * uploads the image to all of them. With CONFIG_SMP_FLEET_SWEEP, each job
+ * is repeated over 1, 2, 4 and so on up to all nodes, to show how the
+ * completion time grows with the fleet.
+ *
+ * @return 0 on success, -ENOENT if no node was found yet,
+ *	   -ENOMEM if the job queue is full
+ */
+int fleet_run(void);
+
+#endif /* FLEET_H */
@@ -13,7 +13,6 @@
 #include <zephyr/sys/printk.h>
 
 #include <zcbor_encode.h>
-#include <zcbor_decode.h>
 #include <zcbor_common.h>
 
 #include <zephyr/bluetooth/bluetooth.h>
@@ -27,34 +26,29 @@
 #include <bluetooth/services/dfu_smp.h>
 #include <dk_buttons_and_leds.h>
 
+#include "fleet.h"
+#include "smp_bench.h"
+#include "smp_pipe.h"
+#include "smp_upload.h"
+
 
 /* Mimimal number of ZCBOR encoder states to provide full encoder functionality. */
 #define CBOR_ENCODER_STATE_NUM 2
 
-/* Number of ZCBOR decoder states required to provide full decoder functionality plus one
- * more level for decoding nested map received in response to SMP echo command.
- */
-#define CBOR_DECODER_STATE_NUM 3
-
 #define CBOR_MAP_MAX_ELEMENT_CNT 2
-#define CBOR_BUFFER_SIZE 128
-
-#define SMP_ECHO_MAP_KEY_MAX_LEN 2
-#define SMP_ECHO_MAP_VALUE_MAX_LEN 30
 
 #define KEY_ECHO_MASK  DK_BTN1_MSK
+#define KEY_BENCH_MASK DK_BTN2_MSK
+#define KEY_UPLOAD_MASK DK_BTN3_MSK
+#define KEY_FLEET_MASK DK_BTN4_MSK
 
 
 static struct bt_conn *default_conn;
-static struct bt_dfu_smp dfu_smp;
-static struct bt_gatt_exchange_params exchange_params;
+static struct bt_dfu_smp dfu_smp[CONFIG_BT_MAX_CONN];
+static struct bt_gatt_exchange_params exchange_params[CONFIG_BT_MAX_CONN];
 
-/* Buffer for response */
-struct smp_buffer {
-	struct bt_dfu_smp_header header;
-	uint8_t payload[CBOR_BUFFER_SIZE];
-};
-static struct smp_buffer smp_rsp_buff;
+/* The discovery manager serves one connection at a time; the others wait here. */
+static ATOMIC_DEFINE(discovery_pending, CONFIG_BT_MAX_CONN);
 
 
 static void scan_filter_match(struct bt_scan_device_info *device_info,
@@ -67,6 +61,10 @@ static void scan_filter_match(struct bt_scan_device_info *device_info,
 
 	printk("Filters matched. Address: %s connectable: %s\n",
 		addr, connectable ? "yes" : "no");
+
+	if (IS_ENABLED(CONFIG_SMP_FLEET) && connectable) {
+		fleet_found(device_info->recv_info->addr);
+	}
 }
 
 static void scan_connecting_error(struct bt_scan_device_info *device_info)
@@ -83,32 +81,75 @@ static void scan_connecting(struct bt_scan_device_info *device_info,
 BT_SCAN_CB_INIT(scan_cb, scan_filter_match, NULL,
 		scan_connecting_error, scan_connecting);
 
+static void discovery_start(struct bt_conn *conn);
+
+static void discovery_next_cb(struct bt_conn *conn, void *data)
+{
+	bool *started = data;
+
+	if (!*started &&
+	    atomic_test_and_clear_bit(discovery_pending, bt_conn_index(conn))) {
+		*started = true;
+		discovery_start(conn);
+	}
+}
+
+static void discovery_next(void)
+{
+	bool started = false;
+
+	bt_conn_foreach(BT_CONN_TYPE_LE, discovery_next_cb, &started);
+}
+
+static void discovery_done(struct bt_conn *conn, int err)
+{
+	if (IS_ENABLED(CONFIG_SMP_FLEET)) {
+		fleet_ready(conn, err);
+	}
+
+	discovery_next();
+}
+
 static void discovery_completed_cb(struct bt_gatt_dm *dm,
 				   void *context)
 {
+	struct bt_conn *conn = bt_gatt_dm_conn_get(dm);
+	struct bt_dfu_smp *smp = &dfu_smp[bt_conn_index(conn)];
+	int release_err;
 	int err;
 
 	printk("The discovery procedure succeeded\n");
 
 	bt_gatt_dm_data_print(dm);
 
-	err = bt_dfu_smp_handles_assign(dm, &dfu_smp);
+	err = bt_dfu_smp_handles_assign(dm, smp);
 	if (err) {
 		printk("Could not init DFU SMP client object, error: %d\n",
 		       err);
+	} else {
+		err = smp_pipe_start(conn, smp);
+		if (err) {
+			printk("Could not start the SMP pipeline, error: %d\n",
+			       err);
+		}
 	}
 
-	err = bt_gatt_dm_data_release(dm);
-	if (err) {
+	/* Released first: the next discovery needs the manager. */
+	release_err = bt_gatt_dm_data_release(dm);
+	if (release_err) {
 		printk("Could not release the discovery data, error "
-		       "code: %d\n", err);
+		       "code: %d\n", release_err);
 	}
+
+	discovery_done(conn, err);
 }
 
 static void discovery_service_not_found_cb(struct bt_conn *conn,
 					   void *context)
 {
 	printk("The service could not be found during the discovery\n");
+
+	discovery_done(conn, -ENOENT);
 }
 
 static void discovery_error_found_cb(struct bt_conn *conn,
@@ -116,6 +157,8 @@ static void discovery_error_found_cb(struct bt_conn *conn,
 				     void *context)
 {
 	printk("The discovery procedure failed with %d\n", err);
+
+	discovery_done(conn, err);
 }
 
 static const struct bt_gatt_dm_cb discovery_cb = {
@@ -124,6 +167,21 @@ static const struct bt_gatt_dm_cb discovery_cb = {
 	.error_found = discovery_error_found_cb,
 };
 
+static void discovery_start(struct bt_conn *conn)
+{
+	int err;
+
+	err = bt_gatt_dm_start(conn, BT_UUID_DFU_SMP_SERVICE, &discovery_cb, NULL);
+	if (err == -EALREADY) {
+		/* Started once the running one is done. */
+		atomic_set_bit(discovery_pending, bt_conn_index(conn));
+	} else if (err) {
+		printk("Could not start the discovery procedure "
+		       "(err %d)\n", err);
+		discovery_done(conn, err);
+	}
+}
+
 static void exchange_func(struct bt_conn *conn, uint8_t err,
 			  struct bt_gatt_exchange_params *params)
 {
@@ -162,22 +220,15 @@ static void connected(struct bt_conn *conn, uint8_t conn_err)
 		printk("Failed to set security\n");
 	}
 
-	exchange_params.func = exchange_func;
-	err = bt_gatt_exchange_mtu(conn, &exchange_params);
+	exchange_params[bt_conn_index(conn)].func = exchange_func;
+	err = bt_gatt_exchange_mtu(conn, &exchange_params[bt_conn_index(conn)]);
 	if (err) {
 		printk("MTU exchange failed (err %d)\n", err);
 	} else {
 		printk("MTU exchange pending\n");
 	}
 
-	if (conn == default_conn) {
-		err = bt_gatt_dm_start(conn, BT_UUID_DFU_SMP_SERVICE,
-				       &discovery_cb, NULL);
-		if (err) {
-			printk("Could not start the discovery procedure "
-			       "(err %d)\n", err);
-		}
-	}
+	discovery_start(conn);
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
@@ -189,6 +240,9 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 
 	printk("Disconnected: %s, reason 0x%02x %s\n", addr, reason, bt_hci_err_to_str(reason));
 
+	atomic_clear_bit(discovery_pending, bt_conn_index(conn));
+	smp_pipe_stop(conn);
+
 	if (default_conn != conn) {
 		return;
 	}
@@ -228,8 +282,9 @@ static void scan_init(void)
 {
 	int err;
 
+	/* The fleet connects to its nodes itself. */
 	struct bt_scan_init_param scan_init = {
-		.connect_if_match = 1,
+		.connect_if_match = !IS_ENABLED(CONFIG_SMP_FLEET),
 		.scan_param = NULL,
 		.conn_param = BT_LE_CONN_PARAM_DEFAULT
 	};
@@ -262,114 +317,82 @@ static const struct bt_dfu_smp_init_params init_params = {
 	.error_cb = dfu_smp_on_error
 };
 
-static void smp_echo_rsp_proc(struct bt_dfu_smp *dfu_smp)
-{
-	uint8_t *p_outdata = (uint8_t *)(&smp_rsp_buff);
-	const struct bt_dfu_smp_rsp_state *rsp_state;
+/* Responses come one after the other, so one echo is decoded at a time. */
+static bool echo_rsp_seen;
 
-	rsp_state = bt_dfu_smp_rsp_state(dfu_smp);
-	printk("Echo response part received, size: %zu.\n",
-	       rsp_state->chunk_size);
+static int smp_echo_rsp_item(const struct smp_cbor_item *item, void *user_data)
+{
+	if (item->depth != 1 || item->type != SMP_CBOR_TSTR ||
+	    !smp_cbor_key_is(item, "r")) {
+		return 0;
+	}
 
-	if (rsp_state->offset + rsp_state->chunk_size > sizeof(smp_rsp_buff)) {
-		printk("Response size buffer overflow\n");
-	} else {
-		p_outdata += rsp_state->offset;
-		memcpy(p_outdata,
-		       rsp_state->data,
-		       rsp_state->chunk_size);
-	}
-
-	if (bt_dfu_smp_rsp_total_check(dfu_smp)) {
-		printk("Total response received - decoding\n");
-		if (smp_rsp_buff.header.op != 3 /* WRITE RSP*/) {
-			printk("Unexpected operation code (%u)!\n",
-			       smp_rsp_buff.header.op);
-			return;
-		}
-		uint16_t group = ((uint16_t)smp_rsp_buff.header.group_h8) << 8 |
-				      smp_rsp_buff.header.group_l8;
-		if (group != 0 /* OS */) {
-			printk("Unexpected command group (%u)!\n", group);
-			return;
-		}
-		if (smp_rsp_buff.header.id != 0 /* ECHO */) {
-			printk("Unexpected command (%u)",
-			       smp_rsp_buff.header.id);
-			return;
-		}
-		size_t payload_len = ((uint16_t)smp_rsp_buff.header.len_h8) << 8 |
-				      smp_rsp_buff.header.len_l8;
-
-		zcbor_state_t zsd[CBOR_DECODER_STATE_NUM];
-		struct zcbor_string value = {0};
-		char map_key[SMP_ECHO_MAP_KEY_MAX_LEN];
-		char map_value[SMP_ECHO_MAP_VALUE_MAX_LEN];
-		bool ok;
-
-		zcbor_new_decode_state(zsd, ARRAY_SIZE(zsd), smp_rsp_buff.payload, payload_len, 1,
-					NULL, 0);
-
-		/* Stop decoding on the error. */
-		zsd->constant_state->stop_on_error = true;
-
-		zcbor_map_start_decode(zsd);
-		ok = zcbor_tstr_decode(zsd, &value);
-
-		if (!ok) {
-			printk("Decoding error (err: %d)\n", zcbor_pop_error(zsd));
-			return;
-		} else if ((value.len != 1) || (*value.value != 'r')) {
-			printk("Invalid data received.\n");
-			return;
-		} else {
-			/* Do nothing */
-		}
+	/* Print the string as it arrives, without collecting it first. */
+	if (item->str.offset == 0) {
+		printk("{_\"r\": \"");
+	}
 
-		map_key[0] = value.value[0];
+	printk("%.*s", (int)item->str.part.len, item->str.part.value);
 
-		/* Add string NULL terminator */
-		map_key[1] = '\0';
+	if (smp_cbor_str_last(item)) {
+		printk("\"}\n");
+		echo_rsp_seen = true;
+	}
 
-		ok = zcbor_tstr_decode(zsd, &value);
+	return 0;
+}
 
-		if (!ok) {
-			printk("Decoding error (err: %d)\n", zcbor_pop_error(zsd));
-			return;
-		} else if (value.len > (sizeof(map_value) - 1)) {
-			printk("To small buffer for received data.\n");
-			return;
-		} else {
-			/* Do nothing */
-		}
+static void smp_echo_rsp(int err, const struct bt_dfu_smp_header *rsp,
+			 void *user_data)
+{
+	bool seen = echo_rsp_seen;
 
-		memcpy(map_value, value.value, value.len);
+	echo_rsp_seen = false;
 
-		/* Add string NULL terminator */
-		map_value[value.len] = '\0';
+	if (err) {
+		printk("Echo command failed (err: %d)\n", err);
+		return;
+	}
 
-		zcbor_map_end_decode(zsd);
+	printk("Echo response %u received, size: %zu.\n", rsp->seq,
+	       sizeof(*rsp) + (((uint16_t)rsp->len_h8) << 8 | rsp->len_l8));
 
-		if (zcbor_check_error(zsd)) {
-			/* Print textual representation of the received CBOR map. */
-			printk("{_\"%s\": \"%s\"}\n", map_key, map_value);
-		} else {
-			printk("Cannot print received CBOR stream (err: %d)\n",
-			       zcbor_pop_error(zsd));
-		}
+	if (rsp->op != 3 /* WRITE RSP*/) {
+		printk("Unexpected operation code (%u)!\n", rsp->op);
+		return;
+	}
+	uint16_t group = ((uint16_t)rsp->group_h8) << 8 | rsp->group_l8;
+	if (group != 0 /* OS */) {
+		printk("Unexpected command group (%u)!\n", group);
+		return;
+	}
+	if (rsp->id != 0 /* ECHO */) {
+		printk("Unexpected command (%u)", rsp->id);
+		return;
+	}
+	if (!seen) {
+		printk("Invalid data received.\n");
 	}
-
 }
 
-static int send_smp_echo(struct bt_dfu_smp *dfu_smp,
-			 const char *string, size_t string_max_len)
+static int send_smp_echo(const char *string, size_t string_max_len)
 {
-	static struct smp_buffer smp_cmd;
+	struct smp_pipe_buf *smp_cmd;
 	zcbor_state_t zse[CBOR_ENCODER_STATE_NUM];
 	size_t payload_len;
+	int err;
 
-	zcbor_new_encode_state(zse, ARRAY_SIZE(zse), smp_cmd.payload,
-			       sizeof(smp_cmd.payload), 0);
+	if (!smp_pipe_ready(default_conn)) {
+		return -ENOTCONN;
+	}
+
+	smp_cmd = smp_pipe_buf_alloc();
+	if (!smp_cmd) {
+		return -ENOBUFS;
+	}
+
+	zcbor_new_encode_state(zse, ARRAY_SIZE(zse), smp_cmd->payload,
+			       sizeof(smp_cmd->payload), 0);
 
 	/* Stop encoding on the error. */
 	zse->constant_state->stop_on_error = true;
@@ -381,23 +404,26 @@ static int send_smp_echo(struct bt_dfu_smp *dfu_smp,
 
 	if (!zcbor_check_error(zse)) {
 		printk("Failed to encode SMP echo packet, err: %d\n", zcbor_pop_error(zse));
+		smp_pipe_buf_free(smp_cmd);
 		return -EFAULT;
 	}
 
-	payload_len = (size_t)(zse->payload - smp_cmd.payload);
+	payload_len = (size_t)(zse->payload - smp_cmd->payload);
 
-	smp_cmd.header.op = 2; /* Write */
-	smp_cmd.header.flags = 0;
-	smp_cmd.header.len_h8 = (uint8_t)((payload_len >> 8) & 0xFF);
-	smp_cmd.header.len_l8 = (uint8_t)((payload_len >> 0) & 0xFF);
-	smp_cmd.header.group_h8 = 0;
-	smp_cmd.header.group_l8 = 0; /* OS */
-	smp_cmd.header.seq = 0;
-	smp_cmd.header.id  = 0; /* ECHO */
+	smp_cmd->header.op = 2; /* Write */
+	smp_cmd->header.flags = 0;
+	smp_cmd->header.group_h8 = 0;
+	smp_cmd->header.group_l8 = 0; /* OS */
+	smp_cmd->header.id  = 0; /* ECHO */
 
-	return bt_dfu_smp_command(dfu_smp, smp_echo_rsp_proc,
-				  sizeof(smp_cmd.header) + payload_len,
-				  &smp_cmd);
+	/* Length and sequence number are filled in by the pipeline. */
+	err = smp_pipe_send(default_conn, smp_cmd, payload_len, smp_echo_rsp_item,
+			    smp_echo_rsp, NULL);
+	if (err) {
+		smp_pipe_buf_free(smp_cmd);
+	}
+
+	return err;
 }
 
 
@@ -411,7 +437,7 @@ static void button_echo(bool state)
 		++echo_cnt;
 		printk("Echo test: %d\n", echo_cnt);
 		snprintk(buffer, sizeof(buffer), "Echo message: %u", echo_cnt);
-		ret = send_smp_echo(&dfu_smp, buffer, sizeof(buffer));
+		ret = send_smp_echo(buffer, sizeof(buffer));
 		if (ret) {
 			printk("Echo command send error (err: %d)\n", ret);
 		}
@@ -419,11 +445,61 @@ static void button_echo(bool state)
 }
 
 
+static void button_bench(bool state)
+{
+	if (state) {
+		int ret = smp_bench_start(default_conn);
+
+		if (ret) {
+			printk("Benchmark start error (err: %d)\n", ret);
+		}
+	}
+}
+
+
+static void button_upload(bool state)
+{
+	if (state) {
+		int ret = smp_upload_start(default_conn,
+					   IS_ENABLED(CONFIG_SMP_UPLOAD_BASELINE),
+					   NULL);
+
+		if (ret) {
+			printk("Upload start error (err: %d)\n", ret);
+		}
+	}
+}
+
+
+static void button_fleet(bool state)
+{
+	if (state) {
+		int ret = fleet_run();
+
+		if (ret) {
+			printk("Fleet run error (err: %d)\n", ret);
+		}
+	}
+}
+
+
 static void button_handler(uint32_t button_state, uint32_t has_changed)
 {
 	if (has_changed & KEY_ECHO_MASK) {
 		button_echo(button_state & KEY_ECHO_MASK);
 	}
+
+	if (IS_ENABLED(CONFIG_SMP_BENCH) && (has_changed & KEY_BENCH_MASK)) {
+		button_bench(button_state & KEY_BENCH_MASK);
+	}
+
+	if (IS_ENABLED(CONFIG_SMP_UPLOAD) && (has_changed & KEY_UPLOAD_MASK)) {
+		button_upload(button_state & KEY_UPLOAD_MASK);
+	}
+
+	if (IS_ENABLED(CONFIG_SMP_FLEET) && (has_changed & KEY_FLEET_MASK)) {
+		button_fleet(button_state & KEY_FLEET_MASK);
+	}
 }
 
 
@@ -433,7 +509,9 @@ int main(void)
 
 	printk("Starting Bluetooth Central SMP Client example\n");
 
-	bt_dfu_smp_init(&dfu_smp, &init_params);
+	for (size_t i = 0; i < ARRAY_SIZE(dfu_smp); i++) {
+		bt_dfu_smp_init(&dfu_smp[i], &init_params);
+	}
 
 	err = bt_enable(NULL);
 	if (err) {
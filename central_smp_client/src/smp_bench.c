@@ -0,0 +1,190 @@
+/** @file
+ *  @brief SMP command throughput at several pipeline windows
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include <zcbor_encode.h>
+
+#include "smp_bench.h"
+#include "smp_pipe.h"
+
+#define CBOR_ENCODER_STATE_NUM 2
+#define CBOR_MAP_MAX_ELEMENT_CNT 2
+
+#if defined(CONFIG_SMP_BENCH_STAT)
+#define BENCH_OP    0 /* Read */
+#define BENCH_GROUP 2 /* STAT */
+#define BENCH_ID    0 /* SHOW */
+#define BENCH_KEY   "name"
+#define BENCH_VALUE CONFIG_SMP_BENCH_STAT_NAME
+#else
+#define BENCH_OP    2 /* Write */
+#define BENCH_GROUP 0 /* OS */
+#define BENCH_ID    0 /* ECHO */
+#define BENCH_KEY   "d"
+#define BENCH_VALUE "bench"
+#endif
+
+static const uint8_t bench_windows[] = {1, 2, 4, 8};
+
+static struct {
+	struct bt_conn *conn;
+	bool running;
+	size_t round;
+	uint32_t issued;
+	uint32_t done;
+	uint32_t failed;
+	int64_t start_ms;
+	/* Commands per second of the first round, to compare against. */
+	uint32_t base_rate;
+} bench;
+
+static void bench_work_fn(struct k_work *work);
+
+static K_WORK_DEFINE(bench_work, bench_work_fn);
+
+static int bench_encode(struct smp_pipe_buf *buf)
+{
+	zcbor_state_t zse[CBOR_ENCODER_STATE_NUM];
+
+	zcbor_new_encode_state(zse, ARRAY_SIZE(zse), buf->payload, sizeof(buf->payload), 0);
+
+	zcbor_map_start_encode(zse, CBOR_MAP_MAX_ELEMENT_CNT);
+	zcbor_tstr_put_lit(zse, BENCH_KEY);
+	zcbor_tstr_put_lit(zse, BENCH_VALUE);
+	zcbor_map_end_encode(zse, CBOR_MAP_MAX_ELEMENT_CNT);
+
+	if (!zcbor_check_error(zse)) {
+		return -EFAULT;
+	}
+
+	buf->header.op = BENCH_OP;
+	buf->header.group_l8 = BENCH_GROUP;
+	buf->header.id = BENCH_ID;
+
+	return (int)(zse->payload - buf->payload);
+}
+
+static void bench_rsp(int err, const struct bt_dfu_smp_header *rsp, void *user_data)
+{
+	bench.done++;
+	if (err != 0) {
+		bench.failed++;
+	}
+
+	k_work_submit(&bench_work);
+}
+
+/* Keep the pool full; the pipeline window decides how much goes on air. */
+static int bench_fill(void)
+{
+	struct smp_pipe_buf *buf;
+	int len;
+	int err;
+
+	while (bench.issued < CONFIG_SMP_BENCH_CMD_COUNT) {
+		buf = smp_pipe_buf_alloc();
+		if (buf == NULL) {
+			return 0;
+		}
+
+		len = bench_encode(buf);
+		if (len < 0) {
+			smp_pipe_buf_free(buf);
+			return len;
+		}
+
+		err = smp_pipe_send(bench.conn, buf, len, NULL, bench_rsp, NULL);
+		if (err) {
+			smp_pipe_buf_free(buf);
+			return err;
+		}
+
+		bench.issued++;
+	}
+
+	return 0;
+}
+
+static void bench_report(uint8_t window)
+{
+	uint32_t elapsed_ms = (uint32_t)(k_uptime_get() - bench.start_ms);
+	uint32_t rate = (elapsed_ms > 0) ? (bench.done * 1000U) / elapsed_ms : 0U;
+
+	if (bench.round == 0) {
+		bench.base_rate = rate;
+	}
+
+	printk("SMP bench: window %u, %u %s commands in %u ms, %u cmds/s (x%u.%02u), %u failed\n",
+	       window, bench.done, IS_ENABLED(CONFIG_SMP_BENCH_STAT) ? "stat" : "echo",
+	       elapsed_ms, rate, (bench.base_rate > 0) ? rate / bench.base_rate : 0U,
+	       (bench.base_rate > 0) ? ((rate * 100U) / bench.base_rate) % 100U : 0U,
+	       bench.failed);
+}
+
+static void bench_work_fn(struct k_work *work)
+{
+	int err;
+
+	if (!bench.running) {
+		return;
+	}
+
+	if (bench.done == CONFIG_SMP_BENCH_CMD_COUNT) {
+		bench_report(bench_windows[bench.round]);
+		bench.round++;
+		bench.issued = 0;
+		bench.done = 0;
+		bench.failed = 0;
+	}
+
+	if (bench.issued == 0) {
+		if (bench.round == ARRAY_SIZE(bench_windows) ||
+		    smp_pipe_window_set(bench.conn, bench_windows[bench.round]) != 0) {
+			/* Done, or the pool is smaller than the next window. */
+			(void)smp_pipe_window_set(bench.conn, CONFIG_SMP_PIPE_WINDOW);
+			bench.running = false;
+			return;
+		}
+
+		bench.start_ms = k_uptime_get();
+	}
+
+	err = bench_fill();
+	if (err) {
+		printk("SMP bench: stopped (err %d)\n", err);
+		(void)smp_pipe_window_set(bench.conn, CONFIG_SMP_PIPE_WINDOW);
+		bench.running = false;
+	}
+}
+
+int smp_bench_start(struct bt_conn *conn)
+{
+	if (bench.running) {
+		return -EBUSY;
+	}
+
+	if (!smp_pipe_ready(conn)) {
+		return -ENOTCONN;
+	}
+
+	bench.conn = conn;
+	bench.running = true;
+	bench.round = 0;
+	bench.issued = 0;
+	bench.done = 0;
+	bench.failed = 0;
+	bench.base_rate = 0;
+
+	printk("SMP bench: %u commands per window\n", CONFIG_SMP_BENCH_CMD_COUNT);
+	k_work_submit(&bench_work);
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef SMP_BENCH_H
+#define SMP_BENCH_H
+
+#include <zephyr/bluetooth/conn.h>
+
+/**
+ * @brief Measure SMP command throughput through the pipeline
+ *
+ * Issues CONFIG_SMP_BENCH_CMD_COUNT echo or stat commands at window sizes
+ * 1, 2, 4 and 8 and prints commands per second for each.
+ *
+ * @return 0 on success, -EBUSY if a benchmark is already running,
+ *	   -ENOTCONN if the connection has no pipeline
+ */
+int smp_bench_start(struct bt_conn *conn);
+
+#endif /* SMP_BENCH_H */
@@ -0,0 +1,302 @@
+/** @file
+ *  @brief Incremental CBOR decoding of SMP responses
+ *
+ * Responses arrive as notifications of at most one ATT MTU. Rather than
+ * reassembling a whole response before decoding it, the decoder is fed
+ * every fragment as it comes and hands out items and string parts as
+ * views into the fragment. Only the item head and the map key, both a few
+ * bytes, are kept across fragments, so the response size is only bounded
+ * by the 16-bit SMP length.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+
+#include <zephyr/sys/util.h>
+
+#include "smp_cbor.h"
+
+#define MAJOR_UINT   0
+#define MAJOR_NINT   1
+#define MAJOR_BSTR   2
+#define MAJOR_TSTR   3
+#define MAJOR_ARRAY  4
+#define MAJOR_MAP    5
+#define MAJOR_TAG    6
+#define MAJOR_SIMPLE 7
+
+#define AI_INDEF 31
+
+static void emit(struct smp_cbor_dec *dec, struct smp_cbor_item *item)
+{
+	int err;
+
+	if (dec->err != 0 || dec->cb == NULL) {
+		return;
+	}
+
+	err = dec->cb(item, dec->user_data);
+	if (err) {
+		dec->err = err;
+	}
+}
+
+static struct smp_cbor_frame *frame_top(struct smp_cbor_dec *dec)
+{
+	return (dec->depth > 0) ? &dec->stack[dec->depth - 1] : NULL;
+}
+
+static bool key_next(struct smp_cbor_dec *dec)
+{
+	struct smp_cbor_frame *frame = frame_top(dec);
+
+	return frame != NULL && frame->map && !frame->value_next;
+}
+
+static void container_end(struct smp_cbor_dec *dec)
+{
+	struct smp_cbor_item item = {
+		.type = SMP_CBOR_END,
+	};
+
+	dec->depth--;
+	item.depth = dec->depth;
+	emit(dec, &item);
+}
+
+/* A whole item is done: count it in its container, closing those that are full. */
+static void item_end(struct smp_cbor_dec *dec)
+{
+	struct smp_cbor_frame *frame;
+
+	for (;;) {
+		frame = frame_top(dec);
+		if (frame == NULL) {
+			dec->done = true;
+			return;
+		}
+
+		if (frame->map) {
+			frame->value_next = !frame->value_next;
+		}
+
+		if (frame->remaining == SMP_CBOR_COUNT_INDEF || --frame->remaining > 0) {
+			return;
+		}
+
+		container_end(dec);
+	}
+}
+
+static void container_start(struct smp_cbor_dec *dec, struct smp_cbor_item *item, bool indef,
+			     uint64_t count)
+{
+	struct smp_cbor_frame *frame;
+
+	if (dec->depth == ARRAY_SIZE(dec->stack)) {
+		dec->err = -ENOMEM;
+		return;
+	}
+
+	item->count = indef ? SMP_CBOR_COUNT_INDEF : (size_t)count;
+	emit(dec, item);
+
+	frame = &dec->stack[dec->depth++];
+	frame->map = (item->type == SMP_CBOR_MAP);
+	frame->value_next = false;
+	frame->remaining = indef ? SMP_CBOR_COUNT_INDEF : (size_t)(frame->map ? count * 2 : count);
+
+	if (frame->remaining == 0) {
+		container_end(dec);
+		item_end(dec);
+	}
+}
+
+static void item_start(struct smp_cbor_dec *dec)
+{
+	uint8_t major = dec->head[0] >> 5;
+	uint8_t ai = dec->head[0] & 0x1f;
+	bool is_key = key_next(dec);
+	struct smp_cbor_item item = {
+		.depth = dec->depth,
+	};
+	uint64_t arg = (ai < 24) ? ai : 0;
+
+	for (uint8_t i = 1; i < dec->head_need; i++) {
+		arg = (arg << 8) | dec->head[i];
+	}
+
+	if (is_key) {
+		dec->key_len = 0;
+	} else if (frame_top(dec) != NULL && frame_top(dec)->map) {
+		item.key.value = (const uint8_t *)dec->key;
+		item.key.len = dec->key_len;
+	}
+
+	switch (major) {
+	case MAJOR_UINT:
+	case MAJOR_NINT:
+		item.type = (major == MAJOR_UINT) ? SMP_CBOR_UINT : SMP_CBOR_NINT;
+		if (major == MAJOR_UINT) {
+			item.uint = arg;
+		} else {
+			item.nint = -1 - (int64_t)arg;
+		}
+
+		/* Only text keys are kept. */
+		if (!is_key) {
+			emit(dec, &item);
+		}
+		item_end(dec);
+		break;
+	case MAJOR_BSTR:
+	case MAJOR_TSTR:
+		if (ai == AI_INDEF) {
+			dec->err = -ENOTSUP;
+			break;
+		}
+
+		item.type = (major == MAJOR_BSTR) ? SMP_CBOR_BSTR : SMP_CBOR_TSTR;
+		item.str.total = (size_t)arg;
+		dec->str = item;
+		dec->str_left = (size_t)arg;
+		dec->str_is_key = is_key;
+
+		if (arg == 0) {
+			if (!is_key) {
+				emit(dec, &dec->str);
+			}
+			item_end(dec);
+		}
+		break;
+	case MAJOR_ARRAY:
+	case MAJOR_MAP:
+		if (is_key) {
+			dec->err = -ENOTSUP;
+			break;
+		}
+
+		item.type = (major == MAJOR_ARRAY) ? SMP_CBOR_ARRAY : SMP_CBOR_MAP;
+		container_start(dec, &item, ai == AI_INDEF, arg);
+		break;
+	case MAJOR_TAG:
+		/* Tags only qualify the item that follows. */
+		break;
+	case MAJOR_SIMPLE:
+		if (ai == AI_INDEF) {
+			/* Break: only where an indefinite container may end. */
+			if (frame_top(dec) == NULL ||
+			    frame_top(dec)->remaining != SMP_CBOR_COUNT_INDEF ||
+			    (frame_top(dec)->map && !is_key)) {
+				dec->err = -EBADMSG;
+				break;
+			}
+
+			container_end(dec);
+			item_end(dec);
+			break;
+		}
+
+		item.type = (ai >= 25 && ai <= 27) ? SMP_CBOR_FLOAT : SMP_CBOR_SIMPLE;
+		item.uint = arg;
+		if (!is_key) {
+			emit(dec, &item);
+		}
+		item_end(dec);
+		break;
+	}
+}
+
+static size_t str_feed(struct smp_cbor_dec *dec, const uint8_t *data, size_t len)
+{
+	size_t n = MIN(dec->str_left, len);
+	size_t room;
+
+	if (dec->str_is_key) {
+		room = sizeof(dec->key) - dec->key_len;
+		memcpy(&dec->key[dec->key_len], data, MIN(n, room));
+		dec->key_len += MIN(n, room);
+	} else {
+		dec->str.str.part.value = data;
+		dec->str.str.part.len = n;
+		emit(dec, &dec->str);
+		dec->str.str.offset += n;
+	}
+
+	dec->str_left -= n;
+	if (dec->str_left == 0) {
+		item_end(dec);
+	}
+
+	return n;
+}
+
+static uint8_t head_arg_len(uint8_t ai)
+{
+	if (ai < 24 || ai == AI_INDEF) {
+		return 0;
+	}
+
+	return (ai <= 27) ? BIT(ai - 24) : UINT8_MAX;
+}
+
+void smp_cbor_init(struct smp_cbor_dec *dec, smp_cbor_item_cb_t cb, void *user_data)
+{
+	(void)memset(dec, 0, sizeof(*dec));
+	dec->cb = cb;
+	dec->user_data = user_data;
+}
+
+int smp_cbor_feed(struct smp_cbor_dec *dec, const uint8_t *data, size_t len)
+{
+	size_t pos = 0;
+	uint8_t arg_len;
+
+	while (pos < len && dec->err == 0) {
+		if (dec->str_left > 0) {
+			pos += str_feed(dec, &data[pos], len - pos);
+			continue;
+		}
+
+		if (dec->done) {
+			/* Trailing bytes after the top-level item. */
+			dec->err = -EBADMSG;
+			break;
+		}
+
+		if (dec->head_len == 0) {
+			dec->head[0] = data[pos++];
+			arg_len = head_arg_len(dec->head[0] & 0x1f);
+			if (arg_len == UINT8_MAX) {
+				dec->err = -EBADMSG;
+				break;
+			}
+
+			dec->head_len = 1;
+			dec->head_need = 1 + arg_len;
+		}
+
+		while (dec->head_len < dec->head_need && pos < len) {
+			dec->head[dec->head_len++] = data[pos++];
+		}
+
+		if (dec->head_len < dec->head_need) {
+			break;
+		}
+
+		dec->head_len = 0;
+		item_start(dec);
+	}
+
+	return dec->err;
+}
+
+int smp_cbor_finish(struct smp_cbor_dec *dec)
+{
+	if (dec->err != 0) {
+		return dec->err;
+	}
+
+	return dec->done ? 0 : -EBADMSG;
+}
@@ -0,0 +1,135 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef SMP_CBOR_H
+#define SMP_CBOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zcbor_common.h>
+
+/** Element count of an indefinite-length array or map. */
+#define SMP_CBOR_COUNT_INDEF SIZE_MAX
+
+enum smp_cbor_type {
+	SMP_CBOR_UINT,
+	SMP_CBOR_NINT,
+	SMP_CBOR_BSTR,
+	SMP_CBOR_TSTR,
+	SMP_CBOR_ARRAY,
+	SMP_CBOR_MAP,
+	/** End of the array or map opened at the same depth. */
+	SMP_CBOR_END,
+	/** false, true, null, undefined and other simple values. */
+	SMP_CBOR_SIMPLE,
+	/** Half, single or double precision float, as raw bits. */
+	SMP_CBOR_FLOAT,
+};
+
+/** One decoded CBOR item, valid for the duration of the callback only. */
+struct smp_cbor_item {
+	enum smp_cbor_type type;
+	/** 0 for the top-level item, 1 for the entries of a top-level map. */
+	uint8_t depth;
+	/** Text key of a map entry, truncated to CONFIG_SMP_CBOR_KEY_MAX; empty otherwise. */
+	struct zcbor_string key;
+	union {
+		/** UINT, SIMPLE and FLOAT */
+		uint64_t uint;
+		/** NINT */
+		int64_t nint;
+		/** ARRAY and MAP: element count, or SMP_CBOR_COUNT_INDEF */
+		size_t count;
+		/**
+		 * BSTR and TSTR: the part of the string within the current
+		 * fragment, as a view into it. A string split over fragments
+		 * is delivered as several parts.
+		 */
+		struct {
+			struct zcbor_string part;
+			size_t offset;
+			size_t total;
+		} str;
+	};
+};
+
+/**
+ * @brief Item callback
+ *
+ * @return 0 to go on decoding, negative errno to stop
+ */
+typedef int (*smp_cbor_item_cb_t)(const struct smp_cbor_item *item, void *user_data);
+
+struct smp_cbor_frame {
+	/* Items left, keys and values counted apart; SIZE_MAX if indefinite. */
+	size_t remaining;
+	bool map;
+	bool value_next;
+};
+
+/** Incremental CBOR decoder; the fields are private. */
+struct smp_cbor_dec {
+	smp_cbor_item_cb_t cb;
+	void *user_data;
+	struct smp_cbor_frame stack[CONFIG_SMP_CBOR_DEPTH_MAX];
+	uint8_t depth;
+	/* Item head, which may be split over fragments. */
+	uint8_t head[9];
+	uint8_t head_len;
+	uint8_t head_need;
+	/* String being delivered. */
+	struct smp_cbor_item str;
+	size_t str_left;
+	bool str_is_key;
+	char key[CONFIG_SMP_CBOR_KEY_MAX];
+	size_t key_len;
+	bool done;
+	int err;
+};
+
+/**
+ * @brief Start decoding a new CBOR item
+ */
+void smp_cbor_init(struct smp_cbor_dec *dec, smp_cbor_item_cb_t cb, void *user_data);
+
+/**
+ * @brief Decode the next fragment of the stream
+ *
+ * Fragments may be cut anywhere. Items are passed to the callback as soon
+ * as they are complete; strings as soon as any of their bytes arrive.
+ * Nothing is copied except map keys.
+ *
+ * @return 0 on success, negative errno of the first failure otherwise
+ */
+int smp_cbor_feed(struct smp_cbor_dec *dec, const uint8_t *data, size_t len);
+
+/**
+ * @brief End the stream
+ *
+ * @return 0 if exactly one complete item was decoded, negative errno otherwise
+ */
+int smp_cbor_finish(struct smp_cbor_dec *dec);
+
+/**
+ * @brief Check the map key of an item
+ */
+static inline bool smp_cbor_key_is(const struct smp_cbor_item *item, const char *key)
+{
+	size_t len = strlen(key);
+
+	return item->key.len == len && memcmp(item->key.value, key, len) == 0;
+}
+
+/**
+ * @brief Check whether a string part is the last one of its string
+ */
+static inline bool smp_cbor_str_last(const struct smp_cbor_item *item)
+{
+	return item->str.offset + item->str.part.len == item->str.total;
+}
+
+#endif /* SMP_CBOR_H */
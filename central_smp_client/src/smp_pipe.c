@@ -0,0 +1,555 @@
+/** @file
+ *  @brief Pipelined SMP commands over the DFU SMP service
+ *
+ * The DFU SMP client library accepts one command at a time, so every
+ * management command costs a full round trip. This pipeline writes the
+ * commands itself and keeps up to a window of them outstanding per
+ * connection. Each command gets its own sequence number and the responses
+ * are matched back to their command on it, and on its group, ID and
+ * operation, as soon as its header is in. The SMP server answers in order,
+ * one response after the other, so the payload that follows is fed
+ * straight to that command's CBOR decoder, whatever its size. A command longer than the ATT MTU goes out as
+ * consecutive writes for the server to reassemble, so only one command per
+ * connection is ever being written. The command buffers are shared by all
+ * connections.
+ *
+ * A response is only ever parsed on the Bluetooth RX thread. Commands time
+ * out on the system workqueue, but only those whose response has not
+ * started. A response that arrives after its command timed out is skipped
+ * by its length, so the next one is still found.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/sys/util.h>
+
+#include "smp_cbor.h"
+#include "smp_pipe.h"
+
+/* Back-off when the stack is out of ATT buffers for the next command. */
+#define SMP_PIPE_RETRY_MS 5
+
+/* Operation bits of the header's first byte; the SMP version sits above. */
+#define SMP_OP_MASK 0x07
+
+enum req_state {
+	REQ_FREE,
+	/* Owned by the caller, or by whoever completes it. */
+	REQ_ALLOCATED,
+	REQ_QUEUED,
+	REQ_IN_FLIGHT,
+	/* Response header in, payload being decoded on the RX thread. */
+	REQ_RECEIVING,
+};
+
+struct smp_pipe;
+
+struct smp_pipe_req {
+	struct smp_pipe_buf buf;
+	sys_snode_t node;
+	struct smp_pipe *pipe;
+	enum req_state state;
+	uint16_t len;
+	uint16_t sent;
+	smp_cbor_item_cb_t item_cb;
+	smp_pipe_cb_t cb;
+	void *user_data;
+};
+
+struct smp_pipe {
+	struct bt_conn *conn;
+	uint16_t smp_handle;
+	struct bt_gatt_subscribe_params sub_params;
+	struct k_work_delayable tx_work;
+	struct k_work_delayable timeout_work;
+	sys_slist_t queue;
+	size_t window;
+	size_t in_flight;
+	/* Command whose writes are not all out yet. */
+	struct smp_pipe_req *tx_req;
+	uint8_t next_seq;
+	/* Response being received: its command, once the header is in. Only
+	 * on_notify() and the connection callbacks, all on the RX thread, touch
+	 * these, with rsp_seen and rsp_req changed under the lock.
+	 */
+	struct bt_dfu_smp_header rsp_header;
+	size_t rsp_seen;
+	struct smp_pipe_req *rsp_req;
+	struct smp_cbor_dec rsp_dec;
+};
+
+static struct smp_pipe_req reqs[CONFIG_SMP_PIPE_BUF_COUNT];
+static struct smp_pipe pipes[CONFIG_BT_MAX_CONN];
+static struct k_spinlock lock;
+
+static struct smp_pipe *pipe_get(struct bt_conn *conn)
+{
+	return &pipes[bt_conn_index(conn)];
+}
+
+static bool seq_pending(struct smp_pipe *pipe, uint8_t seq)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(reqs); i++) {
+		if (reqs[i].pipe == pipe &&
+		    (reqs[i].state == REQ_QUEUED || reqs[i].state == REQ_IN_FLIGHT ||
+		     reqs[i].state == REQ_RECEIVING) &&
+		    reqs[i].buf.header.seq == seq) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Called with the lock held. The window is far below the 256 sequence
+ * numbers, so this only skips a number a lost response left behind.
+ */
+static uint8_t seq_alloc(struct smp_pipe *pipe)
+{
+	while (seq_pending(pipe, pipe->next_seq)) {
+		pipe->next_seq++;
+	}
+
+	return pipe->next_seq++;
+}
+
+static void req_complete(struct smp_pipe_req *req, int err, const struct bt_dfu_smp_header *rsp)
+{
+	k_spinlock_key_t key;
+
+	if (req->cb != NULL) {
+		req->cb(err, rsp, req->user_data);
+	}
+
+	key = k_spin_lock(&lock);
+	req->state = REQ_FREE;
+	req->pipe = NULL;
+	k_spin_unlock(&lock, key);
+}
+
+/* Complete every command of a pipe in the given state with an error. */
+static void req_fail_all(struct smp_pipe *pipe, enum req_state state, int err)
+{
+	struct smp_pipe_req *req;
+	k_spinlock_key_t key;
+
+	for (size_t i = 0; i < ARRAY_SIZE(reqs); i++) {
+		req = &reqs[i];
+
+		key = k_spin_lock(&lock);
+		if (req->pipe != pipe || req->state != state) {
+			k_spin_unlock(&lock, key);
+			continue;
+		}
+
+		if (state == REQ_QUEUED) {
+			(void)sys_slist_find_and_remove(&pipe->queue, &req->node);
+		} else {
+			pipe->in_flight--;
+		}
+
+		if (req == pipe->tx_req) {
+			pipe->tx_req = NULL;
+		}
+
+		if (req == pipe->rsp_req) {
+			pipe->rsp_req = NULL;
+		}
+
+		req->state = REQ_ALLOCATED;
+		k_spin_unlock(&lock, key);
+
+		req_complete(req, err, NULL);
+	}
+}
+
+static void tx_work_fn(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct smp_pipe *pipe = CONTAINER_OF(dwork, struct smp_pipe, tx_work);
+	struct smp_pipe_req *req;
+	struct bt_conn *conn;
+	k_spinlock_key_t key;
+	size_t len;
+	int err;
+
+	for (;;) {
+		key = k_spin_lock(&lock);
+		if (pipe->conn == NULL) {
+			k_spin_unlock(&lock, key);
+			return;
+		}
+
+		if (pipe->tx_req == NULL) {
+			if (pipe->in_flight >= pipe->window || sys_slist_is_empty(&pipe->queue)) {
+				k_spin_unlock(&lock, key);
+				return;
+			}
+
+			pipe->tx_req = CONTAINER_OF(sys_slist_get_not_empty(&pipe->queue),
+						    struct smp_pipe_req, node);
+			pipe->tx_req->sent = 0;
+
+			/* In flight before the write: the response may beat its return. */
+			pipe->tx_req->state = REQ_IN_FLIGHT;
+			pipe->in_flight++;
+		}
+
+		req = pipe->tx_req;
+		conn = pipe->conn;
+		k_spin_unlock(&lock, key);
+
+		len = MIN(req->len - req->sent, bt_gatt_get_mtu(conn) - 3);
+		err = bt_gatt_write_without_response(conn, pipe->smp_handle,
+						     (uint8_t *)&req->buf + req->sent, len, false);
+		if (err == -ENOMEM) {
+			/* Out of ATT buffers, try again once some went out. */
+			(void)k_work_reschedule(&pipe->tx_work, K_MSEC(SMP_PIPE_RETRY_MS));
+			return;
+		}
+
+		key = k_spin_lock(&lock);
+		if (req != pipe->tx_req) {
+			/* Failed by smp_pipe_stop() or a timeout meanwhile. */
+			k_spin_unlock(&lock, key);
+			continue;
+		}
+
+		if (err == 0) {
+			req->sent += len;
+			if (req->sent == req->len) {
+				pipe->tx_req = NULL;
+			}
+			k_spin_unlock(&lock, key);
+
+			(void)k_work_reschedule(&pipe->timeout_work,
+						K_MSEC(CONFIG_SMP_PIPE_TIMEOUT_MS));
+			continue;
+		}
+
+		pipe->tx_req = NULL;
+		pipe->in_flight--;
+		req->state = REQ_ALLOCATED;
+		k_spin_unlock(&lock, key);
+
+		printk("SMP command %u not sent (err %d)\n", req->buf.header.seq, err);
+		req_complete(req, err, NULL);
+	}
+}
+
+static void timeout_work_fn(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct smp_pipe *pipe = CONTAINER_OF(dwork, struct smp_pipe, timeout_work);
+
+	printk("SMP response timeout, %zu commands lost\n", pipe->in_flight);
+
+	/* A response being received keeps rearming the timeout, so it is left
+	 * to complete, or to fail when the connection goes.
+	 */
+	req_fail_all(pipe, REQ_IN_FLIGHT, -ETIMEDOUT);
+	(void)k_work_reschedule(&pipe->tx_work, K_NO_WAIT);
+}
+
+/* A response answers a command with its sequence number, group and ID, the
+ * write or read answered by the matching response operation. Sequence
+ * numbers alone are not enough: a late response to a timed-out command, or
+ * a frame the server pushes unrequested, may carry one that was reused.
+ */
+static bool rsp_matches(const struct smp_pipe_req *req, const struct bt_dfu_smp_header *rsp)
+{
+	const struct bt_dfu_smp_header *cmd = &req->buf.header;
+
+	return rsp->seq == cmd->seq && rsp->group_h8 == cmd->group_h8 &&
+	       rsp->group_l8 == cmd->group_l8 && rsp->id == cmd->id &&
+	       (rsp->op & SMP_OP_MASK) == (cmd->op & SMP_OP_MASK) + 1;
+}
+
+static void rsp_begin(struct smp_pipe *pipe)
+{
+	struct smp_pipe_req *req = NULL;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	for (size_t i = 0; i < ARRAY_SIZE(reqs); i++) {
+		if (reqs[i].pipe == pipe && reqs[i].state == REQ_IN_FLIGHT &&
+		    rsp_matches(&reqs[i], &pipe->rsp_header)) {
+			req = &reqs[i];
+			/* From here on the timeout no longer fails it. */
+			req->state = REQ_RECEIVING;
+			break;
+		}
+	}
+	pipe->rsp_req = req;
+	k_spin_unlock(&lock, key);
+
+	if (req == NULL) {
+		/* Timed out already, pushed unrequested or never sent: skip it by
+		 * its length, leaving every command as it was.
+		 */
+		printk("SMP frame op %u group %u id %u seq %u matches no command, skipped\n",
+		       pipe->rsp_header.op & SMP_OP_MASK,
+		       ((uint16_t)pipe->rsp_header.group_h8 << 8) | pipe->rsp_header.group_l8,
+		       pipe->rsp_header.id, pipe->rsp_header.seq);
+		return;
+	}
+
+	smp_cbor_init(&pipe->rsp_dec, req->item_cb, req->user_data);
+}
+
+static void rsp_done(struct smp_pipe *pipe)
+{
+	struct smp_pipe_req *req = NULL;
+	k_spinlock_key_t key;
+	bool idle;
+	int err;
+
+	key = k_spin_lock(&lock);
+	if (pipe->rsp_req != NULL && pipe->rsp_req->state == REQ_RECEIVING) {
+		req = pipe->rsp_req;
+		req->state = REQ_ALLOCATED;
+		pipe->in_flight--;
+	}
+	pipe->rsp_req = NULL;
+	idle = (pipe->in_flight == 0);
+	k_spin_unlock(&lock, key);
+
+	if (req == NULL) {
+		return;
+	}
+
+	if (idle) {
+		(void)k_work_cancel_delayable(&pipe->timeout_work);
+	} else {
+		(void)k_work_reschedule(&pipe->timeout_work, K_MSEC(CONFIG_SMP_PIPE_TIMEOUT_MS));
+	}
+
+	err = (req->item_cb != NULL) ? smp_cbor_finish(&pipe->rsp_dec) : 0;
+	if (err) {
+		printk("SMP response %u not decoded (err %d)\n", pipe->rsp_header.seq, err);
+	}
+
+	req_complete(req, err, &pipe->rsp_header);
+
+	/* The window has room again. */
+	(void)k_work_reschedule(&pipe->tx_work, K_NO_WAIT);
+}
+
+static uint8_t on_notify(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+			 const void *data, uint16_t length)
+{
+	struct smp_pipe *pipe = CONTAINER_OF(params, struct smp_pipe, sub_params);
+	const uint8_t *in = data;
+	k_spinlock_key_t key;
+	size_t total;
+	size_t n;
+
+	if (data == NULL) {
+		params->value_handle = 0;
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (pipe->rsp_seen < sizeof(pipe->rsp_header)) {
+		n = MIN(length, sizeof(pipe->rsp_header) - pipe->rsp_seen);
+		memcpy((uint8_t *)&pipe->rsp_header + pipe->rsp_seen, in, n);
+		key = k_spin_lock(&lock);
+		pipe->rsp_seen += n;
+		k_spin_unlock(&lock, key);
+		in += n;
+		length -= n;
+
+		if (pipe->rsp_seen < sizeof(pipe->rsp_header)) {
+			return BT_GATT_ITER_CONTINUE;
+		}
+
+		rsp_begin(pipe);
+	}
+
+	total = sizeof(pipe->rsp_header) +
+		(((uint16_t)pipe->rsp_header.len_h8) << 8 | pipe->rsp_header.len_l8);
+	n = MIN(length, total - pipe->rsp_seen);
+
+	/* The views handed to the decoder callback point into this notification. */
+	if (pipe->rsp_req != NULL && pipe->rsp_req->item_cb != NULL && n > 0) {
+		(void)smp_cbor_feed(&pipe->rsp_dec, in, n);
+	}
+
+	key = k_spin_lock(&lock);
+	pipe->rsp_seen += n;
+	k_spin_unlock(&lock, key);
+
+	if (pipe->rsp_seen == total) {
+		rsp_done(pipe);
+
+		key = k_spin_lock(&lock);
+		pipe->rsp_seen = 0;
+		k_spin_unlock(&lock, key);
+	} else if (pipe->in_flight > 0) {
+		/* A long response is progress too. */
+		(void)k_work_reschedule(&pipe->timeout_work, K_MSEC(CONFIG_SMP_PIPE_TIMEOUT_MS));
+	}
+
+	return BT_GATT_ITER_CONTINUE;
+}
+
+int smp_pipe_start(struct bt_conn *conn, const struct bt_dfu_smp *dfu_smp)
+{
+	struct smp_pipe *pipe = pipe_get(conn);
+	k_spinlock_key_t key;
+	int err;
+
+	pipe->sub_params.notify = on_notify;
+	pipe->sub_params.value = BT_GATT_CCC_NOTIFY;
+	pipe->sub_params.value_handle = dfu_smp->handles.smp;
+	pipe->sub_params.ccc_handle = dfu_smp->handles.smp_ccc;
+	atomic_set_bit(pipe->sub_params.flags, BT_GATT_SUBSCRIBE_FLAG_VOLATILE);
+
+	err = bt_gatt_subscribe(conn, &pipe->sub_params);
+	if (err != 0 && err != -EALREADY) {
+		return err;
+	}
+
+	k_work_init_delayable(&pipe->tx_work, tx_work_fn);
+	k_work_init_delayable(&pipe->timeout_work, timeout_work_fn);
+
+	key = k_spin_lock(&lock);
+	pipe->conn = conn;
+	pipe->smp_handle = dfu_smp->handles.smp;
+	pipe->window = CONFIG_SMP_PIPE_WINDOW;
+	pipe->in_flight = 0;
+	pipe->tx_req = NULL;
+	pipe->rsp_req = NULL;
+	pipe->rsp_seen = 0;
+	sys_slist_init(&pipe->queue);
+	k_spin_unlock(&lock, key);
+
+	return 0;
+}
+
+void smp_pipe_stop(struct bt_conn *conn)
+{
+	struct smp_pipe *pipe = pipe_get(conn);
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	if (pipe->conn != conn) {
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	pipe->conn = NULL;
+	pipe->rsp_seen = 0;
+	k_spin_unlock(&lock, key);
+
+	(void)k_work_cancel_delayable(&pipe->tx_work);
+	(void)k_work_cancel_delayable(&pipe->timeout_work);
+
+	req_fail_all(pipe, REQ_RECEIVING, -ENOTCONN);
+	req_fail_all(pipe, REQ_IN_FLIGHT, -ENOTCONN);
+	req_fail_all(pipe, REQ_QUEUED, -ENOTCONN);
+}
+
+bool smp_pipe_ready(struct bt_conn *conn)
+{
+	return conn != NULL && pipe_get(conn)->conn == conn;
+}
+
+size_t smp_pipe_write_len(struct bt_conn *conn)
+{
+	return smp_pipe_ready(conn) ? bt_gatt_get_mtu(conn) - 3 : 0;
+}
+
+int smp_pipe_window_set(struct bt_conn *conn, size_t size)
+{
+	struct smp_pipe *pipe = pipe_get(conn);
+
+	if (size == 0 || size > ARRAY_SIZE(reqs)) {
+		return -EINVAL;
+	}
+
+	if (pipe->conn != conn) {
+		return -ENOTCONN;
+	}
+
+	pipe->window = size;
+	(void)k_work_reschedule(&pipe->tx_work, K_NO_WAIT);
+
+	return 0;
+}
+
+struct smp_pipe_buf *smp_pipe_buf_alloc(void)
+{
+	struct smp_pipe_req *req = NULL;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	for (size_t i = 0; i < ARRAY_SIZE(reqs); i++) {
+		if (reqs[i].state == REQ_FREE) {
+			req = &reqs[i];
+			req->state = REQ_ALLOCATED;
+			break;
+		}
+	}
+	k_spin_unlock(&lock, key);
+
+	if (req == NULL) {
+		return NULL;
+	}
+
+	(void)memset(&req->buf.header, 0, sizeof(req->buf.header));
+
+	return &req->buf;
+}
+
+void smp_pipe_buf_free(struct smp_pipe_buf *buf)
+{
+	struct smp_pipe_req *req = CONTAINER_OF(buf, struct smp_pipe_req, buf);
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	req->state = REQ_FREE;
+	req->pipe = NULL;
+	k_spin_unlock(&lock, key);
+}
+
+int smp_pipe_send(struct bt_conn *conn, struct smp_pipe_buf *buf, size_t payload_len,
+		  smp_cbor_item_cb_t item_cb, smp_pipe_cb_t cb, void *user_data)
+{
+	struct smp_pipe_req *req = CONTAINER_OF(buf, struct smp_pipe_req, buf);
+	struct smp_pipe *pipe = pipe_get(conn);
+	k_spinlock_key_t key;
+
+	if (payload_len > sizeof(buf->payload)) {
+		return -EMSGSIZE;
+	}
+
+	key = k_spin_lock(&lock);
+	if (pipe->conn != conn) {
+		k_spin_unlock(&lock, key);
+		return -ENOTCONN;
+	}
+
+	buf->header.len_h8 = (uint8_t)((payload_len >> 8) & 0xFF);
+	buf->header.len_l8 = (uint8_t)((payload_len >> 0) & 0xFF);
+	buf->header.seq = seq_alloc(pipe);
+
+	req->pipe = pipe;
+	req->len = sizeof(buf->header) + payload_len;
+	req->item_cb = item_cb;
+	req->cb = cb;
+	req->user_data = user_data;
+	req->state = REQ_QUEUED;
+	sys_slist_append(&pipe->queue, &req->node);
+	k_spin_unlock(&lock, key);
+
+	(void)k_work_reschedule(&pipe->tx_work, K_NO_WAIT);
+
+	return 0;
+}
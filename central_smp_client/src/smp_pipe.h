@@ -0,0 +1,106 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef SMP_PIPE_H
+#define SMP_PIPE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <bluetooth/services/dfu_smp.h>
+
+#include "smp_cbor.h"
+
+/** SMP command buffer taken from the pipeline pool. */
+struct smp_pipe_buf {
+	struct bt_dfu_smp_header header;
+	uint8_t payload[CONFIG_SMP_PIPE_PAYLOAD_SIZE];
+};
+
+/**
+ * @brief Completion of one pipelined command
+ *
+ * Called once per submitted command, from the Bluetooth receive thread or
+ * from the system work queue, after the last item of the response.
+ *
+ * @param err 0 when the whole response was received and decoded,
+ *	      negative errno otherwise
+ * @param rsp Response header, NULL if no response was received
+ * @param user_data Pointer passed to smp_pipe_send()
+ */
+typedef void (*smp_pipe_cb_t)(int err, const struct bt_dfu_smp_header *rsp, void *user_data);
+
+/**
+ * @brief Attach a pipeline to the discovered SMP service of a connection
+ *
+ * Subscribes to the SMP characteristic itself, so that responses to
+ * several outstanding commands can be matched on their sequence number.
+ * The window starts at CONFIG_SMP_PIPE_WINDOW.
+ *
+ * @return 0 on success, negative errno on failure
+ */
+int smp_pipe_start(struct bt_conn *conn, const struct bt_dfu_smp *dfu_smp);
+
+/**
+ * @brief Detach the pipeline of a connection, failing every pending command
+ *	  with -ENOTCONN
+ */
+void smp_pipe_stop(struct bt_conn *conn);
+
+/**
+ * @brief Check whether a connection has a pipeline attached
+ */
+bool smp_pipe_ready(struct bt_conn *conn);
+
+/**
+ * @brief Set the number of commands kept outstanding on the air
+ *
+ * @return 0 on success, -EINVAL if the window is 0 or larger than the pool,
+ *	   -ENOTCONN if the connection has no pipeline
+ */
+int smp_pipe_window_set(struct bt_conn *conn, size_t size);
+
+/**
+ * @brief Get the number of command bytes that fit in one ATT write
+ *
+ * Longer commands are split over several writes, which the SMP server
+ * has to reassemble.
+ *
+ * @return Write length for the current MTU, 0 if the pipeline is not attached
+ */
+size_t smp_pipe_write_len(struct bt_conn *conn);
+
+/**
+ * @brief Take a command buffer from the pool shared by all connections
+ *
+ * @return Buffer to encode the command into, NULL if the pool is empty
+ */
+struct smp_pipe_buf *smp_pipe_buf_alloc(void);
+
+/**
+ * @brief Return a buffer that was not submitted to the pool
+ */
+void smp_pipe_buf_free(struct smp_pipe_buf *buf);
+
+/**
+ * @brief Queue a command on a connection
+ *
+ * The caller fills in the operation, group and command ID of the header;
+ * the length and sequence number are set here. The command goes on the
+ * air as soon as the window allows, and the buffer returns to the pool
+ * once @p cb has been called.
+ *
+ * The response payload is decoded while its notifications arrive and
+ * passed to @p item_cb item by item, with strings as views into the
+ * notification, so no response buffer is involved whatever its size.
+ * With a NULL @p item_cb, the payload is not decoded at all.
+ *
+ * @return 0 on success, -ENOTCONN if the pipeline is not attached
+ */
+int smp_pipe_send(struct bt_conn *conn, struct smp_pipe_buf *buf, size_t payload_len,
+		  smp_cbor_item_cb_t item_cb, smp_pipe_cb_t cb, void *user_data);
+
+#endif /* SMP_PIPE_H */
@@ -0,0 +1,541 @@
+/** @file
+ *  @brief Pipelined image upload to the SMP server
+ *
+ * The image management group answers every upload chunk with the offset it
+ * wants next. It drops a chunk that does not start at that offset, but
+ * still answers it. Several chunks can then be kept in flight: as long as
+ * they arrive in order, every answer is the end of its chunk. Anything
+ * else means a chunk went missing or the server already holds more of the
+ * image, and the upload goes on from the offset the server named. Chunks
+ * sent before that are recognised by their generation and their answers
+ * ignored.
+ *
+ * Every connection has its own upload, so the same image can go to several
+ * servers at once. Each keeps at most CONFIG_SMP_UPLOAD_WINDOW chunks
+ * queued, leaving the rest of the shared buffer pool to the others.
+ *
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include <zcbor_encode.h>
+
+#include "smp_cbor.h"
+#include "smp_pipe.h"
+#include "smp_upload.h"
+
+#define CBOR_ENCODER_STATE_NUM 2
+#define CBOR_MAP_MAX_ELEMENT_CNT 5
+
+#define SMP_OP_WRITE      2
+#define SMP_GROUP_IMAGE   1
+#define SMP_ID_IMG_UPLOAD 1
+
+/* MCUboot image header and TLV info, as far as they are needed here. */
+#define IMAGE_MAGIC       0x96f3b83d
+#define IMAGE_HEADER_SIZE 32
+#define IMAGE_TLV_INFO_MAGIC 0x6907
+#define IMAGE_TLV_INFO_SIZE  4
+
+/* Room for the CBOR map around the data of the first chunk, the largest. */
+#define UPLOAD_CBOR_OVERHEAD 48
+
+BUILD_ASSERT(CONFIG_SMP_PIPE_PAYLOAD_SIZE >= 4 * UPLOAD_CBOR_OVERHEAD,
+	     "Command payload too small for image upload");
+
+/* Sent as "sha" with the first chunk: the server resumes an upload only
+ * for the same value. The CRC-32 of the image, plus the window, so the
+ * pipelined pass does not resume the baseline one.
+ */
+#define UPLOAD_ID_LEN 5
+
+static const uint8_t upload_windows[] = {1, CONFIG_SMP_UPLOAD_WINDOW};
+
+struct upload;
+
+struct upload_chunk {
+	struct upload *up;
+	uint32_t off;
+	uint32_t len;
+	uint32_t gen;
+	bool used;
+	/* Answer of the server. */
+	int32_t rsp_rc;
+	uint32_t rsp_off;
+	bool rsp_has_off;
+};
+
+struct upload {
+	struct bt_conn *conn;
+	struct k_work work;
+	smp_upload_cb_t done;
+	bool running;
+	/* First chunk answered: more than one chunk may go out. */
+	bool primed;
+	int err;
+	size_t pass;
+	size_t last_pass;
+	uint32_t chunk_len;
+	uint32_t next_off;
+	uint32_t acked_off;
+	uint32_t start_off;
+	uint32_t gen;
+	uint32_t rewinds;
+	uint8_t id[UPLOAD_ID_LEN];
+	int64_t start_ms;
+	uint32_t base_rate;
+	struct upload_chunk chunks[CONFIG_SMP_UPLOAD_WINDOW];
+};
+
+static struct upload uploads[CONFIG_BT_MAX_CONN];
+static struct k_spinlock lock;
+
+/* The image is opened by the first upload and closed by the last one. */
+static struct {
+	size_t users;
+	uint32_t size;
+	uint32_t crc;
+} image;
+
+/* Only used from the system work queue. */
+static uint8_t chunk_data[CONFIG_SMP_PIPE_PAYLOAD_SIZE];
+
+#if defined(CONFIG_SMP_UPLOAD_FLASH)
+static const struct flash_area *fa;
+#else
+static uint8_t mock_header[IMAGE_HEADER_SIZE];
+#endif
+
+#if defined(CONFIG_SMP_UPLOAD_FLASH)
+static int image_open(uint32_t *size)
+{
+	uint8_t hdr[IMAGE_HEADER_SIZE];
+	uint8_t tlv[IMAGE_TLV_INFO_SIZE];
+	uint32_t tlv_off;
+	int err;
+
+	err = flash_area_open(FIXED_PARTITION_ID(slot1_partition), &fa);
+	if (err) {
+		return err;
+	}
+
+	err = flash_area_read(fa, 0, hdr, sizeof(hdr));
+	if (err) {
+		goto fail;
+	}
+
+	if (sys_get_le32(&hdr[0]) != IMAGE_MAGIC) {
+		err = -ENOENT;
+		goto fail;
+	}
+
+	/* Header, image, protected TLVs, then the unprotected TLV area. */
+	tlv_off = sys_get_le16(&hdr[8]) + sys_get_le32(&hdr[12]) + sys_get_le16(&hdr[10]);
+	err = flash_area_read(fa, tlv_off, tlv, sizeof(tlv));
+	if (err) {
+		goto fail;
+	}
+
+	if (sys_get_le16(&tlv[0]) != IMAGE_TLV_INFO_MAGIC) {
+		err = -ENOENT;
+		goto fail;
+	}
+
+	*size = tlv_off + sys_get_le16(&tlv[2]);
+	if (*size > fa->fa_size) {
+		err = -EFBIG;
+		goto fail;
+	}
+
+	return 0;
+
+fail:
+	flash_area_close(fa);
+	return err;
+}
+
+static void image_close(void)
+{
+	flash_area_close(fa);
+}
+
+static int image_read(uint32_t off, uint8_t *dst, size_t len)
+{
+	return flash_area_read(fa, off, dst, len);
+}
+#else
+/* Not bootable: only the header is checked on upload. */
+static int image_open(uint32_t *size)
+{
+	*size = CONFIG_SMP_UPLOAD_MOCK_SIZE;
+
+	(void)memset(mock_header, 0, sizeof(mock_header));
+	sys_put_le32(IMAGE_MAGIC, &mock_header[0]);
+	sys_put_le16(IMAGE_HEADER_SIZE, &mock_header[8]);
+	sys_put_le32(*size - IMAGE_HEADER_SIZE, &mock_header[12]);
+
+	return 0;
+}
+
+static void image_close(void)
+{
+}
+
+static int image_read(uint32_t off, uint8_t *dst, size_t len)
+{
+	for (size_t i = 0; i < len; i++, off++) {
+		dst[i] = (off < sizeof(mock_header)) ? mock_header[off] : (uint8_t)(off ^ (off >> 8));
+	}
+
+	return 0;
+}
+#endif /* CONFIG_SMP_UPLOAD_FLASH */
+
+static int image_crc(uint32_t *crc)
+{
+	int err;
+
+	*crc = 0;
+
+	for (uint32_t off = 0; off < image.size; off += sizeof(chunk_data)) {
+		size_t len = MIN(sizeof(chunk_data), image.size - off);
+
+		err = image_read(off, chunk_data, len);
+		if (err) {
+			return err;
+		}
+
+		*crc = crc32_ieee_update(*crc, chunk_data, len);
+	}
+
+	return 0;
+}
+
+static struct upload_chunk *chunk_alloc(struct upload *up)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(up->chunks); i++) {
+		if (!up->chunks[i].used) {
+			up->chunks[i].used = true;
+			return &up->chunks[i];
+		}
+	}
+
+	return NULL;
+}
+
+static bool chunks_out(const struct upload *up)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(up->chunks); i++) {
+		if (up->chunks[i].used) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int chunk_encode(struct smp_pipe_buf *buf, const struct upload_chunk *chunk)
+{
+	zcbor_state_t zse[CBOR_ENCODER_STATE_NUM];
+	int err;
+
+	err = image_read(chunk->off, chunk_data, chunk->len);
+	if (err) {
+		return err;
+	}
+
+	zcbor_new_encode_state(zse, ARRAY_SIZE(zse), buf->payload, sizeof(buf->payload), 0);
+
+	zcbor_map_start_encode(zse, CBOR_MAP_MAX_ELEMENT_CNT);
+	if (chunk->off == 0) {
+		zcbor_tstr_put_lit(zse, "image");
+		zcbor_uint32_put(zse, 0);
+		zcbor_tstr_put_lit(zse, "len");
+		zcbor_uint32_put(zse, image.size);
+		zcbor_tstr_put_lit(zse, "sha");
+		zcbor_bstr_encode_ptr(zse, (const char *)chunk->up->id, sizeof(chunk->up->id));
+	}
+	zcbor_tstr_put_lit(zse, "off");
+	zcbor_uint32_put(zse, chunk->off);
+	zcbor_tstr_put_lit(zse, "data");
+	zcbor_bstr_encode_ptr(zse, (const char *)chunk_data, chunk->len);
+	zcbor_map_end_encode(zse, CBOR_MAP_MAX_ELEMENT_CNT);
+
+	if (!zcbor_check_error(zse)) {
+		return -EFAULT;
+	}
+
+	buf->header.op = SMP_OP_WRITE;
+	buf->header.group_l8 = SMP_GROUP_IMAGE;
+	buf->header.id = SMP_ID_IMG_UPLOAD;
+
+	return (int)(zse->payload - buf->payload);
+}
+
+static int chunk_rsp_item(const struct smp_cbor_item *item, void *user_data)
+{
+	struct upload_chunk *chunk = user_data;
+
+	if (item->depth != 1) {
+		return 0;
+	}
+
+	if (smp_cbor_key_is(item, "off") && item->type == SMP_CBOR_UINT) {
+		chunk->rsp_off = (uint32_t)item->uint;
+		chunk->rsp_has_off = true;
+	} else if (smp_cbor_key_is(item, "rc")) {
+		chunk->rsp_rc = (item->type == SMP_CBOR_NINT) ? (int32_t)item->nint
+							       : (int32_t)item->uint;
+	}
+
+	return 0;
+}
+
+static void upload_rsp(int err, const struct bt_dfu_smp_header *rsp, void *user_data)
+{
+	struct upload_chunk *chunk = user_data;
+	struct upload *up = chunk->up;
+	uint32_t end = chunk->off + chunk->len;
+	uint32_t gen = chunk->gen;
+	uint32_t off = chunk->rsp_off;
+	k_spinlock_key_t key;
+
+	if (err == 0 && chunk->rsp_rc != 0) {
+		printk("SMP upload: rejected at offset %u (rc %d)\n", chunk->off, chunk->rsp_rc);
+		err = -EIO;
+	} else if (err == 0 && !chunk->rsp_has_off) {
+		err = -EBADMSG;
+	}
+
+	key = k_spin_lock(&lock);
+	chunk->used = false;
+
+	if (!up->running || up->err != 0 || gen != up->gen) {
+		/* Sent before the last rewind; its answer says nothing new. */
+	} else if (err == -ETIMEDOUT) {
+		up->gen++;
+		up->next_off = up->acked_off;
+		up->rewinds++;
+	} else if (err != 0) {
+		up->err = err;
+	} else {
+		if (!up->primed && off > end) {
+			printk("SMP upload: resuming at offset %u\n", off);
+			up->start_off = off;
+		}
+
+		up->primed = true;
+		up->acked_off = off;
+
+		if (off != end && off != image.size) {
+			up->gen++;
+			up->next_off = off;
+			up->rewinds++;
+		}
+	}
+	k_spin_unlock(&lock, key);
+
+	k_work_submit(&up->work);
+}
+
+/* Keep the chunks queued; the pipeline window decides how much goes on air. */
+static int upload_fill(struct upload *up)
+{
+	struct smp_pipe_buf *buf;
+	struct upload_chunk *chunk;
+	k_spinlock_key_t key;
+	int len;
+	int err;
+
+	for (;;) {
+		buf = smp_pipe_buf_alloc();
+		if (buf == NULL) {
+			return 0;
+		}
+
+		key = k_spin_lock(&lock);
+		chunk = NULL;
+		if (up->next_off < image.size && (up->primed || !chunks_out(up))) {
+			chunk = chunk_alloc(up);
+		}
+
+		if (chunk != NULL) {
+			chunk->up = up;
+			chunk->off = up->next_off;
+			chunk->len = MIN(up->chunk_len, image.size - up->next_off);
+			chunk->gen = up->gen;
+			chunk->rsp_rc = 0;
+			chunk->rsp_has_off = false;
+			up->next_off += chunk->len;
+		}
+		k_spin_unlock(&lock, key);
+
+		if (chunk == NULL) {
+			smp_pipe_buf_free(buf);
+			return 0;
+		}
+
+		len = chunk_encode(buf, chunk);
+		err = (len < 0) ? len
+				: smp_pipe_send(up->conn, buf, len, chunk_rsp_item, upload_rsp, chunk);
+		if (err) {
+			smp_pipe_buf_free(buf);
+			chunk->used = false;
+			return err;
+		}
+	}
+}
+
+static void pass_begin(struct upload *up, size_t pass)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	up->pass = pass;
+	up->primed = false;
+	up->gen++;
+	up->next_off = 0;
+	up->acked_off = 0;
+	up->start_off = 0;
+	up->rewinds = 0;
+	k_spin_unlock(&lock, key);
+
+	sys_put_le32(image.crc, up->id);
+	up->id[4] = upload_windows[pass];
+
+	(void)smp_pipe_window_set(up->conn, upload_windows[pass]);
+	up->start_ms = k_uptime_get();
+}
+
+static void pass_report(struct upload *up)
+{
+	uint32_t elapsed_ms = (uint32_t)(k_uptime_get() - up->start_ms);
+	uint32_t bytes = image.size - up->start_off;
+	uint32_t rate = (elapsed_ms > 0) ? (uint32_t)((bytes * 1000ULL) / elapsed_ms) : 0U;
+
+	printk("SMP upload %u: window %u, %u bytes in %u ms, %u B/s, %u chunks of %u, "
+	       "%u rewinds\n",
+	       bt_conn_index(up->conn), upload_windows[up->pass], bytes, elapsed_ms, rate,
+	       DIV_ROUND_UP(bytes, up->chunk_len), up->chunk_len, up->rewinds);
+
+	if (up->pass == 0) {
+		up->base_rate = rate;
+	} else if (up->base_rate > 0) {
+		printk("SMP upload %u: x%u.%02u over stop-and-wait\n", bt_conn_index(up->conn),
+		       rate / up->base_rate, ((rate * 100U) / up->base_rate) % 100U);
+	}
+}
+
+static void upload_finish(struct upload *up, int err)
+{
+	smp_upload_cb_t done = up->done;
+	struct bt_conn *conn = up->conn;
+
+	if (--image.users == 0) {
+		image_close();
+	}
+
+	(void)smp_pipe_window_set(conn, CONFIG_SMP_PIPE_WINDOW);
+	up->running = false;
+
+	if (done != NULL) {
+		done(conn, err);
+	}
+}
+
+static void upload_work_fn(struct k_work *work)
+{
+	struct upload *up = CONTAINER_OF(work, struct upload, work);
+	int err;
+
+	if (!up->running) {
+		return;
+	}
+
+	if (up->err != 0) {
+		printk("SMP upload %u: stopped at offset %u (err %d)\n", bt_conn_index(up->conn),
+		       up->acked_off, up->err);
+		upload_finish(up, up->err);
+		return;
+	}
+
+	if (up->acked_off == image.size) {
+		pass_report(up);
+
+		if (up->pass == up->last_pass) {
+			upload_finish(up, 0);
+			return;
+		}
+
+		pass_begin(up, up->pass + 1);
+	}
+
+	err = upload_fill(up);
+	if (err) {
+		printk("SMP upload %u: stopped (err %d)\n", bt_conn_index(up->conn), err);
+		upload_finish(up, err);
+	}
+}
+
+int smp_upload_start(struct bt_conn *conn, bool baseline, smp_upload_cb_t done)
+{
+	size_t cmd_len = sizeof(struct bt_dfu_smp_header) + CONFIG_SMP_PIPE_PAYLOAD_SIZE;
+	size_t write_len;
+	struct upload *up;
+	int err;
+
+	if (!smp_pipe_ready(conn)) {
+		return -ENOTCONN;
+	}
+
+	up = &uploads[bt_conn_index(conn)];
+	if (up->running || k_work_busy_get(&up->work) != 0) {
+		return -EBUSY;
+	}
+
+	write_len = smp_pipe_write_len(conn);
+
+	if (image.users == 0) {
+		err = image_open(&image.size);
+		if (err) {
+			return err;
+		}
+
+		err = image_crc(&image.crc);
+		if (err) {
+			image_close();
+			return err;
+		}
+
+		printk("SMP upload: %u byte image, crc 0x%08x\n", image.size, image.crc);
+	}
+	image.users++;
+
+	/* Fill whole writes; the last one of each chunk is not cut short. */
+	if (cmd_len > write_len) {
+		cmd_len -= cmd_len % write_len;
+	}
+	up->chunk_len = cmd_len - sizeof(struct bt_dfu_smp_header) - UPLOAD_CBOR_OVERHEAD;
+
+	up->conn = conn;
+	up->done = done;
+	up->err = 0;
+	up->base_rate = 0;
+	up->last_pass = ARRAY_SIZE(upload_windows) - 1;
+	up->running = true;
+	k_work_init(&up->work, upload_work_fn);
+
+	pass_begin(up, baseline ? 0 : up->last_pass);
+	k_work_submit(&up->work);
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * SPDX-License-Identifier: LicenseRef-Nordic-5-Clause
+ */
+
+#ifndef SMP_UPLOAD_H
+#define SMP_UPLOAD_H
+
+#include <stdbool.h>
+
+#include <zephyr/bluetooth/conn.h>
+
+/**
+ * @brief Completion of an upload
+ *
+ * Called from the system work queue once the last pass is done.
+ *
+ * @param err 0 when the server holds the whole image, negative errno otherwise
+ */
+typedef void (*smp_upload_cb_t)(struct bt_conn *conn, int err);
+
+/**
+ * @brief Upload an image to slot 1 of the SMP server through the pipeline
+ *
+ * Chunks are sized to fill whole ATT writes and several of them are kept
+ * in flight. When the server answers with an offset other than the end of
+ * a chunk, the upload goes on from that offset, which also picks up an
+ * upload of the same image that was cut short earlier. With @p baseline,
+ * the image is first uploaded stop-and-wait and both rates are printed.
+ * Uploads to several connections may run at the same time.
+ *
+ * @param done Called when the upload ends, may be NULL
+ *
+ * @return 0 on success, -EBUSY if an upload is already running on the
+ *	   connection, -ENOTCONN if the connection has no pipeline,
+ *	   negative errno on other failures
+ */
+int smp_upload_start(struct bt_conn *conn, bool baseline, smp_upload_cb_t done);
+
+#endif /* SMP_UPLOAD_H */
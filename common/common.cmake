@@ -0,0 +1,13 @@
+# Code shared between the node, gateway and olight applications.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+set(COMMON_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+target_include_directories(app PRIVATE ${COMMON_DIR}/include)
+target_sources_ifdef(CONFIG_EVTLOG app PRIVATE ${COMMON_DIR}/src/evtlog.c)
+target_sources_ifdef(CONFIG_LINK_TUNE app PRIVATE ${COMMON_DIR}/src/link_tune.c)
+target_sources_ifdef(CONFIG_REC_FMT app PRIVATE ${COMMON_DIR}/src/rec_fmt.c)
+target_sources_ifdef(CONFIG_Q15_FFT app PRIVATE ${COMMON_DIR}/src/q15_fft.c)
+target_sources_ifdef(CONFIG_LZC app PRIVATE ${COMMON_DIR}/src/lzc.c)
+target_sources_ifdef(CONFIG_CRC32S app PRIVATE ${COMMON_DIR}/src/crc32s.c)
@@ -0,0 +1,41 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef CRC32S_H
+#define CRC32S_H
+
+#include <stddef.h>
+
+#include <zephyr/types.h>
+
+/* Object names may carry the CRC of the object data as "-xxxxxxxx" right
+ * before the extension, e.g. "acc_00000042-1a2b3c4d.bin".
+ */
+#define CRC32S_NAME_TAG_FMT "-%08x"
+#define CRC32S_NAME_TAG_LEN 9
+
+/**
+ * @brief Continue a CRC-32 (IEEE 802.3) over the next chunk of data
+ *
+ * Same checksum as crc32_ieee() and the OTS OACP Calculate Checksum
+ * procedure. Start with 0 and feed the chunks in order; the result after
+ * the last one is the CRC of the whole stream.
+ *
+ * @param crc Result of the previous call, or 0 for the first chunk
+ * @param data Next chunk
+ * @param len Chunk length in bytes
+ * @return CRC of all data fed so far
+ */
+uint32_t crc32s_update(uint32_t crc, const void *data, size_t len);
+
+/**
+ * @brief Extract the CRC tag from an object name
+ *
+ * @param name NUL-terminated object name
+ * @param crc Set to the tagged CRC on success
+ * @return int 0 on success, -ENOENT if the name carries no tag
+ */
+int crc32s_name_get(const char *name, uint32_t *crc);
+
+#endif /* CRC32S_H */
@@ -0,0 +1,79 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef EVTLOG_H
+#define EVTLOG_H
+
+#include <zephyr/sys/printk.h>
+#include <zephyr/types.h>
+
+/* Number of 32-bit arguments stored with each record. */
+#define EVTLOG_ARGS_MAX 3
+
+/**
+ * @brief State of one EVTLOG() call site
+ *
+ * The format string is only read by the drain thread. It may use up to
+ * EVTLOG_ARGS_MAX 32-bit integer conversions (%u, %d, %x); strings and
+ * pointers into the caller's stack cannot be deferred.
+ */
+struct evtlog_site {
+	const char *fmt;
+	uint32_t window_start;
+	uint16_t window_count;
+};
+
+#define EVTLOG_SITE_INIT(_fmt)                                                                     \
+	{                                                                                          \
+		.fmt = (_fmt),                                                                     \
+	}
+
+#if defined(CONFIG_EVTLOG)
+
+/**
+ * @brief Store one record for the drain thread
+ *
+ * Costs a rate-limit check and a short critical section; never blocks.
+ *
+ * @param site Call site the record belongs to
+ * @param args EVTLOG_ARGS_MAX arguments for the site's format string
+ */
+void evtlog_put(struct evtlog_site *site, const uint32_t *args);
+
+/**
+ * @brief Number of records lost because the ring was full
+ */
+uint32_t evtlog_dropped(void);
+
+/**
+ * @brief Number of records discarded by per-site rate limiting
+ */
+uint32_t evtlog_suppressed(void);
+
+#define EVTLOG(_fmt, ...)                                                                          \
+	do {                                                                                       \
+		static struct evtlog_site _evtlog_site = EVTLOG_SITE_INIT(_fmt);                   \
+		const uint32_t _evtlog_args[EVTLOG_ARGS_MAX] = {__VA_ARGS__};                      \
+                                                                                                   \
+		evtlog_put(&_evtlog_site, _evtlog_args);                                           \
+	} while (0)
+
+#else
+
+/* Same argument handling as the deferred variant, printed synchronously. */
+static inline void evtlog_print(const char *fmt, const uint32_t *args)
+{
+	printk(fmt, args[0], args[1], args[2]);
+}
+
+#define EVTLOG(_fmt, ...)                                                                          \
+	do {                                                                                       \
+		const uint32_t _evtlog_args[EVTLOG_ARGS_MAX] = {__VA_ARGS__};                      \
+                                                                                                   \
+		evtlog_print(_fmt, _evtlog_args);                                                  \
+	} while (0)
+
+#endif /* CONFIG_EVTLOG */
+
+#endif /* EVTLOG_H */
@@ -0,0 +1,22 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef LINK_TUNE_H
+#define LINK_TUNE_H
+
+#include <zephyr/bluetooth/conn.h>
+
+/**
+ * @brief Request the fastest link parameters right after a connection
+ *
+ * Asks for the largest ATT MTU (GATT clients only, the server can not
+ * initiate the exchange), the maximum 251-byte LL data length and the LE 2M
+ * PHY. All requests are asynchronous; the results are logged as the
+ * controller reports them.
+ *
+ * @param conn Freshly established connection
+ */
+void link_tune_start(struct bt_conn *conn);
+
+#endif /* LINK_TUNE_H */
@@ -0,0 +1,105 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef LZC_H
+#define LZC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <zephyr/types.h>
+
+/* History the decoder keeps; matches never reach further back. */
+#define LZC_WINDOW_SIZE 1024
+#define LZC_MIN_MATCH   3
+#define LZC_MAX_MATCH   (LZC_MIN_MATCH + 63)
+#define LZC_HASH_BITS   9
+
+/* Magic, version and the little-endian 32-bit uncompressed length. */
+#define LZC_HDR_SIZE 6
+#define LZC_MAGIC    0x4c
+#define LZC_VERSION  1
+
+/* OTS object type of LZC compressed objects; other types are sent as is. */
+#define LZC_OBJ_TYPE_UUID_VAL BT_UUID_128_ENCODE(0x6c7a6301, 0x5d3c, 0x4f1e, 0x9b2a, 0x4e4f44454c5a)
+
+/**
+ * @brief Encoder working memory, one hash table of recent positions
+ */
+struct lzc_enc {
+	uint16_t head[1 << LZC_HASH_BITS];
+};
+
+/**
+ * @brief Streaming decoder state
+ *
+ * Holds the last LZC_WINDOW_SIZE output bytes, so input can arrive in
+ * chunks of any size.
+ */
+struct lzc_dec {
+	uint8_t window[LZC_WINDOW_SIZE];
+	uint8_t hdr[LZC_HDR_SIZE];
+	uint8_t hdr_len;
+	uint8_t flags;
+	/* Items left in the current flag byte. */
+	uint8_t flag_items;
+	uint8_t match_lo;
+	bool have_lo;
+	uint32_t raw_len;
+	/* Bytes produced and bytes handed to the output callback so far. */
+	uint32_t pos;
+	uint32_t flushed;
+};
+
+/**
+ * @brief Consumer of decompressed data
+ *
+ * @param user_data Passed through from lzc_dec_feed()
+ * @param data Decompressed bytes, valid for the duration of the call
+ * @param len Number of bytes
+ * @param offset Offset of @p data in the decompressed stream
+ * @return 0 to continue, negative errno to abort decoding
+ */
+typedef int (*lzc_out_t)(void *user_data, const uint8_t *data, size_t len, uint32_t offset);
+
+/**
+ * @brief Compress a buffer
+ *
+ * LZSS with a LZC_WINDOW_SIZE window: every flag byte tells whether each
+ * of the next eight items is a literal byte or a two-byte match of a
+ * 10-bit distance and a 6-bit length.
+ *
+ * @param enc Working memory
+ * @param in Data to compress, less than 64 KiB
+ * @param len Length of @p in
+ * @param out Output buffer
+ * @param size Size of @p out; compression stops as soon as it is full
+ * @return Compressed length, -ENOSPC if it does not fit in @p size,
+ *         -EINVAL if @p in is too long
+ */
+int lzc_compress(struct lzc_enc *enc, const uint8_t *in, size_t len, uint8_t *out, size_t size);
+
+/**
+ * @brief Reset a decoder for a new stream
+ */
+void lzc_dec_init(struct lzc_dec *dec);
+
+/**
+ * @brief Decode the next chunk of a compressed stream
+ *
+ * Decompressed data is handed to @p out in window-sized pieces at most,
+ * and everything decoded from the chunk is handed out before returning.
+ *
+ * @return 0 on success, -EBADMSG for a corrupt stream, -ENOTSUP for an
+ *         unknown version, or the error returned by @p out
+ */
+int lzc_dec_feed(struct lzc_dec *dec, const uint8_t *in, size_t len, lzc_out_t out,
+		 void *user_data);
+
+/**
+ * @brief Whether the whole stream has been decoded
+ */
+bool lzc_dec_done(const struct lzc_dec *dec);
+
+#endif /* LZC_H */
@@ -0,0 +1,39 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef OBJ_RESUME_H
+#define OBJ_RESUME_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/types.h>
+
+/* A record the gateway only got part of is exposed again from where the
+ * link dropped, as "<stem>+<offset>" in front of any CRC tag and the
+ * extension, e.g. "acc_00000042+1024-1a2b3c4d.lz". Offsets are decimal
+ * byte offsets into the record.
+ */
+#define OBJ_RESUME_NAME_FMT "+%u"
+
+/**
+ * @brief Split an object name into its stem and resume offset
+ *
+ * The stem names the record, so a whole object and its continuations
+ * share it.
+ *
+ * @param name NUL-terminated object name
+ * @param offset Set to the record offset the object starts at, 0 if whole
+ * @return Length of the stem
+ */
+static inline size_t obj_resume_name_parse(const char *name, uint32_t *offset)
+{
+	size_t stem = strcspn(name, "+-.");
+
+	*offset = (name[stem] == '+') ? (uint32_t)strtoul(&name[stem + 1], NULL, 10) : 0U;
+
+	return stem;
+}
+
+#endif /* OBJ_RESUME_H */
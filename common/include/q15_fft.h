@@ -0,0 +1,67 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef Q15_FFT_H
+#define Q15_FFT_H
+
+#include <stddef.h>
+
+#include <zephyr/sys/util.h>
+#include <zephyr/toolchain.h>
+#include <zephyr/types.h>
+
+#if defined(CONFIG_CMSIS_DSP_TRANSFORMS)
+#include <arm_math.h>
+#endif
+
+/**
+ * @brief Real Q15 FFT of a fixed power-of-two length
+ *
+ * Define with Q15_FFT_DEFINE(), then call q15_fft_init() once.
+ */
+struct q15_fft {
+	uint16_t len;
+#if defined(CONFIG_CMSIS_DSP_TRANSFORMS)
+	arm_rfft_instance_q15 rfft;
+#else
+	/* cos/sin pairs of e^(-2*pi*i*k/len) for k < len/2. */
+	int16_t *twiddle;
+#endif
+};
+
+#if defined(CONFIG_CMSIS_DSP_TRANSFORMS)
+#define Q15_FFT_DEFINE(_name, _len)                                                               \
+	BUILD_ASSERT(IS_POWER_OF_TWO(_len));                                                      \
+	static struct q15_fft _name = {.len = (_len)}
+#else
+#define Q15_FFT_DEFINE(_name, _len)                                                               \
+	BUILD_ASSERT(IS_POWER_OF_TWO(_len));                                                      \
+	static int16_t _name##_twiddle[(_len)];                                                   \
+	static struct q15_fft _name = {.len = (_len), .twiddle = _name##_twiddle}
+#endif
+
+/**
+ * @brief Prepare the twiddle table or the CMSIS-DSP instance
+ *
+ * @return int 0 on success, -EINVAL for a length CMSIS-DSP does not support
+ */
+int q15_fft_init(struct q15_fft *fft);
+
+/**
+ * @brief Transform len real samples into their spectrum
+ *
+ * Uses the CMSIS-DSP Q15 real FFT when CONFIG_CMSIS_DSP_TRANSFORMS is
+ * enabled and a portable radix-2 FFT otherwise. Both scale the result by
+ * 1/len, so a full-scale sine shows up as a bin magnitude of about 16384.
+ *
+ * @param fft Initialized transform
+ * @param samples len Q15 samples; overwritten, CMSIS-DSP uses them as scratch
+ * @param spectrum Output, len interleaved re/im bins, i.e. 2 * len values, of
+ *                 which the first len / 2 bins are meaningful. The portable
+ *                 FFT also accepts @p samples at the start of @p spectrum;
+ *                 with CMSIS-DSP the two must not overlap.
+ */
+void q15_fft_run(const struct q15_fft *fft, int16_t *samples, int16_t *spectrum);
+
+#endif /* Q15_FFT_H */
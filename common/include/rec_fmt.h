@@ -0,0 +1,113 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef REC_FMT_H
+#define REC_FMT_H
+
+#include <stddef.h>
+
+#include <zephyr/types.h>
+
+/* First byte of every record. */
+#define REC_FMT_MAGIC   0xa5
+#define REC_FMT_VERSION 1
+
+/* Fixed header in front of the payload, CRC included. */
+#define REC_FMT_HDR_SIZE 16
+
+/* Buffer size that always fits a REC_FMT_ENC_AUTO record of @p count samples. */
+#define REC_FMT_BUF_SIZE(count) (REC_FMT_HDR_SIZE + 2 * (count))
+
+/**
+ * @brief Time window a record was captured in
+ */
+enum rec_fmt_window {
+	REC_FMT_WIN_MTW,
+	REC_FMT_WIN_DTW,
+	REC_FMT_WIN_ATW,
+};
+
+/**
+ * @brief Sensor a record comes from
+ */
+enum rec_fmt_sensor {
+	REC_FMT_SENSOR_ACCEL,
+	REC_FMT_SENSOR_PDM,
+	REC_FMT_SENSOR_ADC,
+};
+
+/**
+ * @brief Payload encoding
+ */
+enum rec_fmt_enc {
+	/* Little-endian 16-bit samples. */
+	REC_FMT_ENC_RAW16,
+	/* Two 12-bit unsigned samples in three bytes. */
+	REC_FMT_ENC_PACK12,
+	/* First sample, then differences, each as ZigZag LEB128 varint. */
+	REC_FMT_ENC_DELTA,
+
+	REC_FMT_ENC_NUM,
+
+	/* Encoder only: the smallest encoding that fits the samples. */
+	REC_FMT_ENC_AUTO = 0xff,
+};
+
+/**
+ * @brief Header fields of a record
+ *
+ * On the wire the header is little-endian: magic, version, window, sensor,
+ * encoding, reserved, count (16), timestamp_ms (32), payload length (16)
+ * and a CRC-16/CCITT over header and payload (16).
+ */
+struct rec_fmt_info {
+	uint8_t window;
+	uint8_t sensor;
+	uint8_t enc;
+	uint16_t count;
+	uint32_t timestamp_ms;
+};
+
+/**
+ * @brief Encode one window of samples into a record
+ *
+ * PACK12 needs every sample in 0..4095; AUTO only picks it then.
+ *
+ * @param info Header fields; enc may be REC_FMT_ENC_AUTO, count is ignored
+ * @param samples Samples to encode
+ * @param count Number of samples, at most UINT16_MAX
+ * @param buf Output buffer
+ * @param size Size of @p buf
+ * @return Record length in bytes, -EINVAL for samples the encoding can not
+ *         hold, -ENOMEM if @p buf is too small
+ */
+int rec_fmt_encode(const struct rec_fmt_info *info, const int16_t *samples, size_t count,
+		   uint8_t *buf, size_t size);
+
+/**
+ * @brief Parse and check a record header
+ *
+ * @param buf Record
+ * @param len Bytes available in @p buf, at least the whole record
+ * @param info Filled with the header fields
+ * @return Record length in bytes, -EBADMSG for a corrupt or truncated record,
+ *         -ENOTSUP for an unknown version or encoding
+ */
+int rec_fmt_peek(const uint8_t *buf, size_t len, struct rec_fmt_info *info);
+
+/**
+ * @brief Decode a record back into samples
+ *
+ * @param buf Record
+ * @param len Bytes available in @p buf
+ * @param info Filled with the header fields
+ * @param samples Output samples
+ * @param max Capacity of @p samples
+ * @return Number of samples, -ENOMEM if they do not fit, or an error of
+ *         rec_fmt_peek()
+ */
+int rec_fmt_decode(const uint8_t *buf, size_t len, struct rec_fmt_info *info, int16_t *samples,
+		   size_t max);
+
+#endif /* REC_FMT_H */
@@ -0,0 +1,129 @@
+/** @file
+ *  @brief Deferred, rate-limited event log for the Bluetooth data path
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "evtlog.h"
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CONFIG_EVTLOG_RING_SIZE),
+	     "CONFIG_EVTLOG_RING_SIZE must be a power of two");
+
+#define RING_MASK (CONFIG_EVTLOG_RING_SIZE - 1)
+
+struct evtlog_rec {
+	const struct evtlog_site *site;
+	uint32_t timestamp_ms;
+	uint32_t args[EVTLOG_ARGS_MAX];
+};
+
+static struct evtlog_rec ring[CONFIG_EVTLOG_RING_SIZE];
+static uint32_t head;
+static uint32_t tail;
+static uint32_t dropped;
+static uint32_t suppressed;
+static struct k_spinlock lock;
+static K_SEM_DEFINE(drain_sem, 0, 1);
+
+void evtlog_put(struct evtlog_site *site, const uint32_t *args)
+{
+	uint32_t now = k_uptime_get_32();
+	struct evtlog_rec *rec;
+	k_spinlock_key_t key;
+	bool was_empty;
+
+	key = k_spin_lock(&lock);
+
+	if ((now - site->window_start) >= CONFIG_EVTLOG_RATE_WINDOW_MS) {
+		site->window_start = now;
+		site->window_count = 0;
+	}
+
+	if (site->window_count >= CONFIG_EVTLOG_RATE_BURST) {
+		suppressed++;
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	if ((head - tail) >= CONFIG_EVTLOG_RING_SIZE) {
+		dropped++;
+		k_spin_unlock(&lock, key);
+		return;
+	}
+
+	site->window_count++;
+	was_empty = (head == tail);
+
+	rec = &ring[head & RING_MASK];
+	rec->site = site;
+	rec->timestamp_ms = now;
+	rec->args[0] = args[0];
+	rec->args[1] = args[1];
+	rec->args[2] = args[2];
+	head++;
+
+	k_spin_unlock(&lock, key);
+
+	/* Only the first record of a burst wakes the drain thread. */
+	if (was_empty) {
+		k_sem_give(&drain_sem);
+	}
+}
+
+uint32_t evtlog_dropped(void)
+{
+	return dropped;
+}
+
+uint32_t evtlog_suppressed(void)
+{
+	return suppressed;
+}
+
+static bool evtlog_pop(struct evtlog_rec *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	bool found = (head != tail);
+
+	if (found) {
+		(void)memcpy(out, &ring[tail & RING_MASK], sizeof(*out));
+		tail++;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	return found;
+}
+
+static void evtlog_drain(void *p1, void *p2, void *p3)
+{
+	uint32_t reported_dropped = 0;
+	uint32_t reported_suppressed = 0;
+	struct evtlog_rec rec;
+
+	while (1) {
+		k_sem_take(&drain_sem, K_FOREVER);
+
+		while (evtlog_pop(&rec)) {
+			printk("[%08u] ", rec.timestamp_ms);
+			printk(rec.site->fmt, rec.args[0], rec.args[1], rec.args[2]);
+		}
+
+		if (dropped != reported_dropped || suppressed != reported_suppressed) {
+			reported_dropped = dropped;
+			reported_suppressed = suppressed;
+			printk("--- evtlog: %u dropped, %u rate limited ---\n", reported_dropped,
+			       reported_suppressed);
+		}
+	}
+}
+
+K_THREAD_DEFINE(evtlog_thread, CONFIG_EVTLOG_THREAD_STACK_SIZE, evtlog_drain, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
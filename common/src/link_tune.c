@@ -0,0 +1,77 @@
+/** @file
+ *  @brief Link tuning stage run right after a connection is established
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/sys/printk.h>
+
+#include "evtlog.h"
+#include "link_tune.h"
+
+#if defined(CONFIG_BT_GATT_CLIENT)
+static struct bt_gatt_exchange_params exchange_params[CONFIG_BT_MAX_CONN];
+
+static void exchange_func(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_exchange_params *params)
+{
+	EVTLOG("[%u] MTU exchange err %u, ATT MTU %u\n", bt_conn_index(conn), err,
+	       bt_gatt_get_mtu(conn));
+}
+#endif /* CONFIG_BT_GATT_CLIENT */
+
+void link_tune_start(struct bt_conn *conn)
+{
+	const struct bt_conn_le_data_len_param data_len = {
+		.tx_max_len = CONFIG_LINK_TUNE_DATA_LEN,
+		.tx_max_time = BT_GAP_DATA_TIME_MAX,
+	};
+	int err;
+
+#if defined(CONFIG_BT_GATT_CLIENT)
+	struct bt_gatt_exchange_params *params = &exchange_params[bt_conn_index(conn)];
+
+	params->func = exchange_func;
+	err = bt_gatt_exchange_mtu(conn, params);
+	if (err != 0 && err != -EALREADY) {
+		printk("MTU exchange failed (err %d)\n", err);
+	}
+#endif
+
+	err = bt_conn_le_data_len_update(conn, &data_len);
+	if (err != 0) {
+		printk("Data length update failed (err %d)\n", err);
+	}
+
+	if (!IS_ENABLED(CONFIG_LINK_TUNE_PHY_2M)) {
+		return;
+	}
+
+	err = bt_conn_le_phy_update(conn, BT_CONN_LE_PHY_PARAM_2M);
+	if (err != 0) {
+		printk("PHY update failed (err %d)\n", err);
+	}
+}
+
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	EVTLOG("[%u] Data length TX %u/%u us\n", bt_conn_index(conn), info->tx_max_len,
+	       info->tx_max_time);
+	EVTLOG("[%u] Data length RX %u/%u us\n", bt_conn_index(conn), info->rx_max_len,
+	       info->rx_max_time);
+}
+
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *info)
+{
+	EVTLOG("[%u] PHY TX %u RX %u\n", bt_conn_index(conn), info->tx_phy, info->rx_phy);
+}
+
+BT_CONN_CB_DEFINE(link_tune_conn_callbacks) = {
+	.le_data_len_updated = le_data_len_updated,
+	.le_phy_updated = le_phy_updated,
+};
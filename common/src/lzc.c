@@ -0,0 +1,224 @@
+/** @file
+ *  @brief Small-footprint LZSS codec for OTS objects
+ *
+ * The node compresses each record once, into a bounded buffer, with a
+ * 1 KiB hash table of working memory. The gateway decodes object data as
+ * it arrives, keeping only the 1 KiB window per connection.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include "lzc.h"
+
+static uint32_t hash3(const uint8_t *p)
+{
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+
+	return (v * 2654435761U) >> (32 - LZC_HASH_BITS);
+}
+
+int lzc_compress(struct lzc_enc *enc, const uint8_t *in, size_t len, uint8_t *out, size_t size)
+{
+	size_t ip = 0;
+	size_t op = LZC_HDR_SIZE;
+	size_t flag_pos = 0;
+	uint8_t flag_bit = 8;
+
+	/* Positions are kept as 16-bit values plus one, zero meaning none. */
+	if (len >= UINT16_MAX) {
+		return -EINVAL;
+	}
+
+	if (size < LZC_HDR_SIZE) {
+		return -ENOSPC;
+	}
+
+	(void)memset(enc->head, 0, sizeof(enc->head));
+
+	out[0] = LZC_MAGIC;
+	out[1] = LZC_VERSION;
+	sys_put_le32(len, &out[2]);
+
+	while (ip < len) {
+		size_t best = 0;
+		size_t dist = 0;
+
+		if (flag_bit == 8) {
+			if (op >= size) {
+				return -ENOSPC;
+			}
+
+			flag_pos = op++;
+			out[flag_pos] = 0;
+			flag_bit = 0;
+		}
+
+		if (ip + LZC_MIN_MATCH <= len) {
+			uint32_t h = hash3(&in[ip]);
+			size_t cand = enc->head[h];
+
+			enc->head[h] = ip + 1;
+
+			if (cand != 0 && ip - (cand - 1) <= LZC_WINDOW_SIZE) {
+				const uint8_t *ref = &in[cand - 1];
+				size_t max = MIN(LZC_MAX_MATCH, len - ip);
+
+				while (best < max && ref[best] == in[ip + best]) {
+					best++;
+				}
+
+				dist = ip - (cand - 1);
+			}
+		}
+
+		if (best >= LZC_MIN_MATCH) {
+			if (op + 2 > size) {
+				return -ENOSPC;
+			}
+
+			out[op++] = (dist - 1) & 0xff;
+			out[op++] = ((dist - 1) >> 8) | ((best - LZC_MIN_MATCH) << 2);
+			out[flag_pos] |= BIT(flag_bit);
+
+			/* Keep the table current for positions inside the match. */
+			for (size_t i = 1; i < best && ip + i + LZC_MIN_MATCH <= len; i++) {
+				enc->head[hash3(&in[ip + i])] = ip + i + 1;
+			}
+
+			ip += best;
+		} else {
+			if (op >= size) {
+				return -ENOSPC;
+			}
+
+			out[op++] = in[ip++];
+		}
+
+		flag_bit++;
+	}
+
+	return op;
+}
+
+void lzc_dec_init(struct lzc_dec *dec)
+{
+	dec->hdr_len = 0;
+	dec->flag_items = 0;
+	dec->have_lo = false;
+	dec->raw_len = 0;
+	dec->pos = 0;
+	dec->flushed = 0;
+}
+
+static int dec_flush(struct lzc_dec *dec, lzc_out_t out, void *user_data)
+{
+	uint32_t len = dec->pos - dec->flushed;
+	uint32_t start = dec->flushed % LZC_WINDOW_SIZE;
+	int err;
+
+	if (len == 0) {
+		return 0;
+	}
+
+	err = out(user_data, &dec->window[start], len, dec->flushed);
+	dec->flushed = dec->pos;
+
+	return err;
+}
+
+/* Output is flushed every time the window wraps, so unflushed data is
+ * always one contiguous run of the window.
+ */
+static int dec_put(struct lzc_dec *dec, uint8_t b, lzc_out_t out, void *user_data)
+{
+	dec->window[dec->pos % LZC_WINDOW_SIZE] = b;
+	dec->pos++;
+
+	if ((dec->pos % LZC_WINDOW_SIZE) == 0) {
+		return dec_flush(dec, out, user_data);
+	}
+
+	return 0;
+}
+
+int lzc_dec_feed(struct lzc_dec *dec, const uint8_t *in, size_t len, lzc_out_t out,
+		 void *user_data)
+{
+	int err = 0;
+
+	for (size_t i = 0; i < len && err == 0; i++) {
+		uint8_t b = in[i];
+
+		if (dec->hdr_len < LZC_HDR_SIZE) {
+			dec->hdr[dec->hdr_len++] = b;
+
+			if (dec->hdr_len == LZC_HDR_SIZE) {
+				if (dec->hdr[0] != LZC_MAGIC) {
+					return -EBADMSG;
+				}
+
+				if (dec->hdr[1] != LZC_VERSION) {
+					return -ENOTSUP;
+				}
+
+				dec->raw_len = sys_get_le32(&dec->hdr[2]);
+			}
+
+			continue;
+		}
+
+		if (dec->pos >= dec->raw_len) {
+			/* Trailing data after the end of the stream. */
+			return -EBADMSG;
+		}
+
+		if (dec->flag_items == 0) {
+			dec->flags = b;
+			dec->flag_items = 8;
+			continue;
+		}
+
+		if ((dec->flags & BIT(0)) == 0) {
+			err = dec_put(dec, b, out, user_data);
+		} else if (!dec->have_lo) {
+			dec->match_lo = b;
+			dec->have_lo = true;
+			continue;
+		} else {
+			uint32_t dist = (dec->match_lo | ((b & 0x03) << 8)) + 1;
+			uint32_t n = (b >> 2) + LZC_MIN_MATCH;
+
+			dec->have_lo = false;
+
+			if (dist > dec->pos || n > dec->raw_len - dec->pos) {
+				return -EBADMSG;
+			}
+
+			while (n-- > 0 && err == 0) {
+				err = dec_put(dec,
+					      dec->window[(dec->pos - dist) % LZC_WINDOW_SIZE],
+					      out, user_data);
+			}
+		}
+
+		dec->flags >>= 1;
+		dec->flag_items--;
+	}
+
+	if (err != 0) {
+		return err;
+	}
+
+	return dec_flush(dec, out, user_data);
+}
+
+bool lzc_dec_done(const struct lzc_dec *dec)
+{
+	return dec->hdr_len == LZC_HDR_SIZE && dec->pos == dec->raw_len;
+}
@@ -0,0 +1,110 @@
+/** @file
+ *  @brief Real Q15 FFT shared by the node's anomaly check and olight's audio features
+ *
+ * The portable path is an in-place radix-2 decimation-in-time FFT over
+ * complex Q15 values that halves every stage, so it needs no headroom in
+ * the input and ends up at X / N, the same scaling as arm_rfft_q15().
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <math.h>
+
+#include <zephyr/sys/util.h>
+
+#include "q15_fft.h"
+
+#if defined(CONFIG_CMSIS_DSP_TRANSFORMS)
+
+int q15_fft_init(struct q15_fft *fft)
+{
+	if (arm_rfft_init_q15(&fft->rfft, fft->len, 0, 1) != ARM_MATH_SUCCESS) {
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+void q15_fft_run(const struct q15_fft *fft, int16_t *samples, int16_t *spectrum)
+{
+	/* Output is in (log2(N) + 1).(15 - log2(N)) format, i.e. X / N. */
+	arm_rfft_q15(&fft->rfft, samples, spectrum);
+}
+
+#else
+
+int q15_fft_init(struct q15_fft *fft)
+{
+	for (size_t k = 0; k < fft->len / 2; k++) {
+		double phase = (2.0 * M_PI * k) / fft->len;
+
+		fft->twiddle[2 * k] = (int16_t)CLAMP(lround(cos(phase) * 32767.0), -32768, 32767);
+		fft->twiddle[2 * k + 1] =
+			(int16_t)CLAMP(lround(-sin(phase) * 32767.0), -32768, 32767);
+	}
+
+	return 0;
+}
+
+static void bit_reverse(int16_t *x, size_t len)
+{
+	for (size_t i = 1, j = 0; i < len; i++) {
+		size_t bit = len >> 1;
+
+		for (; (j & bit) != 0; bit >>= 1) {
+			j ^= bit;
+		}
+
+		j ^= bit;
+
+		if (i < j) {
+			int16_t re = x[2 * i];
+			int16_t im = x[2 * i + 1];
+
+			x[2 * i] = x[2 * j];
+			x[2 * i + 1] = x[2 * j + 1];
+			x[2 * j] = re;
+			x[2 * j + 1] = im;
+		}
+	}
+}
+
+void q15_fft_run(const struct q15_fft *fft, int16_t *samples, int16_t *spectrum)
+{
+	const size_t len = fft->len;
+	int16_t *x = spectrum;
+
+	/* Real input to complex, walking backwards so samples may alias x. */
+	for (size_t i = len; i-- > 0;) {
+		x[2 * i] = samples[i];
+		x[2 * i + 1] = 0;
+	}
+
+	bit_reverse(x, len);
+
+	/* Radix-2 DIT, halving every stage so the result is X / N. */
+	for (size_t half = 1; half < len; half <<= 1) {
+		size_t step = len / (2 * half);
+
+		for (size_t k = 0; k < len; k += 2 * half) {
+			for (size_t j = 0; j < half; j++) {
+				int32_t wr = fft->twiddle[2 * j * step];
+				int32_t wi = fft->twiddle[2 * j * step + 1];
+				int16_t *a = &x[2 * (k + j)];
+				int16_t *b = &x[2 * (k + j + half)];
+				int32_t tr = (b[0] * wr - b[1] * wi) >> 15;
+				int32_t ti = (b[0] * wi + b[1] * wr) >> 15;
+				int32_t ar = a[0];
+				int32_t ai = a[1];
+
+				a[0] = (int16_t)((ar + tr) >> 1);
+				a[1] = (int16_t)((ai + ti) >> 1);
+				b[0] = (int16_t)((ar - tr) >> 1);
+				b[1] = (int16_t)((ai - ti) >> 1);
+			}
+		}
+	}
+}
+
+#endif /* CONFIG_CMSIS_DSP_TRANSFORMS */
@@ -0,0 +1,313 @@
+/** @file
+ *  @brief Compact binary record format for sensor windows
+ *
+ * Shared by the node, which encodes every capture before storing it, and
+ * the gateway, which decodes what it reads. Only plain C and the Zephyr
+ * byte order and CRC helpers are used, so the codec also builds for the
+ * host.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+
+#include "rec_fmt.h"
+
+#define OFF_MAGIC       0
+#define OFF_VERSION     1
+#define OFF_WINDOW      2
+#define OFF_SENSOR      3
+#define OFF_ENC         4
+#define OFF_COUNT       6
+#define OFF_TIMESTAMP   8
+#define OFF_PAYLOAD_LEN 12
+#define OFF_CRC         14
+
+#define PACK12_MAX 0x0fff
+
+/* A ZigZag delta of two 16-bit samples needs at most 17 bits. */
+#define VARINT_MAX_LEN 3
+
+static uint32_t zigzag(int32_t v)
+{
+	return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t unzigzag(uint32_t v)
+{
+	return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static size_t varint_len(uint32_t v)
+{
+	size_t len = 1;
+
+	while (v >= 0x80) {
+		v >>= 7;
+		len++;
+	}
+
+	return len;
+}
+
+static size_t pack12_len(size_t count)
+{
+	return (count * 3 + 1) / 2;
+}
+
+static bool fits_pack12(const int16_t *samples, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		if (samples[i] < 0 || samples[i] > PACK12_MAX) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static size_t delta_len(const int16_t *samples, size_t count)
+{
+	int32_t prev = 0;
+	size_t len = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		len += varint_len(zigzag(samples[i] - prev));
+		prev = samples[i];
+	}
+
+	return len;
+}
+
+static size_t payload_len(enum rec_fmt_enc enc, const int16_t *samples, size_t count)
+{
+	switch (enc) {
+	case REC_FMT_ENC_PACK12:
+		return pack12_len(count);
+	case REC_FMT_ENC_DELTA:
+		return delta_len(samples, count);
+	default:
+		return 2 * count;
+	}
+}
+
+static enum rec_fmt_enc pick_enc(const int16_t *samples, size_t count)
+{
+	enum rec_fmt_enc best = REC_FMT_ENC_RAW16;
+	size_t best_len = 2 * count;
+
+	if (fits_pack12(samples, count) && pack12_len(count) < best_len) {
+		best = REC_FMT_ENC_PACK12;
+		best_len = pack12_len(count);
+	}
+
+	if (delta_len(samples, count) < best_len) {
+		best = REC_FMT_ENC_DELTA;
+	}
+
+	return best;
+}
+
+static void encode_payload(enum rec_fmt_enc enc, const int16_t *samples, size_t count,
+			   uint8_t *out)
+{
+	int32_t prev = 0;
+
+	switch (enc) {
+	case REC_FMT_ENC_PACK12:
+		for (size_t i = 0; i < count; i += 2) {
+			uint16_t a = samples[i];
+			uint16_t b = (i + 1 < count) ? samples[i + 1] : 0;
+
+			*out++ = a & 0xff;
+			*out++ = (a >> 8) | ((b & 0x0f) << 4);
+			if (i + 1 < count) {
+				*out++ = b >> 4;
+			}
+		}
+		break;
+	case REC_FMT_ENC_DELTA:
+		for (size_t i = 0; i < count; i++) {
+			uint32_t v = zigzag(samples[i] - prev);
+
+			while (v >= 0x80) {
+				*out++ = (v & 0x7f) | 0x80;
+				v >>= 7;
+			}
+
+			*out++ = v;
+			prev = samples[i];
+		}
+		break;
+	default:
+		for (size_t i = 0; i < count; i++) {
+			sys_put_le16(samples[i], out);
+			out += 2;
+		}
+		break;
+	}
+}
+
+int rec_fmt_encode(const struct rec_fmt_info *info, const int16_t *samples, size_t count,
+		   uint8_t *buf, size_t size)
+{
+	enum rec_fmt_enc enc = info->enc;
+	size_t len;
+	uint16_t crc;
+
+	if (count > UINT16_MAX || (enc >= REC_FMT_ENC_NUM && enc != REC_FMT_ENC_AUTO)) {
+		return -EINVAL;
+	}
+
+	if (enc == REC_FMT_ENC_AUTO) {
+		enc = pick_enc(samples, count);
+	} else if (enc == REC_FMT_ENC_PACK12 && !fits_pack12(samples, count)) {
+		return -EINVAL;
+	}
+
+	len = payload_len(enc, samples, count);
+	if (len > UINT16_MAX) {
+		return -EINVAL;
+	}
+
+	if (REC_FMT_HDR_SIZE + len > size) {
+		return -ENOMEM;
+	}
+
+	buf[OFF_MAGIC] = REC_FMT_MAGIC;
+	buf[OFF_VERSION] = REC_FMT_VERSION;
+	buf[OFF_WINDOW] = info->window;
+	buf[OFF_SENSOR] = info->sensor;
+	buf[OFF_ENC] = enc;
+	buf[OFF_ENC + 1] = 0;
+	sys_put_le16(count, &buf[OFF_COUNT]);
+	sys_put_le32(info->timestamp_ms, &buf[OFF_TIMESTAMP]);
+	sys_put_le16(len, &buf[OFF_PAYLOAD_LEN]);
+
+	encode_payload(enc, samples, count, &buf[REC_FMT_HDR_SIZE]);
+
+	crc = crc16_ccitt(0xffff, buf, OFF_CRC);
+	crc = crc16_ccitt(crc, &buf[REC_FMT_HDR_SIZE], len);
+	sys_put_le16(crc, &buf[OFF_CRC]);
+
+	return REC_FMT_HDR_SIZE + len;
+}
+
+int rec_fmt_peek(const uint8_t *buf, size_t len, struct rec_fmt_info *info)
+{
+	size_t plen;
+	uint16_t crc;
+
+	if (len < REC_FMT_HDR_SIZE || buf[OFF_MAGIC] != REC_FMT_MAGIC) {
+		return -EBADMSG;
+	}
+
+	if (buf[OFF_VERSION] != REC_FMT_VERSION || buf[OFF_ENC] >= REC_FMT_ENC_NUM) {
+		return -ENOTSUP;
+	}
+
+	plen = sys_get_le16(&buf[OFF_PAYLOAD_LEN]);
+	if (REC_FMT_HDR_SIZE + plen > len) {
+		return -EBADMSG;
+	}
+
+	crc = crc16_ccitt(0xffff, buf, OFF_CRC);
+	crc = crc16_ccitt(crc, &buf[REC_FMT_HDR_SIZE], plen);
+	if (crc != sys_get_le16(&buf[OFF_CRC])) {
+		return -EBADMSG;
+	}
+
+	info->window = buf[OFF_WINDOW];
+	info->sensor = buf[OFF_SENSOR];
+	info->enc = buf[OFF_ENC];
+	info->count = sys_get_le16(&buf[OFF_COUNT]);
+	info->timestamp_ms = sys_get_le32(&buf[OFF_TIMESTAMP]);
+
+	return REC_FMT_HDR_SIZE + plen;
+}
+
+static int decode_delta(const uint8_t *in, size_t len, int16_t *samples, size_t count)
+{
+	const uint8_t *end = in + len;
+	int32_t prev = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		uint32_t v = 0;
+		size_t shift = 0;
+
+		do {
+			if (in == end || shift >= 7 * VARINT_MAX_LEN) {
+				return -EBADMSG;
+			}
+
+			v |= (uint32_t)(*in & 0x7f) << shift;
+			shift += 7;
+		} while ((*in++ & 0x80) != 0);
+
+		prev += unzigzag(v);
+		if (prev < INT16_MIN || prev > INT16_MAX) {
+			return -EBADMSG;
+		}
+
+		samples[i] = prev;
+	}
+
+	return (in == end) ? 0 : -EBADMSG;
+}
+
+int rec_fmt_decode(const uint8_t *buf, size_t len, struct rec_fmt_info *info, int16_t *samples,
+		   size_t max)
+{
+	const uint8_t *in = &buf[REC_FMT_HDR_SIZE];
+	size_t plen;
+	int ret;
+
+	ret = rec_fmt_peek(buf, len, info);
+	if (ret < 0) {
+		return ret;
+	}
+
+	if (info->count > max) {
+		return -ENOMEM;
+	}
+
+	plen = ret - REC_FMT_HDR_SIZE;
+
+	switch (info->enc) {
+	case REC_FMT_ENC_PACK12:
+		if (plen != pack12_len(info->count)) {
+			return -EBADMSG;
+		}
+
+		for (size_t i = 0; i < info->count; i += 2) {
+			samples[i] = in[0] | ((in[1] & 0x0f) << 8);
+			if (i + 1 < info->count) {
+				samples[i + 1] = (in[1] >> 4) | (in[2] << 4);
+			}
+
+			in += 3;
+		}
+		break;
+	case REC_FMT_ENC_DELTA:
+		ret = decode_delta(in, plen, samples, info->count);
+		if (ret < 0) {
+			return ret;
+		}
+		break;
+	default:
+		if (plen != 2 * info->count) {
+			return -EBADMSG;
+		}
+
+		for (size_t i = 0; i < info->count; i++) {
+			samples[i] = sys_get_le16(&in[2 * i]);
+		}
+		break;
+	}
+
+	return info->count;
+}
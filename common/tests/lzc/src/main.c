@@ -0,0 +1,235 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/ztest.h>
+
+#include "lzc.h"
+
+/* Crosses the decoder window twice, with a partial window at the end. */
+#define LEN 2500
+/* Incompressible data grows by one flag byte per eight literals. */
+#define BOUND(len) (LZC_HDR_SIZE + (len) + ((len) + 7) / 8)
+
+static struct lzc_enc enc;
+static struct lzc_dec dec;
+static uint8_t raw[LEN];
+static uint8_t packed[BOUND(LEN)];
+
+/* Everything the decoder hands out, checked for order and piece size. */
+static uint8_t decoded[LEN];
+static size_t decoded_len;
+static int out_err;
+
+/* Deterministic noise, so failures reproduce. */
+static uint32_t lcg(uint32_t *state)
+{
+	*state = *state * 1664525U + 1013904223U;
+
+	return *state >> 16;
+}
+
+static void fill_random(void)
+{
+	uint32_t state = 1;
+
+	for (size_t i = 0; i < LEN; i++) {
+		raw[i] = lcg(&state);
+	}
+}
+
+/* Slowly varying samples with a repeating header, like a sensor record. */
+static void fill_compressible(void)
+{
+	for (size_t i = 0; i < LEN; i++) {
+		raw[i] = ((i % 64) < 8) ? "REC0WIN1"[i % 8] : (uint8_t)((i / 64) + (i % 4));
+	}
+}
+
+static int collect(void *user_data, const uint8_t *data, size_t len, uint32_t offset)
+{
+	ARG_UNUSED(user_data);
+
+	zassert_equal(offset, decoded_len, "out of order at %u", offset);
+	zassert_true(len <= LZC_WINDOW_SIZE, "piece of %zu bytes", len);
+	zassert_true(decoded_len + len <= sizeof(decoded), "%zu bytes too many", len);
+
+	(void)memcpy(&decoded[decoded_len], data, len);
+	decoded_len += len;
+
+	return out_err;
+}
+
+static void dec_reset(void)
+{
+	lzc_dec_init(&dec);
+	(void)memset(decoded, 0, sizeof(decoded));
+	decoded_len = 0;
+	out_err = 0;
+}
+
+static int compress(void)
+{
+	int len = lzc_compress(&enc, raw, LEN, packed, sizeof(packed));
+
+	zassert_true(len >= LZC_HDR_SIZE, "compress: %d", len);
+
+	return len;
+}
+
+/* Feed the stream in two pieces split at split, then check the output. */
+static void decode_split(size_t len, size_t split)
+{
+	dec_reset();
+
+	zassert_ok(lzc_dec_feed(&dec, packed, split, collect, NULL), "split %zu", split);
+	zassert_equal(lzc_dec_done(&dec), split == len, "split %zu", split);
+	zassert_ok(lzc_dec_feed(&dec, &packed[split], len - split, collect, NULL), "split %zu",
+		   split);
+
+	zassert_true(lzc_dec_done(&dec), "split %zu", split);
+	zassert_equal(decoded_len, LEN, "split %zu: %zu bytes", split, decoded_len);
+	zassert_mem_equal(decoded, raw, LEN, "split %zu", split);
+}
+
+ZTEST(lzc, test_round_trip_compressible)
+{
+	int len;
+
+	fill_compressible();
+	len = compress();
+
+	zassert_true(len < LEN / 2, "%d bytes", len);
+	decode_split(len, 0);
+}
+
+ZTEST(lzc, test_round_trip_random)
+{
+	int len;
+
+	fill_random();
+	len = compress();
+
+	zassert_true(len <= BOUND(LEN), "%d bytes", len);
+	decode_split(len, 0);
+}
+
+ZTEST(lzc, test_empty)
+{
+	int len = lzc_compress(&enc, raw, 0, packed, sizeof(packed));
+
+	zassert_equal(len, LZC_HDR_SIZE);
+
+	dec_reset();
+	zassert_ok(lzc_dec_feed(&dec, packed, len, collect, NULL));
+	zassert_true(lzc_dec_done(&dec));
+	zassert_equal(decoded_len, 0);
+}
+
+ZTEST(lzc, test_chunked)
+{
+	int len;
+
+	fill_compressible();
+	len = compress();
+
+	for (size_t split = 0; split <= len; split++) {
+		decode_split(len, split);
+	}
+
+	/* One byte per call, the worst an L2CAP segment can do. */
+	dec_reset();
+
+	for (size_t i = 0; i < len; i++) {
+		zassert_ok(lzc_dec_feed(&dec, &packed[i], 1, collect, NULL), "byte %zu", i);
+	}
+
+	zassert_true(lzc_dec_done(&dec));
+	zassert_mem_equal(decoded, raw, LEN);
+}
+
+ZTEST(lzc, test_truncated)
+{
+	int len;
+
+	fill_compressible();
+	len = compress();
+
+	/* A cut stream is not an error, it is just never done. */
+	for (size_t cut = 0; cut < len; cut++) {
+		dec_reset();
+		zassert_ok(lzc_dec_feed(&dec, packed, cut, collect, NULL), "%zu of %d", cut, len);
+		zassert_false(lzc_dec_done(&dec), "%zu of %d", cut, len);
+		zassert_mem_equal(decoded, raw, decoded_len, "%zu of %d", cut, len);
+	}
+}
+
+ZTEST(lzc, test_corrupt)
+{
+	/* 'a', then a match two bytes back, one before the start of the output. */
+	uint8_t bad_dist[] = {LZC_MAGIC, LZC_VERSION, 10, 0, 0, 0, 0x02, 'a', 0x01, 0x00};
+	uint8_t bad_len[] = {LZC_MAGIC, LZC_VERSION, 4, 0, 0, 0, 0x02, 'a', 0x00, 0x00};
+	int len;
+
+	fill_compressible();
+	len = compress();
+
+	packed[0] = (uint8_t)~LZC_MAGIC;
+	dec_reset();
+	zassert_equal(lzc_dec_feed(&dec, packed, len, collect, NULL), -EBADMSG);
+	packed[0] = LZC_MAGIC;
+
+	packed[1] = LZC_VERSION + 1;
+	dec_reset();
+	zassert_equal(lzc_dec_feed(&dec, packed, len, collect, NULL), -ENOTSUP);
+	packed[1] = LZC_VERSION;
+
+	/* Trailing data after a complete stream. */
+	dec_reset();
+	zassert_ok(lzc_dec_feed(&dec, packed, len, collect, NULL));
+	zassert_equal(lzc_dec_feed(&dec, packed, 1, collect, NULL), -EBADMSG);
+
+	dec_reset();
+	zassert_equal(lzc_dec_feed(&dec, bad_dist, sizeof(bad_dist), collect, NULL), -EBADMSG);
+
+	/* 'a' and a 3-byte copy of it make four bytes, one more than announced. */
+	dec_reset();
+	zassert_equal(lzc_dec_feed(&dec, bad_len, sizeof(bad_len), collect, NULL), 0);
+	sys_put_le32(3, &bad_len[2]);
+	dec_reset();
+	zassert_equal(lzc_dec_feed(&dec, bad_len, sizeof(bad_len), collect, NULL), -EBADMSG);
+
+	/* The consumer's error stops decoding and comes back as is. */
+	dec_reset();
+	out_err = -ECANCELED;
+	zassert_equal(lzc_dec_feed(&dec, packed, len, collect, NULL), -ECANCELED);
+	zassert_false(lzc_dec_done(&dec));
+}
+
+ZTEST(lzc, test_compress_limits)
+{
+	int len;
+
+	fill_random();
+	len = compress();
+
+	zassert_equal(lzc_compress(&enc, raw, LEN, packed, len - 1), -ENOSPC);
+	zassert_equal(lzc_compress(&enc, raw, LEN, packed, LZC_HDR_SIZE - 1), -ENOSPC);
+
+	fill_compressible();
+	len = compress();
+
+	for (size_t size = LZC_HDR_SIZE; size < len; size++) {
+		zassert_equal(lzc_compress(&enc, raw, LEN, packed, size), -ENOSPC, "size %zu",
+			      size);
+	}
+
+	/* Rejected on its length alone, before any input is read. */
+	zassert_equal(lzc_compress(&enc, raw, UINT16_MAX, packed, sizeof(packed)), -EINVAL);
+}
+
+ZTEST_SUITE(lzc, NULL, NULL, NULL, NULL, NULL);
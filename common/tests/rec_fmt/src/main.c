@@ -0,0 +1,236 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include "rec_fmt.h"
+
+/* Odd on purpose: PACK12 ends in half a triplet. */
+#define COUNT 101
+
+static int16_t samples[COUNT];
+static int16_t decoded[COUNT];
+static uint8_t buf[REC_FMT_BUF_SIZE(COUNT) + REC_FMT_HDR_SIZE + 3 * COUNT];
+
+static const struct rec_fmt_info info_base = {
+	.window = REC_FMT_WIN_DTW,
+	.sensor = REC_FMT_SENSOR_ADC,
+	.timestamp_ms = 0x12345678,
+};
+
+/* Deterministic noise, so failures reproduce. */
+static uint32_t lcg(uint32_t *state)
+{
+	*state = *state * 1664525U + 1013904223U;
+
+	return *state >> 16;
+}
+
+static void fill_pack12_noise(size_t count)
+{
+	uint32_t state = 1;
+
+	for (size_t i = 0; i < count; i++) {
+		samples[i] = lcg(&state) & 0x0fff;
+	}
+}
+
+static void fill_ramp(size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		samples[i] = -1000 + 3 * (int16_t)i;
+	}
+}
+
+/* Full-scale swings: every delta needs a 3-byte varint. */
+static void fill_extremes(size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		samples[i] = (i % 2) ? INT16_MAX : INT16_MIN;
+	}
+}
+
+static int encode(uint8_t enc, size_t count)
+{
+	struct rec_fmt_info info = info_base;
+
+	info.enc = enc;
+
+	return rec_fmt_encode(&info, samples, count, buf, sizeof(buf));
+}
+
+/* Encode, decode and compare; returns the encoding that was used. */
+static uint8_t round_trip(uint8_t enc, size_t count)
+{
+	struct rec_fmt_info info;
+	int len;
+	int ret;
+
+	len = encode(enc, count);
+	zassert_true(len >= REC_FMT_HDR_SIZE, "encode enc %u count %zu: %d", enc, count, len);
+
+	(void)memset(decoded, 0x5a, sizeof(decoded));
+	ret = rec_fmt_decode(buf, len, &info, decoded, ARRAY_SIZE(decoded));
+	zassert_equal(ret, (int)count, "decode enc %u count %zu: %d", enc, count, ret);
+
+	zassert_equal(info.window, info_base.window);
+	zassert_equal(info.sensor, info_base.sensor);
+	zassert_equal(info.count, count);
+	zassert_equal(info.timestamp_ms, info_base.timestamp_ms);
+	zassert_mem_equal(decoded, samples, count * sizeof(samples[0]), "enc %u count %zu",
+			  info.enc, count);
+
+	return info.enc;
+}
+
+ZTEST(rec_fmt, test_raw16)
+{
+	fill_extremes(COUNT);
+	zassert_equal(round_trip(REC_FMT_ENC_RAW16, COUNT), REC_FMT_ENC_RAW16);
+	zassert_equal(encode(REC_FMT_ENC_RAW16, COUNT), REC_FMT_HDR_SIZE + 2 * COUNT);
+
+	fill_ramp(COUNT);
+	round_trip(REC_FMT_ENC_RAW16, COUNT - 1);
+}
+
+ZTEST(rec_fmt, test_pack12)
+{
+	fill_pack12_noise(COUNT);
+	samples[0] = 0;
+	samples[1] = 0x0fff;
+
+	for (size_t count = 1; count <= 4; count++) {
+		round_trip(REC_FMT_ENC_PACK12, count);
+	}
+
+	zassert_equal(round_trip(REC_FMT_ENC_PACK12, COUNT), REC_FMT_ENC_PACK12);
+	zassert_equal(encode(REC_FMT_ENC_PACK12, COUNT), REC_FMT_HDR_SIZE + (3 * COUNT + 1) / 2);
+	round_trip(REC_FMT_ENC_PACK12, COUNT - 1);
+
+	/* Out of the 12-bit range on either side. */
+	samples[COUNT - 1] = 0x1000;
+	zassert_equal(encode(REC_FMT_ENC_PACK12, COUNT), -EINVAL);
+	samples[COUNT - 1] = -1;
+	zassert_equal(encode(REC_FMT_ENC_PACK12, COUNT), -EINVAL);
+}
+
+ZTEST(rec_fmt, test_delta)
+{
+	fill_ramp(COUNT);
+	zassert_equal(round_trip(REC_FMT_ENC_DELTA, COUNT), REC_FMT_ENC_DELTA);
+
+	/* The largest steps a 16-bit sample can take. */
+	fill_extremes(COUNT);
+	round_trip(REC_FMT_ENC_DELTA, COUNT);
+	zassert_equal(encode(REC_FMT_ENC_DELTA, COUNT), REC_FMT_HDR_SIZE + 3 * COUNT);
+
+	fill_pack12_noise(COUNT);
+	round_trip(REC_FMT_ENC_DELTA, COUNT);
+}
+
+ZTEST(rec_fmt, test_auto)
+{
+	fill_pack12_noise(COUNT);
+	zassert_equal(round_trip(REC_FMT_ENC_AUTO, COUNT), REC_FMT_ENC_PACK12);
+
+	fill_ramp(COUNT);
+	zassert_equal(round_trip(REC_FMT_ENC_AUTO, COUNT), REC_FMT_ENC_DELTA);
+
+	fill_extremes(COUNT);
+	zassert_equal(round_trip(REC_FMT_ENC_AUTO, COUNT), REC_FMT_ENC_RAW16);
+
+	/* AUTO never needs more than REC_FMT_BUF_SIZE(). */
+	zassert_true(encode(REC_FMT_ENC_AUTO, COUNT) <= REC_FMT_BUF_SIZE(COUNT));
+}
+
+ZTEST(rec_fmt, test_empty)
+{
+	struct rec_fmt_info info;
+	int len;
+
+	len = encode(REC_FMT_ENC_AUTO, 0);
+	zassert_equal(len, REC_FMT_HDR_SIZE);
+	zassert_equal(rec_fmt_decode(buf, len, &info, decoded, 0), 0);
+	zassert_equal(info.count, 0);
+}
+
+ZTEST(rec_fmt, test_crc)
+{
+	struct rec_fmt_info info;
+	int len;
+
+	fill_ramp(COUNT);
+	len = encode(REC_FMT_ENC_DELTA, COUNT);
+	zassert_true(len > REC_FMT_HDR_SIZE);
+
+	/* A flipped bit anywhere but the magic byte is caught by the CRC. */
+	for (int i = 1; i < len; i++) {
+		buf[i] ^= 0x10;
+		zassert_true(rec_fmt_peek(buf, len, &info) < 0, "byte %d flipped", i);
+		buf[i] ^= 0x10;
+	}
+
+	buf[REC_FMT_HDR_SIZE + 7] ^= 0x01;
+	zassert_equal(rec_fmt_decode(buf, len, &info, decoded, COUNT), -EBADMSG);
+	buf[REC_FMT_HDR_SIZE + 7] ^= 0x01;
+
+	buf[0] = (uint8_t)~REC_FMT_MAGIC;
+	zassert_equal(rec_fmt_peek(buf, len, &info), -EBADMSG);
+	buf[0] = REC_FMT_MAGIC;
+
+	zassert_equal(rec_fmt_peek(buf, len, &info), len);
+}
+
+ZTEST(rec_fmt, test_truncated)
+{
+	struct rec_fmt_info info;
+	int len;
+
+	fill_pack12_noise(COUNT);
+	len = encode(REC_FMT_ENC_PACK12, COUNT);
+	zassert_true(len > REC_FMT_HDR_SIZE);
+
+	for (int cut = 0; cut < len; cut++) {
+		zassert_equal(rec_fmt_peek(buf, cut, &info), -EBADMSG, "%d of %d bytes", cut,
+			      len);
+		zassert_equal(rec_fmt_decode(buf, cut, &info, decoded, COUNT), -EBADMSG,
+			      "%d of %d bytes", cut, len);
+	}
+
+	/* Trailing bytes after the record are not part of it. */
+	zassert_equal(rec_fmt_decode(buf, sizeof(buf), &info, decoded, COUNT), COUNT);
+}
+
+ZTEST(rec_fmt, test_limits)
+{
+	struct rec_fmt_info info;
+	int len;
+
+	fill_ramp(COUNT);
+
+	/* Output buffer one byte short. */
+	len = encode(REC_FMT_ENC_RAW16, COUNT);
+	info = info_base;
+	info.enc = REC_FMT_ENC_RAW16;
+	zassert_equal(rec_fmt_encode(&info, samples, COUNT, buf, len - 1), -ENOMEM);
+
+	/* Unknown encoding on either side. */
+	info.enc = REC_FMT_ENC_NUM;
+	zassert_equal(rec_fmt_encode(&info, samples, COUNT, buf, sizeof(buf)), -EINVAL);
+
+	len = encode(REC_FMT_ENC_RAW16, COUNT);
+	zassert_equal(rec_fmt_decode(buf, len, &info, decoded, COUNT - 1), -ENOMEM);
+
+	buf[4] = REC_FMT_ENC_NUM;
+	zassert_equal(rec_fmt_peek(buf, len, &info), -ENOTSUP);
+	buf[4] = REC_FMT_ENC_RAW16;
+
+	buf[1] = REC_FMT_VERSION + 1;
+	zassert_equal(rec_fmt_peek(buf, len, &info), -ENOTSUP);
+}
+
+ZTEST_SUITE(rec_fmt, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,308 @@
+/** @file
+ *  @brief OTS throughput benchmark driven from the gateway
+ *
+ * Walks the object list of every connected node, reads each object a fixed
+ * number of times and prints one machine-readable CSV row per object. Reads
+ * that end incomplete count as failed iterations and are left out of the
+ * throughput and percentiles.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "bench.h"
+#include "obj_sink.h"
+#include "otc_mux.h"
+
+/* Hardcoded here since definition is in internal header */
+#define BT_GATT_OTS_OLCP_RES_SUCCESS      0x01
+#define BT_GATT_OTS_OLCP_RES_OUT_OF_BONDS 0x05
+
+#define ITERATIONS CONFIG_GATEWAY_BENCH_ITERATIONS
+/* Below this many samples the 99th percentile is just the maximum. */
+#define P99_MIN_SAMPLES 100
+/* Back-off while another node runs an OTS client procedure. */
+#define BENCH_RETRY_MS 5
+
+enum bench_step {
+	BENCH_SELECT_FIRST,
+	BENCH_SELECT_NEXT,
+	BENCH_READ_METADATA,
+	BENCH_READ_DATA,
+	BENCH_FINISH,
+};
+
+struct bench_node {
+	struct bt_ots_client *otc;
+	struct bt_conn *conn;
+	struct k_work_delayable work;
+	enum bench_step step;
+	uint32_t iteration;
+	uint32_t completed;
+	uint32_t obj_size;
+	int64_t req_us;
+	bool first_chunk;
+	uint32_t ttfb_us[ITERATIONS];
+	uint32_t lat_us[ITERATIONS];
+	k_thread_runtime_stats_t rt_start;
+};
+
+static struct bench_node nodes[CONFIG_BT_MAX_CONN];
+
+static int64_t now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static struct bench_node *node_get(struct bt_conn *conn)
+{
+	struct bench_node *node = &nodes[bt_conn_index(conn)];
+
+	return (node->conn == conn) ? node : NULL;
+}
+
+static uint32_t percentile(uint32_t *samples, size_t count, uint32_t pct)
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	/* Insertion sort; ITERATIONS is small. */
+	for (size_t i = 1; i < count; i++) {
+		uint32_t v = samples[i];
+		size_t j = i;
+
+		while (j > 0 && samples[j - 1] > v) {
+			samples[j] = samples[j - 1];
+			j--;
+		}
+
+		samples[j] = v;
+	}
+
+	return samples[((count - 1) * pct) / 100];
+}
+
+static void bench_report(struct bench_node *node)
+{
+	k_thread_runtime_stats_t rt;
+	struct bt_conn_info info;
+	uint16_t data_len = BT_GAP_DATA_LEN_DEFAULT;
+	uint8_t phy = BT_GAP_LE_PHY_1M;
+	uint64_t total_us = 0;
+	uint64_t exec_cycles;
+	uint32_t busy_pct = 0;
+	char lat_p99[11] = "";
+
+	for (size_t i = 0; i < node->completed; i++) {
+		total_us += node->lat_us[i];
+	}
+
+	(void)k_thread_runtime_stats_all_get(&rt);
+	exec_cycles = rt.execution_cycles - node->rt_start.execution_cycles;
+	if (exec_cycles > 0) {
+		busy_pct = (uint32_t)(((rt.total_cycles - node->rt_start.total_cycles) * 100U) /
+				      exec_cycles);
+	}
+
+	if (bt_conn_get_info(node->conn, &info) != 0) {
+		return;
+	}
+
+#if defined(CONFIG_BT_USER_DATA_LEN_UPDATE)
+	data_len = info.le.data_len->tx_max_len;
+#endif
+#if defined(CONFIG_BT_USER_PHY_UPDATE)
+	phy = info.le.phy->tx_phy;
+#endif
+
+	/* Left empty rather than repeating the maximum. */
+	if (node->completed >= P99_MIN_SAMPLES) {
+		snprintk(lat_p99, sizeof(lat_p99), "%u",
+			 percentile(node->lat_us, node->completed, 99));
+	}
+
+	/* node,obj_size,mtu,data_len,phy,conn_interval_us,iterations,failed,bytes_per_s,
+	 * ttfb_p50_us,lat_p50_us,lat_p90_us,lat_p99_us,cpu_busy_pct
+	 */
+	printk("CSV,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%s,%u\n", bt_conn_index(node->conn),
+	       node->obj_size, bt_gatt_get_mtu(node->conn), data_len, phy,
+	       BT_CONN_INTERVAL_TO_US(info.le.interval), ITERATIONS,
+	       ITERATIONS - node->completed,
+	       (total_us > 0) ? (uint32_t)(((uint64_t)node->obj_size * node->completed *
+					    USEC_PER_SEC) /
+					   total_us)
+			      : 0U,
+	       percentile(node->ttfb_us, node->completed, 50),
+	       percentile(node->lat_us, node->completed, 50),
+	       percentile(node->lat_us, node->completed, 90), lat_p99, busy_pct);
+}
+
+static void bench_work_fn(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct bench_node *node = CONTAINER_OF(dwork, struct bench_node, work);
+	int err = 0;
+
+	if (node->conn == NULL) {
+		return;
+	}
+
+	switch (node->step) {
+	case BENCH_SELECT_FIRST:
+		err = otc_mux_select_first(node->conn);
+		break;
+	case BENCH_SELECT_NEXT:
+		err = otc_mux_select_next(node->conn);
+		break;
+	case BENCH_READ_METADATA:
+		err = otc_mux_read_metadata(node->conn, BT_OTS_METADATA_REQ_SIZE);
+		break;
+	case BENCH_READ_DATA:
+		node->first_chunk = true;
+		node->req_us = now_us();
+		err = otc_mux_read_data(node->conn);
+		break;
+	case BENCH_FINISH:
+		printk("Bench: node %u done\n", bt_conn_index(node->conn));
+		err = bt_conn_disconnect(node->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		break;
+	}
+
+	if (err == -EBUSY) {
+		(void)k_work_reschedule(&node->work, K_MSEC(BENCH_RETRY_MS));
+	} else if (err != 0) {
+		printk("Bench: step %d failed (err %d)\n", node->step, err);
+	}
+}
+
+static void bench_next(struct bench_node *node, enum bench_step step)
+{
+	node->step = step;
+	(void)k_work_reschedule(&node->work, K_NO_WAIT);
+}
+
+void bench_start(struct bt_ots_client *otc, struct bt_conn *conn)
+{
+	struct bench_node *node = &nodes[bt_conn_index(conn)];
+
+	node->otc = otc;
+	node->conn = conn;
+	k_work_init_delayable(&node->work, bench_work_fn);
+	bench_next(node, BENCH_SELECT_FIRST);
+}
+
+bool bench_obj_selected(struct bt_conn *conn, int res)
+{
+	struct bench_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return false;
+	}
+
+	if (res == BT_GATT_OTS_OLCP_RES_SUCCESS) {
+		bench_next(node, BENCH_READ_METADATA);
+	} else if (res == BT_GATT_OTS_OLCP_RES_OUT_OF_BONDS) {
+		bench_next(node, BENCH_FINISH);
+	} else {
+		printk("Bench: select failed (res %d)\n", res);
+		bench_next(node, BENCH_FINISH);
+	}
+
+	return true;
+}
+
+void bench_obj_metadata_read(struct bt_conn *conn, int err)
+{
+	struct bench_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return;
+	}
+
+	if (err != 0) {
+		bench_next(node, BENCH_SELECT_NEXT);
+		return;
+	}
+
+	node->obj_size = node->otc->cur_object.size.cur;
+	node->iteration = 0;
+	node->completed = 0;
+	(void)k_thread_runtime_stats_all_get(&node->rt_start);
+	bench_next(node, BENCH_READ_DATA);
+}
+
+void bench_stop(struct bt_conn *conn)
+{
+	struct bench_node *node = node_get(conn);
+
+	if (node != NULL) {
+		(void)k_work_cancel_delayable(&node->work);
+		node->conn = NULL;
+	}
+}
+
+static int bench_sink_write(struct obj_sink *sink, struct bt_conn *conn, uint32_t offset,
+			    const uint8_t *data, uint32_t len)
+{
+	struct bench_node *node = node_get(conn);
+
+	if (node != NULL && node->first_chunk) {
+		node->first_chunk = false;
+		node->ttfb_us[node->completed] = (uint32_t)(now_us() - node->req_us);
+	}
+
+	return 0;
+}
+
+static void bench_sink_end(struct obj_sink *sink, struct bt_conn *conn, uint32_t total,
+			   bool complete)
+{
+	struct bench_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return;
+	}
+
+	if (complete) {
+		node->lat_us[node->completed] = (uint32_t)(now_us() - node->req_us);
+		node->completed++;
+	} else {
+		printk("Bench: node %u read %u of %u bytes\n", bt_conn_index(conn), total,
+		       node->obj_size);
+	}
+
+	node->iteration++;
+
+	if (node->iteration < ITERATIONS) {
+		bench_next(node, BENCH_READ_DATA);
+		return;
+	}
+
+	bench_report(node);
+	bench_next(node, BENCH_SELECT_NEXT);
+}
+
+static const struct obj_sink_api bench_sink_api = {
+	.write = bench_sink_write,
+	.end = bench_sink_end,
+};
+
+static struct obj_sink bench_sink = {
+	.api = &bench_sink_api,
+};
+
+void bench_init(void)
+{
+	printk("CSV,node,obj_size,mtu,data_len,phy,conn_interval_us,iterations,failed,bytes_per_s,"
+	       "ttfb_p50_us,lat_p50_us,lat_p90_us,lat_p99_us,cpu_busy_pct\n");
+	obj_sink_register(&bench_sink);
+}
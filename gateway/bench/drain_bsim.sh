@@ -0,0 +1,49 @@
+#!/usr/bin/env bash
+# Drain a growing number of nodes under BabbleSim and compare the aggregate
+# against a single node.
+#
+# Usage: drain_bsim.sh <gateway zephyr.exe> <node zephyr.exe> [sim seconds] [node counts...]
+#
+# Both images are the default builds for nrf52_bsim. Needs BSIM_OUT_PATH to
+# point at a BabbleSim build. Node counts default to 1 and 8; the gateway
+# needs CONFIG_BT_MAX_CONN at least as large as the largest count.
+#
+# For every count, prints the last "All nodes drained" line of the gateway,
+# i.e. bytes, time to drain all nodes and aggregate bytes per second, and
+# the ratio of the aggregate to the one-node run.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+set -eu
+
+GATEWAY_EXE=$1
+NODE_EXE=$2
+SIM_SECONDS=${3:-300}
+shift $(($# < 3 ? $# : 3))
+COUNTS=${*:-1 8}
+
+cd "${BSIM_OUT_PATH}/bin"
+
+BASE_RATE=
+for NODES in ${COUNTS}; do
+	SIM_ID=ots_drain_${NODES}_$$
+
+	"${GATEWAY_EXE}" -s="${SIM_ID}" -d=0 -rs=1 > "${SIM_ID}_gateway.log" &
+	for i in $(seq 1 "${NODES}"); do
+		"${NODE_EXE}" -s="${SIM_ID}" -d="${i}" -rs=$((i + 1)) > /dev/null &
+	done
+
+	./bs_2G4_phy_v1 -s="${SIM_ID}" -D=$((NODES + 1)) -sim_length=$((SIM_SECONDS * 1000000))
+	wait
+
+	LINE=$(grep 'All nodes drained' "${SIM_ID}_gateway.log" | tail -n 1 || true)
+	if [ -z "${LINE}" ]; then
+		echo "${NODES} node(s): not drained within ${SIM_SECONDS} s"
+		continue
+	fi
+
+	# All nodes drained: <bytes> bytes in <ms> ms (<rate> B/s)
+	RATE=$(echo "${LINE}" | sed -n 's/.*(\([0-9]*\) B\/s).*/\1/p')
+	BASE_RATE=${BASE_RATE:-${RATE}}
+	echo "${NODES} node(s): ${LINE#*: }, x$(awk "BEGIN { printf \"%.2f\", ${RATE} / ${BASE_RATE} }")"
+done
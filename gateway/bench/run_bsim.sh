@@ -0,0 +1,29 @@
+#!/usr/bin/env bash
+# Run the OTS throughput benchmark under BabbleSim and collect the CSV rows.
+#
+# Usage: run_bsim.sh <gateway zephyr.exe> <node zephyr.exe> [nodes] [sim seconds]
+#
+# Both images must be built for nrf52_bsim with overlay-bench.conf. Needs
+# BSIM_OUT_PATH to point at a BabbleSim build.
+#
+# SPDX-License-Identifier: Apache-2.0
+
+set -eu
+
+GATEWAY_EXE=$1
+NODE_EXE=$2
+NODES=${3:-1}
+SIM_SECONDS=${4:-120}
+SIM_ID=ots_bench_$$
+
+cd "${BSIM_OUT_PATH}/bin"
+
+"${GATEWAY_EXE}" -s="${SIM_ID}" -d=0 -rs=1 > "${SIM_ID}_gateway.log" &
+for i in $(seq 1 "${NODES}"); do
+	"${NODE_EXE}" -s="${SIM_ID}" -d="${i}" -rs=$((i + 1)) > /dev/null &
+done
+
+./bs_2G4_phy_v1 -s="${SIM_ID}" -D=$((NODES + 1)) -sim_length=$((SIM_SECONDS * 1000000))
+wait
+
+grep '^CSV,' "${SIM_ID}_gateway.log" | cut -d, -f2-
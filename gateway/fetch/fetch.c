@@ -0,0 +1,495 @@
+/** @file
+ *  @brief Pipelined object fetch from the gateway
+ *
+ * Walks the object list of every connected node without waiting on the
+ * user: each select, metadata read, data read and delete is issued from
+ * the completion of the previous step. The directory listing is read once
+ * at the start and the walk goes to each listed object by ID, so a delete,
+ * which leaves no current object behind, costs no walk from the first
+ * object. The node is disconnected once the listed objects are done, to
+ * keep its radio window short.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "evtlog.h"
+#include "fetch.h"
+#include "obj_sink.h"
+#include "otc_mux.h"
+
+/* Hardcoded here since definition is in internal header */
+#define BT_GATT_OTS_OLCP_RES_SUCCESS  0x01
+#define BT_GATT_OTS_OACP_PROC_DELETE  0x02
+#define BT_GATT_OTS_OACP_PROC_RESP    0x60
+#define BT_GATT_OTS_OACP_RES_SUCCESS  0x01
+#define BT_OTS_OBJ_ID_DIR_LIST        0x000000000000
+
+/* The pipeline only needs what decides on the read and feeds the sinks,
+ * plus the name when it carries the CRC the data is checked against or the
+ * record and offset a read is resumed by.
+ */
+#define FETCH_METADATA                                                                             \
+	(BT_OTS_METADATA_REQ_TYPE | BT_OTS_METADATA_REQ_SIZE | BT_OTS_METADATA_REQ_ID |             \
+	 BT_OTS_METADATA_REQ_PROPS |                                                                \
+	 ((IS_ENABLED(CONFIG_GATEWAY_OBJ_CRC) || IS_ENABLED(CONFIG_GATEWAY_RESUME))                 \
+		  ? BT_OTS_METADATA_REQ_NAME                                                        \
+		  : 0))
+
+/* Back-off while another node runs an OTS client procedure. */
+#define FETCH_RETRY_MS 5
+
+/* Directory listing record: length, ID, name length, name, flags and a
+ * 16-bit type at least; a 128-bit type, both sizes, both times and the
+ * properties at most.
+ */
+#define DIRLIST_REC_MIN (2 + 6 + 1 + 1 + 2)
+#define DIRLIST_REC_MAX (2 + 6 + 1 + CONFIG_BT_OTS_OBJ_MAX_NAME_LEN + 1 + 16 + 8 + 7 + 7 + 4)
+
+enum fetch_step {
+	FETCH_SELECT_DIR,
+	FETCH_READ_DIR,
+	FETCH_SELECT,
+	FETCH_READ_METADATA,
+	FETCH_READ_DATA,
+	FETCH_DELETE,
+	FETCH_FINISH,
+};
+
+struct fetch_node {
+	struct bt_ots_client *otc;
+	struct bt_conn *conn;
+	struct k_work_delayable work;
+	struct bt_gatt_write_params write_params;
+	enum fetch_step step;
+	/* Object IDs from the directory listing, walked in order. */
+	uint64_t ids[CONFIG_GATEWAY_FETCH_OBJ_MAX];
+	size_t id_count;
+	size_t id_next;
+	bool listed;
+	/* Listing record being reassembled across chunks. */
+	uint8_t rec[DIRLIST_REC_MAX];
+	uint16_t rec_len;
+	uint16_t rec_skip;
+	bool list_bad;
+	uint32_t unlisted;
+	/* Current object: start of the step and time spent per phase. */
+	int64_t step_us;
+	uint32_t lookup_us;
+	uint32_t read_us;
+	uint32_t obj_len;
+	/* Session totals. */
+	int64_t start_ms;
+	uint32_t objects;
+	uint32_t bytes;
+	uint32_t lookups;
+	uint32_t kept;
+};
+
+static struct fetch_node nodes[CONFIG_BT_MAX_CONN];
+
+/* The listing decoder's callback takes no user data. */
+static struct fetch_node *listing_node;
+
+static const uint8_t delete_op = BT_GATT_OTS_OACP_PROC_DELETE;
+
+static int64_t now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static struct fetch_node *node_get(struct bt_conn *conn)
+{
+	struct fetch_node *node = &nodes[bt_conn_index(conn)];
+
+	return (node->conn == conn) ? node : NULL;
+}
+
+static uint32_t step_elapsed_us(struct fetch_node *node)
+{
+	int64_t now = now_us();
+	uint32_t elapsed = (uint32_t)(now - node->step_us);
+
+	node->step_us = now;
+
+	return elapsed;
+}
+
+static void fetch_next(struct fetch_node *node, enum fetch_step step)
+{
+	node->step = step;
+	(void)k_work_reschedule(&node->work, K_NO_WAIT);
+}
+
+static void obj_report(struct fetch_node *node, uint32_t delete_us)
+{
+	node->objects++;
+	node->bytes += node->obj_len;
+
+	EVTLOG("Fetch: object 0x%x, %u bytes in %u us\n", (uint32_t)node->otc->cur_object.id,
+	       node->obj_len, node->lookup_us + node->read_us + delete_us);
+	EVTLOG("Fetch: lookup %u us, read %u us, delete %u us\n", node->lookup_us, node->read_us,
+	       delete_us);
+
+	/* Skipped objects on the way to the next one count as its lookup. */
+	node->lookup_us = 0;
+}
+
+static void session_report(struct fetch_node *node)
+{
+	uint32_t elapsed_ms = (uint32_t)(k_uptime_get() - node->start_ms);
+
+	printk("Fetch: node %u done, %u objects, %u bytes in %u ms (%u B/s), %u kept, "
+	       "%u lookups\n",
+	       bt_conn_index(node->conn), node->objects, node->bytes, elapsed_ms,
+	       (elapsed_ms > 0) ? (uint32_t)((node->bytes * 1000ULL) / elapsed_ms) : 0U,
+	       node->kept, node->lookups);
+}
+
+static int dirlist_obj(struct bt_ots_obj_metadata *meta)
+{
+	struct fetch_node *node = listing_node;
+
+	if (meta->id == BT_OTS_OBJ_ID_DIR_LIST) {
+		return BT_OTS_CONTINUE;
+	}
+
+	if (node->id_count == ARRAY_SIZE(node->ids)) {
+		node->unlisted++;
+		return BT_OTS_CONTINUE;
+	}
+
+	node->ids[node->id_count++] = meta->id;
+
+	return BT_OTS_CONTINUE;
+}
+
+static void dirlist_record(struct fetch_node *node)
+{
+	int err;
+
+	listing_node = node;
+	err = bt_ots_client_decode_dirlisting(node->rec, node->rec_len, dirlist_obj);
+	listing_node = NULL;
+
+	if (err < 0) {
+		printk("Fetch: bad listing record (err %d)\n", err);
+		node->unlisted++;
+	}
+}
+
+/* Split the listing into records as it arrives, whatever the chunk size. */
+static void dirlist_feed(struct fetch_node *node, const uint8_t *data, uint32_t len)
+{
+	while (len > 0 && !node->list_bad) {
+		uint16_t want = (node->rec_len < 2) ? 2 : sys_get_le16(node->rec);
+		uint32_t n;
+
+		if (node->rec_skip > 0) {
+			n = MIN(len, node->rec_skip);
+			node->rec_skip -= n;
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		n = MIN(len, (uint32_t)(want - node->rec_len));
+		memcpy(&node->rec[node->rec_len], data, n);
+		node->rec_len += n;
+		data += n;
+		len -= n;
+
+		if (node->rec_len == 2) {
+			want = sys_get_le16(node->rec);
+
+			if (want < DIRLIST_REC_MIN) {
+				/* No way to find the next record. */
+				node->list_bad = true;
+			} else if (want > sizeof(node->rec)) {
+				node->rec_skip = want - 2;
+				node->rec_len = 0;
+				node->unlisted++;
+			}
+		} else if (node->rec_len == want) {
+			dirlist_record(node);
+			node->rec_len = 0;
+		}
+	}
+}
+
+static void delete_written(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+	struct fetch_node *node = node_get(conn);
+
+	if (node == NULL || err == 0) {
+		/* The outcome comes with the OACP indication. */
+		return;
+	}
+
+	printk("Fetch: delete request failed (err 0x%02x)\n", err);
+	obj_report(node, step_elapsed_us(node));
+	node->kept++;
+	fetch_next(node, FETCH_SELECT);
+}
+
+static int obj_delete(struct fetch_node *node)
+{
+	node->write_params.func = delete_written;
+	node->write_params.handle = node->otc->oacp_handle;
+	node->write_params.offset = 0;
+	node->write_params.data = &delete_op;
+	node->write_params.length = sizeof(delete_op);
+
+	return bt_gatt_write(node->conn, &node->write_params);
+}
+
+static void fetch_work_fn(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct fetch_node *node = CONTAINER_OF(dwork, struct fetch_node, work);
+	int err = 0;
+
+	if (node->conn == NULL) {
+		return;
+	}
+
+	switch (node->step) {
+	case FETCH_SELECT_DIR:
+		node->step_us = now_us();
+		err = otc_mux_select_id(node->conn, BT_OTS_OBJ_ID_DIR_LIST);
+		break;
+	case FETCH_READ_DIR:
+		err = otc_mux_read_data(node->conn);
+		break;
+	case FETCH_SELECT:
+		if (node->id_next == node->id_count) {
+			fetch_next(node, FETCH_FINISH);
+			return;
+		}
+
+		node->step_us = now_us();
+		err = otc_mux_select_id(node->conn, node->ids[node->id_next]);
+		if (err == 0) {
+			node->id_next++;
+		}
+		break;
+	case FETCH_READ_METADATA:
+		err = otc_mux_read_metadata(node->conn, FETCH_METADATA);
+		break;
+	case FETCH_READ_DATA:
+		err = otc_mux_read_data(node->conn);
+		break;
+	case FETCH_DELETE:
+		err = obj_delete(node);
+		break;
+	case FETCH_FINISH:
+		session_report(node);
+		err = bt_conn_disconnect(node->conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		break;
+	}
+
+	if (err == -EBUSY || err == -ENOMEM) {
+		(void)k_work_reschedule(&node->work, K_MSEC(FETCH_RETRY_MS));
+	} else if (err != 0 && node->step != FETCH_FINISH) {
+		printk("Fetch: step %d failed (err %d)\n", node->step, err);
+		fetch_next(node, FETCH_FINISH);
+	} else if (err != 0) {
+		printk("Fetch: disconnect failed (err %d)\n", err);
+	}
+}
+
+void fetch_start(struct bt_ots_client *otc, struct bt_conn *conn)
+{
+	struct fetch_node *node = &nodes[bt_conn_index(conn)];
+
+	node->otc = otc;
+	node->conn = conn;
+	node->id_count = 0;
+	node->id_next = 0;
+	node->listed = false;
+	node->rec_len = 0;
+	node->rec_skip = 0;
+	node->list_bad = false;
+	node->unlisted = 0;
+	node->start_ms = k_uptime_get();
+	node->objects = 0;
+	node->bytes = 0;
+	node->lookups = 0;
+	node->kept = 0;
+	node->lookup_us = 0;
+	k_work_init_delayable(&node->work, fetch_work_fn);
+	fetch_next(node, FETCH_SELECT_DIR);
+}
+
+bool fetch_obj_selected(struct bt_conn *conn, int res)
+{
+	struct fetch_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return false;
+	}
+
+	if (res == BT_GATT_OTS_OLCP_RES_SUCCESS) {
+		fetch_next(node, FETCH_READ_METADATA);
+	} else if (!node->listed) {
+		printk("Fetch: node %u has no directory listing (res %d)\n",
+		       bt_conn_index(conn), res);
+		fetch_next(node, FETCH_FINISH);
+	} else {
+		/* Gone since the listing was read. */
+		node->lookup_us += step_elapsed_us(node);
+		fetch_next(node, FETCH_SELECT);
+	}
+
+	return true;
+}
+
+void fetch_obj_metadata_read(struct bt_conn *conn, int err)
+{
+	struct fetch_node *node = node_get(conn);
+	const struct bt_ots_obj_metadata *obj;
+
+	if (node == NULL) {
+		return;
+	}
+
+	obj = &node->otc->cur_object;
+
+	if (!node->listed) {
+		/* The listing's size tells the OTS client how much to read. */
+		fetch_next(node, (err == 0 && obj->id == BT_OTS_OBJ_ID_DIR_LIST) ? FETCH_READ_DIR
+										: FETCH_FINISH);
+		return;
+	}
+
+	node->lookup_us += step_elapsed_us(node);
+	node->lookups++;
+
+	if (err != 0 || !BT_OTS_OBJ_GET_PROP_READ(obj->props)) {
+		fetch_next(node, FETCH_SELECT);
+		return;
+	}
+
+	fetch_next(node, FETCH_READ_DATA);
+}
+
+bool fetch_dirlist_read(struct bt_conn *conn, const uint8_t *data, uint32_t len, bool complete)
+{
+	struct fetch_node *node = node_get(conn);
+
+	if (node == NULL || node->step != FETCH_READ_DIR) {
+		return false;
+	}
+
+	dirlist_feed(node, data, len);
+
+	if (!complete) {
+		return true;
+	}
+
+	if (node->list_bad || node->rec_len != 0 || node->rec_skip != 0) {
+		printk("Fetch: node %u listing truncated\n", bt_conn_index(conn));
+	}
+
+	if (node->unlisted > 0) {
+		printk("Fetch: %u objects left for the next session\n", node->unlisted);
+	}
+
+	node->listed = true;
+	node->lookup_us = step_elapsed_us(node);
+	fetch_next(node, FETCH_SELECT);
+
+	return true;
+}
+
+void fetch_oacp_indicated(struct bt_conn *conn, const uint8_t *data, uint16_t len)
+{
+	struct fetch_node *node = node_get(conn);
+
+	if (node == NULL || node->step != FETCH_DELETE || len < 3 ||
+	    data[0] != BT_GATT_OTS_OACP_PROC_RESP || data[1] != BT_GATT_OTS_OACP_PROC_DELETE) {
+		return;
+	}
+
+	obj_report(node, step_elapsed_us(node));
+
+	if (data[2] != BT_GATT_OTS_OACP_RES_SUCCESS) {
+		printk("Fetch: object 0x%x not deleted (res %u)\n",
+		       (uint32_t)node->otc->cur_object.id, data[2]);
+		node->kept++;
+	}
+
+	/* Go To the next listed object; the deleted one left no current object. */
+	fetch_next(node, FETCH_SELECT);
+}
+
+void fetch_stop(struct bt_conn *conn)
+{
+	struct fetch_node *node = node_get(conn);
+
+	if (node != NULL) {
+		(void)k_work_cancel_delayable(&node->work);
+		node->conn = NULL;
+	}
+}
+
+static int fetch_sink_write(struct obj_sink *sink, struct bt_conn *conn, uint32_t offset,
+			    const uint8_t *data, uint32_t len)
+{
+	return 0;
+}
+
+static void fetch_sink_end(struct obj_sink *sink, struct bt_conn *conn, uint32_t total,
+			   bool complete)
+{
+	struct fetch_node *node = node_get(conn);
+	const struct bt_ots_obj_metadata *obj;
+
+	if (node == NULL || node->step != FETCH_READ_DATA) {
+		return;
+	}
+
+	obj = &node->otc->cur_object;
+	node->read_us = step_elapsed_us(node);
+	node->obj_len = total;
+
+	if (!complete) {
+		/* Cut short or failed its CRC: left on the node for the next session. */
+		node->kept++;
+		fetch_next(node, FETCH_SELECT);
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_GATEWAY_FETCH_DELETE) && BT_OTS_OBJ_GET_PROP_DELETE(obj->props)) {
+		fetch_next(node, FETCH_DELETE);
+		return;
+	}
+
+	obj_report(node, 0);
+	node->kept++;
+	fetch_next(node, FETCH_SELECT);
+}
+
+static const struct obj_sink_api fetch_sink_api = {
+	.write = fetch_sink_write,
+	.end = fetch_sink_end,
+};
+
+static struct obj_sink fetch_sink = {
+	.api = &fetch_sink_api,
+};
+
+void fetch_init(void)
+{
+	obj_sink_register(&fetch_sink);
+}
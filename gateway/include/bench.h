@@ -0,0 +1,43 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/services/ots.h>
+
+/**
+ * @brief Print the CSV header and register the benchmark object sink
+ */
+void bench_init(void);
+
+/**
+ * @brief Start fetching every object of a node once its OTS client is subscribed
+ *
+ * Each object is read CONFIG_GATEWAY_BENCH_ITERATIONS times and one CSV row
+ * is printed per object. The node is disconnected when its list is done.
+ */
+void bench_start(struct bt_ots_client *otc, struct bt_conn *conn);
+
+/**
+ * @brief Feed an OLCP select result to the benchmark
+ *
+ * @return true if the benchmark owns the connection and handled the result
+ */
+bool bench_obj_selected(struct bt_conn *conn, int res);
+
+/**
+ * @brief Feed a metadata read result to the benchmark
+ */
+void bench_obj_metadata_read(struct bt_conn *conn, int err);
+
+/**
+ * @brief Drop the benchmark state of a disconnected node
+ */
+void bench_stop(struct bt_conn *conn);
+
+#endif /* BENCH_H */
@@ -0,0 +1,63 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FETCH_H
+#define FETCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/services/ots.h>
+
+/**
+ * @brief Register the fetch pipeline object sink
+ */
+void fetch_init(void);
+
+/**
+ * @brief Start fetching every object of a node once its OTS client is subscribed
+ *
+ * The directory listing is read first, then every listed object is
+ * selected by ID, its metadata read and its data read back to back, each
+ * step issued from the completion of the previous one. Fetched objects are
+ * deleted on the node when they allow it, and the node is disconnected
+ * once every listed object has been visited.
+ */
+void fetch_start(struct bt_ots_client *otc, struct bt_conn *conn);
+
+/**
+ * @brief Feed an OLCP select result to the pipeline
+ *
+ * @return true if the pipeline owns the connection and handled the result
+ */
+bool fetch_obj_selected(struct bt_conn *conn, int res);
+
+/**
+ * @brief Feed a metadata read result to the pipeline
+ */
+void fetch_obj_metadata_read(struct bt_conn *conn, int err);
+
+/**
+ * @brief Feed a chunk of object data to the pipeline if it is the directory listing
+ *
+ * @return true if the pipeline was reading the listing and took the chunk,
+ *         false if the data belongs to an object for the sinks
+ */
+bool fetch_dirlist_read(struct bt_conn *conn, const uint8_t *data, uint32_t len, bool complete);
+
+/**
+ * @brief Feed an OACP indication to the pipeline
+ *
+ * The OTS client has no callback for the delete procedure, so the raw
+ * indication is inspected for its response instead.
+ */
+void fetch_oacp_indicated(struct bt_conn *conn, const uint8_t *data, uint16_t len);
+
+/**
+ * @brief Drop the pipeline state of a disconnected node
+ */
+void fetch_stop(struct bt_conn *conn);
+
+#endif /* FETCH_H */
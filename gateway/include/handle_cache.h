@@ -0,0 +1,55 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef HANDLE_CACHE_H
+#define HANDLE_CACHE_H
+
+#include <zephyr/bluetooth/addr.h>
+#include <zephyr/types.h>
+
+/* Length of the GATT Database Hash characteristic value. */
+#define HANDLE_CACHE_DB_HASH_LEN 16
+
+/**
+ * @brief OTS attribute handles of one node, valid for one GATT database hash
+ */
+struct handle_cache_entry {
+	bt_addr_le_t addr;
+	uint8_t db_hash[HANDLE_CACHE_DB_HASH_LEN];
+	uint16_t start_handle;
+	uint16_t end_handle;
+	uint16_t feature_handle;
+	uint16_t obj_name_handle;
+	uint16_t obj_type_handle;
+	uint16_t obj_size_handle;
+	uint16_t obj_id_handle;
+	uint16_t obj_properties_handle;
+	uint16_t oacp_handle;
+	uint16_t olcp_handle;
+	/* ATT requests the full discovery of this node took. */
+	uint16_t disc_requests;
+};
+
+/**
+ * @brief Look up the cached handles of a node
+ *
+ * @param addr Address the node is connected with
+ * @param db_hash Database hash just read from the node
+ * @return Cached entry, or NULL if the node is unknown or its database changed
+ */
+const struct handle_cache_entry *handle_cache_find(const bt_addr_le_t *addr,
+						   const uint8_t *db_hash);
+
+/**
+ * @brief Store or refresh the handles of a node
+ *
+ * The entry is persisted to settings later, from the system workqueue, so
+ * this is safe to call from the Bluetooth RX thread.
+ *
+ * @param entry Entry to store, copied into the cache
+ * @return int 0 on success, negative errno on failure
+ */
+int handle_cache_store(const struct handle_cache_entry *entry);
+
+#endif /* HANDLE_CACHE_H */
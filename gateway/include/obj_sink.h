@@ -0,0 +1,74 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef OBJ_SINK_H
+#define OBJ_SINK_H
+
+#include <stdbool.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/services/ots.h>
+#include <zephyr/sys/slist.h>
+#include <zephyr/types.h>
+
+struct obj_sink;
+
+/**
+ * @brief Operations of a consumer of incoming OTS object data
+ *
+ * All operations run on the Bluetooth RX thread and must not block. Chunks
+ * are handed over in place: @p data is only valid for the duration of the
+ * call, so a sink either consumes it immediately or copies what it needs.
+ */
+struct obj_sink_api {
+	/** Object transfer from @p conn is starting. Optional. */
+	void (*begin)(struct obj_sink *sink, struct bt_conn *conn,
+		      const struct bt_ots_obj_metadata *obj);
+
+	/** Chunk of @p len bytes at @p offset. Return negative errno to abort the read. */
+	int (*write)(struct obj_sink *sink, struct bt_conn *conn, uint32_t offset,
+		     const uint8_t *data, uint32_t len);
+
+	/** Transfer of @p total bytes ended, @p complete false if it was cut short. Optional. */
+	void (*end)(struct obj_sink *sink, struct bt_conn *conn, uint32_t total, bool complete);
+};
+
+/**
+ * @brief Registered consumer of incoming OTS object data
+ */
+struct obj_sink {
+	const struct obj_sink_api *api;
+	sys_snode_t node;
+};
+
+/**
+ * @brief Register a sink; every registered sink sees every object
+ *
+ * @param sink Sink to add, must stay valid while registered
+ */
+void obj_sink_register(struct obj_sink *sink);
+
+/**
+ * @brief Announce the start of an object transfer to all sinks
+ */
+void obj_sink_begin(struct bt_conn *conn, const struct bt_ots_obj_metadata *obj);
+
+/**
+ * @brief Hand one received chunk to all sinks without copying it
+ *
+ * @return int 0 on success, first negative errno returned by a sink otherwise
+ */
+int obj_sink_write(struct bt_conn *conn, uint32_t offset, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Announce the end of an object transfer to all sinks
+ */
+void obj_sink_end(struct bt_conn *conn, uint32_t total, bool complete);
+
+/**
+ * @brief Register the built-in sinks enabled in Kconfig
+ */
+void obj_sink_init(void);
+
+#endif /* OBJ_SINK_H */
@@ -0,0 +1,136 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef OTC_MUX_H
+#define OTC_MUX_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/services/ots.h>
+#include <zephyr/types.h>
+
+/**
+ * @brief Callbacks of the multiplexer beyond those of bt_ots_client_cb
+ */
+struct otc_mux_cb {
+	/**
+	 * A read ended before its last byte: the node rejected it or the
+	 * object channel dropped. Not called for a read stopped by returning
+	 * BT_OTS_STOP from obj_data_read.
+	 */
+	void (*read_failed)(struct bt_conn *conn, int err);
+};
+
+/**
+ * @brief Set the callbacks; call once before the first attach
+ */
+void otc_mux_init(const struct otc_mux_cb *cb);
+
+/**
+ * @brief Take over a subscribed OTS client instance
+ *
+ * The instance is registered with the OTS client and has its handles
+ * discovered. Its service range is parked and only copied into the
+ * instance while one of its procedures is running.
+ *
+ * @param otc Client instance of the node, its cb is used for all results
+ * @param conn Connection to the node
+ * @param start_handle First handle of the OTS service
+ * @param end_handle Last handle of the OTS service
+ */
+void otc_mux_attach(struct bt_ots_client *otc, struct bt_conn *conn, uint16_t start_handle,
+		    uint16_t end_handle);
+
+/**
+ * @brief Forget a node; its procedure, read or write in progress is dropped
+ */
+void otc_mux_detach(struct bt_conn *conn);
+
+/**
+ * @brief Read the OTS Feature characteristic into the instance
+ *
+ * Runs in parallel with every other node.
+ *
+ * @return int 0 on success, negative errno otherwise
+ */
+int otc_mux_read_feature(struct bt_conn *conn);
+
+/**
+ * @brief Select an object by ID, as bt_ots_client_select_id()
+ *
+ * This and the other OTS client procedures below run on one node at a
+ * time. The next one may start once the result callback of the running
+ * one has called otc_mux_done().
+ *
+ * @return int 0 on success, -EBUSY while another node runs a procedure,
+ *         other negative errno otherwise
+ */
+int otc_mux_select_id(struct bt_conn *conn, uint64_t id);
+
+/**
+ * @brief Select the first object, as bt_ots_client_select_first()
+ */
+int otc_mux_select_first(struct bt_conn *conn);
+
+/**
+ * @brief Select the next object, as bt_ots_client_select_next()
+ */
+int otc_mux_select_next(struct bt_conn *conn);
+
+/**
+ * @brief Read metadata of the current object, as bt_ots_client_read_object_metadata()
+ */
+int otc_mux_read_metadata(struct bt_conn *conn, uint8_t metadata);
+
+/**
+ * @brief Checksum part of the current object, as bt_ots_client_get_object_checksum()
+ */
+int otc_mux_get_checksum(struct bt_conn *conn, off_t offset, size_t len);
+
+/**
+ * @brief End the OTS client procedure of @p conn, if it runs one
+ *
+ * Called from the obj_selected, obj_metadata_read and
+ * obj_checksum_calculated callbacks.
+ */
+void otc_mux_done(struct bt_conn *conn);
+
+/**
+ * @brief Read the whole current object over the node's own object channel
+ *
+ * The size comes from the last metadata read. Data is handed to the
+ * obj_data_read callback of the instance as the OTS client would, while
+ * other nodes run reads and procedures of their own.
+ *
+ * @return int 0 on success, -EBUSY while a read or write of the node is in
+ *         progress, other negative errno otherwise
+ */
+int otc_mux_read_data(struct bt_conn *conn);
+
+/**
+ * @brief Write to the current object over the node's own object channel
+ *
+ * @p buf must stay valid until the obj_data_written callback.
+ *
+ * @return int 0 on success, -EBUSY while a read or write of the node is in
+ *         progress, other negative errno otherwise
+ */
+int otc_mux_write_data(struct bt_conn *conn, const void *buf, size_t len, off_t offset,
+		       enum bt_ots_oacp_write_op_mode mode);
+
+/**
+ * @brief Indication handler for the OACP and OLCP of every node
+ *
+ * Takes the responses to reads and writes of the node and hands the rest
+ * to the OTS client while the node runs a procedure. Others are dropped:
+ * the OTS client would pick the instance by handle and could match
+ * another node.
+ */
+uint8_t otc_mux_indicate(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+			 const void *data, uint16_t length);
+
+#endif /* OTC_MUX_H */
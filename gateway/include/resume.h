@@ -0,0 +1,50 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef RESUME_H
+#define RESUME_H
+
+#include <stdbool.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/types.h>
+
+/**
+ * @brief Start tracking an object read from a node
+ *
+ * A whole object starts a fresh entry. A continuation, named with the
+ * record offset it starts at, picks up the entry kept from the read that
+ * was cut short; the part received before is handed back so it can be
+ * replayed to the sinks ahead of the new data.
+ *
+ * @param conn Connection the object is read on
+ * @param name Object name
+ * @param prefix Set to the data already received, or NULL
+ * @param prefix_len Set to the length of @p prefix
+ * @return int 0 on success, -ENOENT for a continuation whose first part
+ *         is not kept
+ */
+int resume_begin(struct bt_conn *conn, const char *name, const uint8_t **prefix,
+		 uint32_t *prefix_len);
+
+/**
+ * @brief Keep a received chunk of the current object
+ *
+ * @param offset Offset of the chunk in the whole record
+ * @param len Chunk length; bytes sent on air for the object are counted
+ */
+void resume_capture(struct bt_conn *conn, uint32_t offset, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Finish tracking the current object
+ *
+ * A complete object drops its entry and, if it took more than one read,
+ * logs the bytes sent on air against its size. An incomplete one keeps
+ * what was received for a later continuation.
+ *
+ * @param size Length of the whole record received so far
+ */
+void resume_end(struct bt_conn *conn, uint32_t size, bool complete);
+
+#endif /* RESUME_H */
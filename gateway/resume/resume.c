@@ -0,0 +1,219 @@
+/** @file
+ *  @brief Resumable object reads
+ *
+ * Keeps the start of every object while it is read. When the link drops,
+ * the node exposes the rest of the record as a continuation named with
+ * the offset it starts at; the kept part is replayed to the sinks and
+ * only the continuation is sent on air. Entries live in RAM, keyed by
+ * node address and record name, so they survive disconnects but not a
+ * reboot of the gateway.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/hci.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "evtlog.h"
+#include "obj_resume.h"
+#include "resume.h"
+
+/* Fits the record names of the node store, e.g. "acc_00000042". */
+#define RESUME_STEM_LEN 24
+
+/* The node resends a continuation from the chunk it was last asked for, so
+ * at most one SDU of a cut read arrives twice.
+ */
+#define RESUME_RESENT_MAX CONFIG_BT_OTS_L2CAP_CHAN_RX_MTU
+
+struct resume_entry {
+	bt_addr_le_t addr;
+	char stem[RESUME_STEM_LEN];
+	/* Bytes of the record kept, from its start. */
+	uint32_t len;
+	/* Bytes sent on air for the record over all its reads. */
+	uint32_t air;
+	uint32_t reads;
+	/* Age for replacement, 0 while the entry is free. */
+	uint32_t stamp;
+	bool faulted;
+	uint8_t data[CONFIG_GATEWAY_RESUME_BUF_SIZE];
+};
+
+static struct resume_entry entries[CONFIG_GATEWAY_RESUME_SLOTS];
+static struct resume_entry *active[CONFIG_BT_MAX_CONN];
+static uint32_t stamp;
+
+static struct resume_entry *entry_find(const bt_addr_le_t *addr, const char *stem, size_t len)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(entries); i++) {
+		struct resume_entry *entry = &entries[i];
+
+		if (entry->stamp != 0 && bt_addr_le_eq(&entry->addr, addr) &&
+		    strncmp(entry->stem, stem, len) == 0 && entry->stem[len] == '\0') {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static bool entry_is_active(const struct resume_entry *entry)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(active); i++) {
+		if (active[i] == entry) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* Free entry, or the least recently used one not being read right now. */
+static struct resume_entry *entry_alloc(void)
+{
+	struct resume_entry *oldest = NULL;
+
+	for (size_t i = 0; i < ARRAY_SIZE(entries); i++) {
+		if (entry_is_active(&entries[i])) {
+			continue;
+		}
+
+		if (oldest == NULL || entries[i].stamp < oldest->stamp) {
+			oldest = &entries[i];
+		}
+	}
+
+	return oldest;
+}
+
+int resume_begin(struct bt_conn *conn, const char *name, const uint8_t **prefix,
+		 uint32_t *prefix_len)
+{
+	const bt_addr_le_t *addr = bt_conn_get_dst(conn);
+	struct resume_entry *entry;
+	uint32_t offset;
+	size_t stem;
+
+	stem = obj_resume_name_parse(name, &offset);
+	active[bt_conn_index(conn)] = NULL;
+	*prefix = NULL;
+	*prefix_len = 0;
+
+	if (stem >= RESUME_STEM_LEN) {
+		/* Not tracked; only a whole object can be read. */
+		return (offset == 0) ? 0 : -ENOENT;
+	}
+
+	entry = entry_find(addr, name, stem);
+
+	if (offset > 0) {
+		if (entry == NULL || entry->len < offset) {
+			return -ENOENT;
+		}
+
+		/* The node resends everything from its offset on. */
+		entry->len = offset;
+		*prefix = entry->data;
+		*prefix_len = offset;
+	} else {
+		if (entry == NULL) {
+			entry = entry_alloc();
+			if (entry == NULL) {
+				/* Every entry is being read; this object cannot be resumed. */
+				EVTLOG("No resume entry free, object read untracked\n");
+				return 0;
+			}
+
+			bt_addr_le_copy(&entry->addr, addr);
+			(void)memcpy(entry->stem, name, stem);
+			entry->stem[stem] = '\0';
+			entry->air = 0;
+			entry->reads = 0;
+			entry->faulted = false;
+		}
+
+		entry->len = 0;
+	}
+
+	entry->reads++;
+	entry->stamp = ++stamp;
+	active[bt_conn_index(conn)] = entry;
+
+	return 0;
+}
+
+void resume_capture(struct bt_conn *conn, uint32_t offset, const uint8_t *data, uint32_t len)
+{
+	struct resume_entry *entry = active[bt_conn_index(conn)];
+
+	if (entry == NULL) {
+		return;
+	}
+
+	entry->air += len;
+
+	/* Beyond the buffer the record can only be resumed up to its end. */
+	if (offset == entry->len && offset + len <= sizeof(entry->data)) {
+		(void)memcpy(&entry->data[offset], data, len);
+		entry->len += len;
+	}
+
+	if (CONFIG_GATEWAY_RESUME_FAULT_BYTES > 0 && !entry->faulted &&
+	    entry->air >= CONFIG_GATEWAY_RESUME_FAULT_BYTES) {
+		entry->faulted = true;
+		EVTLOG("Fault injection: dropping the link at offset %u\n", offset + len);
+		(void)bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	}
+}
+
+/* A record cut by fault injection must have been resumed, not read again:
+ * at least two reads, and on air its size plus at most what was resent.
+ */
+static void fault_check(const struct resume_entry *entry, uint32_t size)
+{
+	bool pass = entry->reads > 1 && entry->air >= size &&
+		    entry->air <= size + RESUME_RESENT_MAX;
+
+	printk("Resume check %s: %s, %u bytes, %u on air in %u reads, at most %u allowed\n",
+	       pass ? "PASS" : "FAIL", entry->stem, size, entry->air, entry->reads,
+	       size + RESUME_RESENT_MAX);
+
+	__ASSERT(pass, "Resumed record %s sent %u bytes on air for %u", entry->stem, entry->air,
+		 size);
+}
+
+void resume_end(struct bt_conn *conn, uint32_t size, bool complete)
+{
+	struct resume_entry *entry = active[bt_conn_index(conn)];
+
+	if (entry == NULL) {
+		return;
+	}
+
+	active[bt_conn_index(conn)] = NULL;
+
+	if (!complete) {
+		return;
+	}
+
+	if (entry->reads > 1) {
+		EVTLOG("Resumed record: %u bytes, %u on air in %u reads\n", size, entry->air,
+		       entry->reads);
+		EVTLOG("Resumed record: on air %u%% of its size\n",
+		       (size > 0) ? (uint32_t)((entry->air * 100ULL) / size) : 0U);
+	}
+
+	if (CONFIG_GATEWAY_RESUME_FAULT_BYTES > 0 && entry->faulted) {
+		fault_check(entry, size);
+	}
+
+	entry->stamp = 0;
+}
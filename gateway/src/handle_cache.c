@@ -0,0 +1,134 @@
+/** @file
+ *  @brief Persistent cache of discovered OTS attribute handles
+ *
+ * Entries are keyed by the address the node connected with. The gateway
+ * never pairs, so there is no identity address to resolve; a node using a
+ * resolvable private address misses the cache whenever its address changes.
+ *
+ * The cache is updated from the Bluetooth RX thread, where a flash write
+ * must not block reception, so changed slots are persisted from the system
+ * workqueue.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "handle_cache.h"
+
+#define HANDLE_CACHE_SUBTREE "otc_hc"
+#define HANDLE_CACHE_KEY_LEN (sizeof(HANDLE_CACHE_SUBTREE) + 4)
+
+static struct handle_cache_entry cache[CONFIG_GATEWAY_HANDLE_CACHE_SIZE];
+static size_t next_evict;
+/* Slots changed since they were last persisted. */
+static ATOMIC_DEFINE(dirty, CONFIG_GATEWAY_HANDLE_CACHE_SIZE);
+static struct k_spinlock lock;
+
+static void save_work_fn(struct k_work *work);
+
+static K_WORK_DEFINE(save_work, save_work_fn);
+
+static void save_work_fn(struct k_work *work)
+{
+	struct handle_cache_entry entry;
+	char key[HANDLE_CACHE_KEY_LEN];
+	k_spinlock_key_t key_lock;
+	int err;
+
+	for (size_t slot = 0; slot < ARRAY_SIZE(cache); slot++) {
+		if (!atomic_test_and_clear_bit(dirty, slot)) {
+			continue;
+		}
+
+		key_lock = k_spin_lock(&lock);
+		entry = cache[slot];
+		k_spin_unlock(&lock, key_lock);
+
+		snprintk(key, sizeof(key), HANDLE_CACHE_SUBTREE "/%u", (unsigned int)slot);
+		err = settings_save_one(key, &entry, sizeof(entry));
+		if (err != 0) {
+			printk("Failed to persist handle cache slot %u (err %d)\n",
+			       (unsigned int)slot, err);
+		}
+	}
+}
+
+static bool slot_is_free(const struct handle_cache_entry *entry)
+{
+	return bt_addr_le_eq(&entry->addr, BT_ADDR_LE_ANY);
+}
+
+static int handle_cache_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	unsigned long slot;
+	ssize_t rc;
+
+	slot = strtoul(name, NULL, 10);
+	if (slot >= ARRAY_SIZE(cache) || len != sizeof(cache[slot])) {
+		/* Left over from a build with a different cache layout. */
+		return 0;
+	}
+
+	rc = read_cb(cb_arg, &cache[slot], sizeof(cache[slot]));
+	if (rc != sizeof(cache[slot])) {
+		(void)memset(&cache[slot], 0, sizeof(cache[slot]));
+		return (rc < 0) ? rc : -EINVAL;
+	}
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(otc_hc, HANDLE_CACHE_SUBTREE, NULL, handle_cache_set, NULL, NULL);
+
+const struct handle_cache_entry *handle_cache_find(const bt_addr_le_t *addr,
+						   const uint8_t *db_hash)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(cache); i++) {
+		if (bt_addr_le_eq(&cache[i].addr, addr) &&
+		    memcmp(cache[i].db_hash, db_hash, HANDLE_CACHE_DB_HASH_LEN) == 0) {
+			return &cache[i];
+		}
+	}
+
+	return NULL;
+}
+
+int handle_cache_store(const struct handle_cache_entry *entry)
+{
+	size_t slot = ARRAY_SIZE(cache);
+	k_spinlock_key_t key;
+
+	for (size_t i = 0; i < ARRAY_SIZE(cache); i++) {
+		if (bt_addr_le_eq(&cache[i].addr, &entry->addr)) {
+			slot = i;
+			break;
+		}
+
+		if (slot == ARRAY_SIZE(cache) && slot_is_free(&cache[i])) {
+			slot = i;
+		}
+	}
+
+	if (slot == ARRAY_SIZE(cache)) {
+		slot = next_evict;
+		next_evict = (next_evict + 1) % ARRAY_SIZE(cache);
+	}
+
+	key = k_spin_lock(&lock);
+	(void)memcpy(&cache[slot], entry, sizeof(cache[slot]));
+	k_spin_unlock(&lock, key);
+
+	atomic_set_bit(dirty, slot);
+	(void)k_work_submit(&save_work);
+
+	return 0;
+}
@@ -17,37 +17,39 @@
 #include <zephyr/bluetooth/uuid.h>
 #include <zephyr/device.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/settings/settings.h>
 #include <zephyr/sys/byteorder.h>
 #include <zephyr/sys/printk.h>
 #include <zephyr/types.h>
 #include <zephyr/kernel.h>
 
+#include "bench.h"
+#include "crc32s.h"
+#include "evtlog.h"
+#include "fetch.h"
+#include "handle_cache.h"
+#include "link_tune.h"
+#include "lzc.h"
+#include "obj_sink.h"
+#include "otc_mux.h"
+#include "resume.h"
+
+/* Size of the demo pattern written to nodes; reads are streamed and unbounded. */
 #define OBJ_MAX_SIZE			      1024
 /* Hardcoded here since definition is in internal header */
 #define BT_GATT_OTS_OLCP_RES_OPERATION_FAILED 0x04
 #define BT_GATT_OTS_OLCP_RES_OUT_OF_BONDS     0x05
 
-static struct bt_ots_client otc;
-static struct bt_ots_client_cb otc_cb;
-static struct bt_gatt_discover_params discover_params;
-static struct bt_gatt_subscribe_params *oacp_sub_params;
-static struct bt_gatt_subscribe_params *olcp_sub_params;
-static unsigned char obj_data_buf[OBJ_MAX_SIZE];
-static uint32_t last_checksum;
-
-static bool first_selected;
-static void on_obj_selected(struct bt_ots_client *ots_inst, struct bt_conn *conn, int err);
-
-static void on_obj_metadata_read(struct bt_ots_client *ots_inst, struct bt_conn *conn, int err,
-				 uint8_t metadata_read);
+/* Back-off while another node runs an OTS client procedure. */
+#define OTS_RETRY_MS 5
 
-static int on_obj_data_read(struct bt_ots_client *ots_inst, struct bt_conn *conn, uint32_t offset,
-			    uint32_t len, uint8_t *data_p, bool is_complete);
-
-static void start_scan(void);
-static struct bt_uuid_16 discover_uuid = BT_UUID_INIT_16(0);
-static struct bt_conn *default_conn;
-static atomic_t discovery_state;
+#if defined(CONFIG_GATEWAY_BENCH)
+#define GATEWAY_CONN_PARAM                                                                         \
+	BT_LE_CONN_PARAM(CONFIG_GATEWAY_BENCH_CONN_INTERVAL, CONFIG_GATEWAY_BENCH_CONN_INTERVAL,  \
+			 0, 400)
+#else
+#define GATEWAY_CONN_PARAM BT_LE_CONN_PARAM_DEFAULT
+#endif
 
 enum OTS_SERVICE_DISCOVERY_STATE_BIT {
 	DISC_OTS_FEATURE,
@@ -58,16 +60,193 @@ enum OTS_SERVICE_DISCOVERY_STATE_BIT {
 	DISC_OTS_PROPERTIES,
 	DISC_OTS_ACTION_CP,
 	DISC_OTS_LIST_CP,
+	DISC_OTS_NUM,
+};
+
+struct otc_checksum_work_info {
+	struct k_work_delayable work;
+	off_t offset;
+	size_t len;
+};
+
+/* Everything the gateway tracks for one connected node. One slot exists per
+ * possible connection so that objects can be pulled from all nodes in parallel.
+ */
+struct otc_conn_ctx {
+	struct bt_conn *conn;
+	struct bt_ots_client otc;
+	/* OTS service range; otc only holds it while running a procedure. */
+	uint16_t svc_start_handle;
+	uint16_t svc_end_handle;
+	struct bt_gatt_discover_params discover_params;
+	struct bt_gatt_read_params hash_read_params;
+	uint8_t db_hash[HANDLE_CACHE_DB_HASH_LEN];
+	bool db_hash_valid;
+	uint16_t disc_requests;
+	uint16_t chrcs_seen;
+	int64_t connected_ms;
+	atomic_t discovery_state;
+	bool first_selected;
+	uint32_t last_checksum;
+	uint32_t rx_bytes;
+	uint32_t obj_rx_len;
+	/* Record offset the object being read starts at, for a continuation. */
+	uint32_t obj_base;
+	bool obj_active;
+	int64_t obj_start_ms;
+#if defined(CONFIG_GATEWAY_OBJ_CRC)
+	/* CRC-32 of the object bytes received so far, as sent by the node. */
+	uint32_t obj_crc;
+#endif
+	struct otc_checksum_work_info checksum_work;
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+	/* Object being read has the LZC type and is decoded on the fly. */
+	bool obj_lzc;
+	struct lzc_dec lzc;
+#endif
 };
 
-static void print_hex_number(const uint8_t *num, size_t len)
+static struct otc_conn_ctx conn_ctxs[CONFIG_BT_MAX_CONN];
+
+/* The write pattern is the same for every node, so one buffer serves them all. */
+static unsigned char obj_tx_buf[OBJ_MAX_SIZE];
+static struct bt_ots_client_cb otc_cb;
+
+/* Connection currently being established; only one LE create may be pending. */
+static struct bt_conn *pending_conn;
+
+/* Aggregate transfer statistics over all nodes of one drain session. */
+static int64_t drain_start_ms;
+static uint32_t drain_rx_bytes;
+
+/* Connection intervals not spent on GATT discovery thanks to the handle cache. */
+static uint32_t cache_intervals_saved;
+
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+static const struct bt_uuid_128 lzc_obj_type = BT_UUID_INIT_128(LZC_OBJ_TYPE_UUID_VAL);
+
+/* Radio time not spent thanks to compression, over all objects. */
+static uint32_t lzc_ms_saved;
+#endif
+
+static void on_obj_selected(struct bt_ots_client *ots_inst, struct bt_conn *conn, int err);
+
+static void on_obj_metadata_read(struct bt_ots_client *ots_inst, struct bt_conn *conn, int err,
+				 uint8_t metadata_read);
+
+static int on_obj_data_read(struct bt_ots_client *ots_inst, struct bt_conn *conn, uint32_t offset,
+			    uint32_t len, uint8_t *data_p, bool is_complete);
+
+static void start_scan(void);
+
+static void obj_end(struct otc_conn_ctx *ctx, struct bt_conn *conn, bool complete);
+
+static struct otc_conn_ctx *ctx_lookup(const struct bt_conn *conn)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(conn_ctxs); i++) {
+		if (conn_ctxs[i].conn != NULL && conn_ctxs[i].conn == conn) {
+			return &conn_ctxs[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct otc_conn_ctx *ctx_alloc(struct bt_conn *conn)
 {
-	printk("0x");
-	for (size_t i = 0; i < len; i++) {
-		printk("%02x ", num[i]);
+	struct otc_conn_ctx *ctx = NULL;
+
+	for (size_t i = 0; i < ARRAY_SIZE(conn_ctxs); i++) {
+		if (conn_ctxs[i].conn == NULL) {
+			ctx = &conn_ctxs[i];
+			break;
+		}
+	}
+
+	if (ctx == NULL) {
+		return NULL;
 	}
 
-	printk("\n");
+	ctx->conn = conn;
+	ctx->svc_start_handle = 0;
+	ctx->svc_end_handle = 0;
+	ctx->first_selected = false;
+	ctx->rx_bytes = 0;
+	ctx->obj_active = false;
+	ctx->db_hash_valid = false;
+	ctx->disc_requests = 0;
+	ctx->connected_ms = k_uptime_get();
+	atomic_clear(&ctx->discovery_state);
+
+	return ctx;
+}
+
+/* Forget the node: handles, current object and features go back to their
+ * state before the first connection, with the handle range parked.
+ */
+static void ctx_otc_reset(struct otc_conn_ctx *ctx)
+{
+	struct bt_ots_client *otc = &ctx->otc;
+
+	otc->start_handle = 0;
+	otc->end_handle = 0;
+	otc->feature_handle = 0;
+	otc->obj_name_handle = 0;
+	otc->obj_type_handle = 0;
+	otc->obj_size_handle = 0;
+	otc->obj_properties_handle = 0;
+	otc->obj_created_handle = 0;
+	otc->obj_modified_handle = 0;
+	otc->obj_id_handle = 0;
+	otc->oacp_handle = 0;
+	otc->olcp_handle = 0;
+	(void)memset(&otc->features, 0, sizeof(otc->features));
+	(void)memset(&otc->cur_object, 0, sizeof(otc->cur_object));
+
+	ctx->svc_start_handle = 0;
+	ctx->svc_end_handle = 0;
+	ctx->first_selected = false;
+	ctx->obj_active = false;
+}
+
+static void ctx_release(struct otc_conn_ctx *ctx)
+{
+	(void)k_work_cancel_delayable(&ctx->checksum_work.work);
+	otc_mux_detach(ctx->conn);
+	ctx_otc_reset(ctx);
+	bt_conn_unref(ctx->conn);
+	ctx->conn = NULL;
+	atomic_clear(&ctx->discovery_state);
+}
+
+static size_t ctx_active_count(void)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(conn_ctxs); i++) {
+		if (conn_ctxs[i].conn != NULL) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+static inline struct otc_conn_ctx *ctx_from_otc(struct bt_ots_client *ots_inst)
+{
+	return CONTAINER_OF(ots_inst, struct otc_conn_ctx, otc);
+}
+
+/* Bytes of the current object handed to the sinks, after decompression. */
+static uint32_t ctx_sink_len(const struct otc_conn_ctx *ctx)
+{
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+	if (ctx->obj_lzc) {
+		return ctx->lzc.pos;
+	}
+#endif
+
+	return ctx->obj_rx_len;
 }
 
 /*
@@ -95,55 +274,48 @@ struct otc_btn_work_info {
 	uint32_t pins;
 } otc_btn_work;
 
-struct otc_checksum_work_info {
-	struct k_work_delayable work;
-	off_t offset;
-	size_t len;
-} otc_checksum_work;
+static bool is_discovery_complete(struct otc_conn_ctx *ctx);
 
-static void otc_btn_work_fn(struct k_work *work)
+static void otc_btn_action(struct otc_conn_ctx *ctx, uint32_t pins)
 {
-	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
-	struct otc_btn_work_info *btn_work = CONTAINER_OF(dwork, struct otc_btn_work_info, work);
+	struct bt_ots_client *otc = &ctx->otc;
 	int err;
 	size_t size_to_write;
 
-	if (btn_work->pins == BIT(button0.pin)) {
-		if (!first_selected) {
-			err = bt_ots_client_select_id(&otc, default_conn, BT_OTS_OBJ_ID_MIN);
-			first_selected = true;
+	if (pins == BIT(button0.pin)) {
+		if (!ctx->first_selected) {
+			err = otc_mux_select_id(ctx->conn, BT_OTS_OBJ_ID_MIN);
+			ctx->first_selected = (err == 0);
 		} else {
 			printk("select next\n");
-			err = bt_ots_client_select_next(&otc, default_conn);
+			err = otc_mux_select_next(ctx->conn);
 		}
 
 		if (err != 0) {
 			printk("Failed to select object (err %d)\n", err);
+			return;
 		}
 
 		printk("Selecting object succeeded\n");
-	} else if (btn_work->pins == BIT(button1.pin)) {
+	} else if (pins == BIT(button1.pin)) {
 		printk("read OTS object meta\n");
-		err = bt_ots_client_read_object_metadata(&otc, default_conn,
-							 BT_OTS_METADATA_REQ_ALL);
+		err = otc_mux_read_metadata(ctx->conn, BT_OTS_METADATA_REQ_ALL);
 		if (err != 0) {
 			printk("Failed to read object metadata (err %d)\n", err);
 		}
 
-	} else if (btn_work->pins == BIT(button2.pin)) {
-		if (BT_OTS_OBJ_GET_PROP_WRITE(otc.cur_object.props)) {
-			size_to_write = MIN(OBJ_MAX_SIZE, otc.cur_object.size.alloc);
-			(void)memset(obj_data_buf, 0, size_to_write);
+	} else if (pins == BIT(button2.pin)) {
+		if (BT_OTS_OBJ_GET_PROP_WRITE(otc->cur_object.props)) {
+			size_to_write = MIN(OBJ_MAX_SIZE, otc->cur_object.size.alloc);
 			printk("Going to write OTS object len %d\n", size_to_write);
 			for (uint32_t idx = 0; idx < size_to_write; idx++) {
-				obj_data_buf[idx] = UINT8_MAX - (idx % UINT8_MAX);
+				obj_tx_buf[idx] = UINT8_MAX - (idx % UINT8_MAX);
 			}
 
-			last_checksum = bt_ots_client_calc_checksum(obj_data_buf, size_to_write);
-			printk("Data sent checksum 0x%08x\n", last_checksum);
-			err = bt_ots_client_write_object_data(&otc, default_conn, obj_data_buf,
-							      size_to_write, 0,
-							      BT_OTS_OACP_WRITE_OP_MODE_NONE);
+			ctx->last_checksum = bt_ots_client_calc_checksum(obj_tx_buf, size_to_write);
+			printk("Data sent checksum 0x%08x\n", ctx->last_checksum);
+			err = otc_mux_write_data(ctx->conn, obj_tx_buf, size_to_write, 0,
+						 BT_OTS_OACP_WRITE_OP_MODE_NONE);
 			if (err != 0) {
 				printk("Failed to write object (err %d)\n", err);
 			}
@@ -151,10 +323,10 @@ static void otc_btn_work_fn(struct k_work *work)
 			printk("This OBJ does not support WRITE OP\n");
 		}
 
-	} else if (btn_work->pins == BIT(button3.pin)) {
-		if (BT_OTS_OBJ_GET_PROP_READ(otc.cur_object.props)) {
+	} else if (pins == BIT(button3.pin)) {
+		if (BT_OTS_OBJ_GET_PROP_READ(otc->cur_object.props)) {
 			printk("read OTS object\n");
-			err = bt_ots_client_read_object_data(&otc, default_conn);
+			err = otc_mux_read_data(ctx->conn);
 			if (err != 0) {
 				printk("Failed to read object %d\n", err);
 			}
@@ -164,17 +336,41 @@ static void otc_btn_work_fn(struct k_work *work)
 	}
 }
 
+static void otc_btn_work_fn(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct otc_btn_work_info *btn_work = CONTAINER_OF(dwork, struct otc_btn_work_info, work);
+
+	/* Buttons drive the first node that is ready. */
+	for (size_t i = 0; i < ARRAY_SIZE(conn_ctxs); i++) {
+		struct otc_conn_ctx *ctx = &conn_ctxs[i];
+
+		if (ctx->conn != NULL && is_discovery_complete(ctx)) {
+			otc_btn_action(ctx, btn_work->pins);
+			return;
+		}
+	}
+
+	printk("No node ready\n");
+}
+
 static void otc_checksum_work_fn(struct k_work *work)
 {
 	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
 	struct otc_checksum_work_info *checksum_work =
 		CONTAINER_OF(dwork, struct otc_checksum_work_info, work);
+	struct otc_conn_ctx *ctx = CONTAINER_OF(checksum_work, struct otc_conn_ctx, checksum_work);
 	int err;
 
-	err = bt_ots_client_get_object_checksum(&otc, default_conn, checksum_work->offset,
-						checksum_work->len);
-	if (err != 0) {
-		printk("bt_ots_client_get_object_checksum failed (%d)\n", err);
+	if (ctx->conn == NULL) {
+		return;
+	}
+
+	err = otc_mux_get_checksum(ctx->conn, checksum_work->offset, checksum_work->len);
+	if (err == -EBUSY) {
+		(void)k_work_reschedule(&checksum_work->work, K_MSEC(OTS_RETRY_MS));
+	} else if (err != 0) {
+		printk("Checksum request failed (err %d)\n", err);
 	}
 }
 
@@ -238,6 +434,7 @@ static bool eir_found(struct bt_data *data, void *user_data)
 		for (i = 0; i < data->data_len; i += sizeof(uint16_t)) {
 			struct bt_le_conn_param *param;
 			const struct bt_uuid *uuid;
+			struct bt_conn *conn;
 			uint16_t u16;
 			int err;
 
@@ -247,14 +444,25 @@ static bool eir_found(struct bt_data *data, void *user_data)
 				continue;
 			}
 
+			/* Skip nodes that are already being drained. */
+			conn = bt_conn_lookup_addr_le(BT_ID_DEFAULT, addr);
+			if (conn != NULL) {
+				bt_conn_unref(conn);
+				return false;
+			}
+
+			if (pending_conn != NULL || ctx_active_count() >= ARRAY_SIZE(conn_ctxs)) {
+				return false;
+			}
+
 			err = bt_le_scan_stop();
 			if (err != 0) {
 				printk("Stop LE scan failed (err %d)\n", err);
 				continue;
 			}
 
-			param = BT_LE_CONN_PARAM_DEFAULT;
-			err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, param, &default_conn);
+			param = GATEWAY_CONN_PARAM;
+			err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN, param, &pending_conn);
 			if (err != 0) {
 				printk("Create conn failed (err %d)\n", err);
 				start_scan();
@@ -286,6 +494,11 @@ static void start_scan(void)
 {
 	int err;
 
+	if (pending_conn != NULL || ctx_active_count() >= ARRAY_SIZE(conn_ctxs)) {
+		/* Scanning resumes once the pending connection completes or a slot frees up. */
+		return;
+	}
+
 	/* Use active scanning and disable duplicate filtering to handle any
 	 * devices that might update their advertising data at runtime.
 	 */
@@ -297,7 +510,9 @@ static void start_scan(void)
 	};
 
 	err = bt_le_scan_start(&scan_param, device_found);
-	if (err != 0) {
+	if (err == -EALREADY) {
+		return;
+	} else if (err != 0) {
 		printk("Scanning OTS TAG failed to start (err %d)\n", err);
 		return;
 	}
@@ -305,20 +520,69 @@ static void start_scan(void)
 	printk("Scanning successfully started\n");
 }
 
-static int subscribe_func(void)
+/* Runs once the node is subscribed, in parallel with every other node. */
+static void ots_session_start(struct otc_conn_ctx *ctx)
 {
+	int err;
+
+	otc_mux_attach(&ctx->otc, ctx->conn, ctx->svc_start_handle, ctx->svc_end_handle);
+
+	/* Read feature of OTS server*/
+	err = otc_mux_read_feature(ctx->conn);
+	if (err != 0) {
+		printk("Read feature failed (err %d)\n", err);
+	}
+
+	if (IS_ENABLED(CONFIG_GATEWAY_BENCH)) {
+		bench_start(&ctx->otc, ctx->conn);
+	} else if (IS_ENABLED(CONFIG_GATEWAY_FETCH)) {
+		fetch_start(&ctx->otc, ctx->conn);
+	}
+}
+
+static void on_olcp_subscribed(struct bt_conn *conn, uint8_t err,
+			       struct bt_gatt_subscribe_params *params)
+{
+	struct bt_ots_client *otc = CONTAINER_OF(params, struct bt_ots_client, olcp_sub_params);
+	struct otc_conn_ctx *ctx = ctx_from_otc(otc);
+
+	if (err != 0) {
+		printk("Subscribe OLCP rejected (err 0x%02x)\n", err);
+		return;
+	}
+
+	EVTLOG("Connect-to-subscribed latency %u ms\n",
+	       (uint32_t)(k_uptime_get() - ctx->connected_ms));
+
+	ots_session_start(ctx);
+}
+
+static uint8_t on_oacp_indicate(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+				const void *data, uint16_t length)
+{
+	if (IS_ENABLED(CONFIG_GATEWAY_FETCH) && data != NULL) {
+		fetch_oacp_indicated(conn, data, length);
+	}
+
+	return otc_mux_indicate(conn, params, data, length);
+}
+
+static int subscribe_func(struct otc_conn_ctx *ctx)
+{
+	struct bt_gatt_subscribe_params *oacp_sub_params;
+	struct bt_gatt_subscribe_params *olcp_sub_params;
 	int ret;
 
 	printk("Subscribe OACP and OLCP Indication\n");
-	oacp_sub_params = &otc.oacp_sub_params;
-	oacp_sub_params->disc_params = &otc.oacp_sub_disc_params;
+	oacp_sub_params = &ctx->otc.oacp_sub_params;
+	oacp_sub_params->disc_params = &ctx->otc.oacp_sub_disc_params;
 	if (oacp_sub_params) {
 		oacp_sub_params->ccc_handle = BT_GATT_AUTO_DISCOVER_CCC_HANDLE;
-		oacp_sub_params->end_handle = otc.end_handle;
+		oacp_sub_params->end_handle = ctx->svc_end_handle;
 		oacp_sub_params->value = BT_GATT_CCC_INDICATE;
-		oacp_sub_params->value_handle = otc.oacp_handle;
-		oacp_sub_params->notify = bt_ots_client_indicate_handler;
-		ret = bt_gatt_subscribe(default_conn, oacp_sub_params);
+		oacp_sub_params->value_handle = ctx->otc.oacp_handle;
+		oacp_sub_params->notify = on_oacp_indicate;
+		ret = bt_gatt_subscribe(ctx->conn, oacp_sub_params);
 
 		if (ret != 0) {
 			printk("Subscribe OACP failed %d\n", ret);
@@ -326,15 +590,16 @@ static int subscribe_func(void)
 		}
 	}
 
-	olcp_sub_params = &otc.olcp_sub_params;
-	olcp_sub_params->disc_params = &otc.olcp_sub_disc_params;
+	olcp_sub_params = &ctx->otc.olcp_sub_params;
+	olcp_sub_params->disc_params = &ctx->otc.olcp_sub_disc_params;
 	if (olcp_sub_params) {
 		olcp_sub_params->ccc_handle = BT_GATT_AUTO_DISCOVER_CCC_HANDLE;
-		olcp_sub_params->end_handle = otc.end_handle;
+		olcp_sub_params->end_handle = ctx->svc_end_handle;
 		olcp_sub_params->value = BT_GATT_CCC_INDICATE;
-		olcp_sub_params->value_handle = otc.olcp_handle;
-		olcp_sub_params->notify = bt_ots_client_indicate_handler;
-		ret = bt_gatt_subscribe(default_conn, olcp_sub_params);
+		olcp_sub_params->value_handle = ctx->otc.olcp_handle;
+		olcp_sub_params->notify = otc_mux_indicate;
+		olcp_sub_params->subscribe = on_olcp_subscribed;
+		ret = bt_gatt_subscribe(ctx->conn, olcp_sub_params);
 
 		if (ret != 0) {
 			printk("Subscribe OLCP failed %d\n", ret);
@@ -345,196 +610,286 @@ static int subscribe_func(void)
 	return ret;
 }
 
-static bool is_discovery_complete(void)
+static bool is_discovery_complete(struct otc_conn_ctx *ctx)
+{
+	return (atomic_test_bit(&ctx->discovery_state, DISC_OTS_FEATURE) &&
+		atomic_test_bit(&ctx->discovery_state, DISC_OTS_NAME) &&
+		atomic_test_bit(&ctx->discovery_state, DISC_OTS_TYPE) &&
+		atomic_test_bit(&ctx->discovery_state, DISC_OTS_SIZE) &&
+		atomic_test_bit(&ctx->discovery_state, DISC_OTS_ID) &&
+		atomic_test_bit(&ctx->discovery_state, DISC_OTS_PROPERTIES) &&
+		atomic_test_bit(&ctx->discovery_state, DISC_OTS_ACTION_CP) &&
+		atomic_test_bit(&ctx->discovery_state, DISC_OTS_LIST_CP));
+}
+
+static void ctx_cache_save(struct otc_conn_ctx *ctx)
+{
+	struct handle_cache_entry entry = {
+		.start_handle = ctx->svc_start_handle,
+		.end_handle = ctx->svc_end_handle,
+		.feature_handle = ctx->otc.feature_handle,
+		.obj_name_handle = ctx->otc.obj_name_handle,
+		.obj_type_handle = ctx->otc.obj_type_handle,
+		.obj_size_handle = ctx->otc.obj_size_handle,
+		.obj_id_handle = ctx->otc.obj_id_handle,
+		.obj_properties_handle = ctx->otc.obj_properties_handle,
+		.oacp_handle = ctx->otc.oacp_handle,
+		.olcp_handle = ctx->otc.olcp_handle,
+		.disc_requests = ctx->disc_requests,
+	};
+
+	if (!ctx->db_hash_valid) {
+		/* Without a database hash there is no way to tell a stale entry later. */
+		return;
+	}
+
+	bt_addr_le_copy(&entry.addr, bt_conn_get_dst(ctx->conn));
+	(void)memcpy(entry.db_hash, ctx->db_hash, sizeof(entry.db_hash));
+	(void)handle_cache_store(&entry);
+}
+
+static void ctx_cache_apply(struct otc_conn_ctx *ctx, const struct handle_cache_entry *entry)
+{
+	struct bt_conn_info info;
+	uint32_t saved;
+
+	ctx->svc_start_handle = entry->start_handle;
+	ctx->svc_end_handle = entry->end_handle;
+	ctx->otc.feature_handle = entry->feature_handle;
+	ctx->otc.obj_name_handle = entry->obj_name_handle;
+	ctx->otc.obj_type_handle = entry->obj_type_handle;
+	ctx->otc.obj_size_handle = entry->obj_size_handle;
+	ctx->otc.obj_id_handle = entry->obj_id_handle;
+	ctx->otc.obj_properties_handle = entry->obj_properties_handle;
+	ctx->otc.oacp_handle = entry->oacp_handle;
+	ctx->otc.olcp_handle = entry->olcp_handle;
+	atomic_set(&ctx->discovery_state, BIT_MASK(DISC_OTS_NUM));
+
+	/* Each skipped ATT request is at least one connection interval; the hash
+	 * read that validated the cache costs one of them back.
+	 */
+	saved = (entry->disc_requests > 1U) ? (entry->disc_requests - 1U) : 0U;
+	cache_intervals_saved += saved;
+
+	if (bt_conn_get_info(ctx->conn, &info) == 0) {
+		printk("Handle cache hit: skipped %u ATT requests (~%u ms), %u intervals saved total\n",
+		       saved, (saved * BT_CONN_INTERVAL_TO_US(info.le.interval)) / USEC_PER_MSEC,
+		       cache_intervals_saved);
+	}
+}
+
+static void on_discovery_complete(struct otc_conn_ctx *ctx)
+{
+	/* OTS procedures start once both control points are subscribed. */
+	(void)subscribe_func(ctx);
+}
+
+/* Where each OTS characteristic found by the discovery sweep is recorded. */
+static const struct {
+	const struct bt_uuid *uuid;
+	enum OTS_SERVICE_DISCOVERY_STATE_BIT bit;
+	size_t handle_offset;
+} ots_chrcs[] = {
+	{BT_UUID_OTS_FEATURE, DISC_OTS_FEATURE, offsetof(struct bt_ots_client, feature_handle)},
+	{BT_UUID_OTS_NAME, DISC_OTS_NAME, offsetof(struct bt_ots_client, obj_name_handle)},
+	{BT_UUID_OTS_TYPE, DISC_OTS_TYPE, offsetof(struct bt_ots_client, obj_type_handle)},
+	{BT_UUID_OTS_SIZE, DISC_OTS_SIZE, offsetof(struct bt_ots_client, obj_size_handle)},
+	{BT_UUID_OTS_ID, DISC_OTS_ID, offsetof(struct bt_ots_client, obj_id_handle)},
+	{BT_UUID_OTS_PROPERTIES, DISC_OTS_PROPERTIES,
+	 offsetof(struct bt_ots_client, obj_properties_handle)},
+	{BT_UUID_OTS_ACTION_CP, DISC_OTS_ACTION_CP, offsetof(struct bt_ots_client, oacp_handle)},
+	{BT_UUID_OTS_LIST_CP, DISC_OTS_LIST_CP, offsetof(struct bt_ots_client, olcp_handle)},
+};
+
+static uint8_t discover_service(struct bt_conn *conn, struct otc_conn_ctx *ctx,
+				const struct bt_gatt_attr *attr,
+				struct bt_gatt_discover_params *params)
 {
-	return (atomic_test_bit(&discovery_state, DISC_OTS_FEATURE) &&
-		atomic_test_bit(&discovery_state, DISC_OTS_NAME) &&
-		atomic_test_bit(&discovery_state, DISC_OTS_TYPE) &&
-		atomic_test_bit(&discovery_state, DISC_OTS_SIZE) &&
-		atomic_test_bit(&discovery_state, DISC_OTS_ID) &&
-		atomic_test_bit(&discovery_state, DISC_OTS_PROPERTIES) &&
-		atomic_test_bit(&discovery_state, DISC_OTS_ACTION_CP) &&
-		atomic_test_bit(&discovery_state, DISC_OTS_LIST_CP));
+	const struct bt_gatt_service_val *svc = attr->user_data;
+	int err;
+
+	ctx->svc_start_handle = attr->handle;
+	ctx->svc_end_handle = svc->end_handle;
+
+	/* Sweep all characteristics of the service in one procedure; the server
+	 * packs as many declarations as fit the MTU into each response.
+	 */
+	params->uuid = NULL;
+	params->start_handle = attr->handle + 1;
+	params->end_handle = svc->end_handle;
+	params->type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(conn, params);
+	if (err != 0) {
+		printk("Discover failed (err %d)\n", err);
+	}
+
+	return BT_GATT_ITER_STOP;
 }
 
 static uint8_t discover_func(struct bt_conn *conn, const struct bt_gatt_attr *attr,
 			     struct bt_gatt_discover_params *params)
 {
-	int err;
+	struct otc_conn_ctx *ctx = CONTAINER_OF(params, struct otc_conn_ctx, discover_params);
+	const struct bt_gatt_chrc *chrc;
+	size_t per_rsp;
 
 	if (!attr) {
-		printk("Discover complete\n");
+		printk("Discover complete, OTS characteristics missing (0x%02lx)\n",
+		       atomic_get(&ctx->discovery_state));
 		(void)memset(params, 0, sizeof(*params));
 		return BT_GATT_ITER_STOP;
 	}
 
-	if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS) == 0) {
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_FEATURE, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
-		err = bt_gatt_discover(conn, &discover_params);
-
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
-		}
-
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_FEATURE) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_FEATURE);
-		otc.feature_handle = bt_gatt_attr_value_handle(attr);
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_NAME, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+	if (params->type == BT_GATT_DISCOVER_PRIMARY) {
+		return discover_service(conn, ctx, attr, params);
+	}
 
-		err = bt_gatt_discover(conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
+	ctx->chrcs_seen++;
+	chrc = attr->user_data;
+	for (size_t i = 0; i < ARRAY_SIZE(ots_chrcs); i++) {
+		if (bt_uuid_cmp(chrc->uuid, ots_chrcs[i].uuid) == 0) {
+			*(uint16_t *)((uint8_t *)&ctx->otc + ots_chrcs[i].handle_offset) =
+				chrc->value_handle;
+			atomic_set_bit(&ctx->discovery_state, ots_chrcs[i].bit);
+			break;
 		}
+	}
 
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_NAME) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_NAME);
-		otc.obj_name_handle = bt_gatt_attr_value_handle(attr);
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_TYPE, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+	if (!is_discovery_complete(ctx)) {
+		return BT_GATT_ITER_CONTINUE;
+	}
 
-		err = bt_gatt_discover(conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
-		}
+	/* One Find By Type Value for the service plus the Read By Type requests
+	 * needed for the declarations seen so far (7 bytes each with 16-bit UUIDs).
+	 */
+	per_rsp = MAX((bt_gatt_get_mtu(conn) - 2U) / 7U, 1U);
+	ctx->disc_requests = 1U + DIV_ROUND_UP(ctx->chrcs_seen, per_rsp);
 
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_TYPE) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_TYPE);
-		otc.obj_type_handle = bt_gatt_attr_value_handle(attr);
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_SIZE, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+	printk("Discovery complete for OTS Client (%u ATT requests)\n", ctx->disc_requests);
+	ctx_cache_save(ctx);
+	on_discovery_complete(ctx);
 
-		err = bt_gatt_discover(conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
-		}
+	/* Stopping here spares the trailing request that would only return
+	 * Attribute Not Found.
+	 */
+	return BT_GATT_ITER_STOP;
+}
 
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_SIZE) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_SIZE);
-		otc.obj_size_handle = bt_gatt_attr_value_handle(attr);
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_ID, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+static void start_discovery(struct otc_conn_ctx *ctx)
+{
+	int err;
 
-		err = bt_gatt_discover(conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
-		}
+	ctx->discover_params.uuid = BT_UUID_OTS;
+	ctx->discover_params.func = discover_func;
+	ctx->discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	ctx->discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	ctx->discover_params.type = BT_GATT_DISCOVER_PRIMARY;
 
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_ID) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_ID);
-		otc.obj_id_handle = bt_gatt_attr_value_handle(attr);
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_PROPERTIES, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+	ctx->chrcs_seen = 0;
+	err = bt_gatt_discover(ctx->conn, &ctx->discover_params);
+	if (err != 0) {
+		printk("Discover failed(err %d)\n", err);
+	}
+}
 
-		err = bt_gatt_discover(conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
-		}
+static uint8_t db_hash_read_func(struct bt_conn *conn, uint8_t err,
+				 struct bt_gatt_read_params *params, const void *data,
+				 uint16_t length)
+{
+	struct otc_conn_ctx *ctx = CONTAINER_OF(params, struct otc_conn_ctx, hash_read_params);
+	const struct handle_cache_entry *entry;
 
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_PROPERTIES) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_PROPERTIES);
-		otc.obj_properties_handle = bt_gatt_attr_value_handle(attr);
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_ACTION_CP, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+	if (err == 0 && data != NULL && length == sizeof(ctx->db_hash)) {
+		(void)memcpy(ctx->db_hash, data, sizeof(ctx->db_hash));
+		ctx->db_hash_valid = true;
+	} else {
+		printk("Database hash unavailable (err 0x%02x), discovering\n", err);
+	}
 
-		err = bt_gatt_discover(conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
-		}
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_ACTION_CP) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_ACTION_CP);
-		otc.oacp_handle = bt_gatt_attr_value_handle(attr);
-		(void)memcpy(&discover_uuid, BT_UUID_OTS_LIST_CP, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.start_handle = attr->handle + 1;
-		discover_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
-
-		err = bt_gatt_discover(conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed (err %d)\n", err);
-		}
-	} else if (bt_uuid_cmp(discover_params.uuid, BT_UUID_OTS_LIST_CP) == 0) {
-		atomic_set_bit(&discovery_state, DISC_OTS_LIST_CP);
-		otc.olcp_handle = bt_gatt_attr_value_handle(attr);
+	entry = ctx->db_hash_valid ? handle_cache_find(bt_conn_get_dst(conn), ctx->db_hash) : NULL;
+	if (entry != NULL) {
+		ctx_cache_apply(ctx, entry);
+		on_discovery_complete(ctx);
 	} else {
-		return BT_GATT_ITER_STOP;
+		start_discovery(ctx);
 	}
 
-	if (is_discovery_complete()) {
-		printk("Discovery complete for OTS Client\n");
-		err = subscribe_func();
+	return BT_GATT_ITER_STOP;
+}
 
-		if (err != 0) {
-			return BT_GATT_ITER_STOP;
-		}
+static void read_db_hash(struct otc_conn_ctx *ctx)
+{
+	int err;
 
-		/* Read feature of OTS server*/
-		err = bt_ots_client_read_feature(&otc, default_conn);
-		if (err != 0) {
-			printk("bt_ots_client_read_feature failed (err %d)", err);
-		}
-	}
+	ctx->hash_read_params.func = db_hash_read_func;
+	ctx->hash_read_params.handle_count = 0;
+	ctx->hash_read_params.by_uuid.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	ctx->hash_read_params.by_uuid.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	ctx->hash_read_params.by_uuid.uuid = BT_UUID_GATT_DB_HASH;
 
-	return BT_GATT_ITER_STOP;
+	err = bt_gatt_read(ctx->conn, &ctx->hash_read_params);
+	if (err != 0) {
+		printk("Database hash read failed (err %d)\n", err);
+		start_discovery(ctx);
+	}
 }
 
 static void connected(struct bt_conn *conn, uint8_t err)
 {
 	char addr[BT_ADDR_LE_STR_LEN];
+	struct otc_conn_ctx *ctx;
 
 	bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-	first_selected = false;
+
+	if (conn != pending_conn) {
+		return;
+	}
+
 	if (err != 0) {
 		printk("Failed to connect to %s %u %s\n", addr, err, bt_hci_err_to_str(err));
 
-		bt_conn_unref(default_conn);
-		default_conn = NULL;
+		bt_conn_unref(pending_conn);
+		pending_conn = NULL;
 		start_scan();
 		return;
 	}
 
-	if (conn != default_conn) {
-		return;
+	if (ctx_active_count() == 0) {
+		drain_start_ms = k_uptime_get();
+		drain_rx_bytes = 0;
 	}
 
-	printk("Connected: %s\n", addr);
+	/* The context takes over the reference held by pending_conn. */
+	ctx = ctx_alloc(conn);
+	pending_conn = NULL;
+	if (ctx == NULL) {
+		printk("No free connection context for %s\n", addr);
+		(void)bt_conn_disconnect(conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+		bt_conn_unref(conn);
+		return;
+	}
 
-	if (conn == default_conn) {
-		(void)memcpy(&discover_uuid, BT_UUID_OTS, sizeof(discover_uuid));
-		discover_params.uuid = &discover_uuid.uuid;
-		discover_params.func = discover_func;
-		discover_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
-		discover_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
-		discover_params.type = BT_GATT_DISCOVER_PRIMARY;
+	printk("Connected: %s (%zu/%u)\n", addr, ctx_active_count(), CONFIG_BT_MAX_CONN);
 
-		err = bt_gatt_discover(default_conn, &discover_params);
-		if (err != 0) {
-			printk("Discover failed(err %d)\n", err);
-			return;
-		}
+	if (IS_ENABLED(CONFIG_LINK_TUNE)) {
+		link_tune_start(conn);
 	}
+
+	/* A known node with an unchanged database skips discovery entirely. */
+	read_db_hash(ctx);
+
+	/* Keep looking for more nodes while this one is being drained. */
+	start_scan();
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	char addr[BT_ADDR_LE_STR_LEN];
+	struct otc_conn_ctx *ctx = ctx_lookup(conn);
+	int64_t elapsed_ms;
 
-	if (conn != default_conn) {
+	if (ctx == NULL) {
 		return;
 	}
 
@@ -542,9 +897,25 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 
 	printk("Disconnected: %s, reason 0x%02x %s\n", addr, reason, bt_hci_err_to_str(reason));
 
-	bt_conn_unref(default_conn);
-	default_conn = NULL;
-	discovery_state = ATOMIC_INIT(0);
+	if (ctx->obj_active) {
+		obj_end(ctx, conn, false);
+	}
+
+	if (IS_ENABLED(CONFIG_GATEWAY_BENCH)) {
+		bench_stop(conn);
+	} else if (IS_ENABLED(CONFIG_GATEWAY_FETCH)) {
+		fetch_stop(conn);
+	}
+
+	ctx_release(ctx);
+
+	if (ctx_active_count() == 0) {
+		elapsed_ms = k_uptime_get() - drain_start_ms;
+		printk("All nodes drained: %u bytes in %lld ms (%u B/s)\n", drain_rx_bytes,
+		       elapsed_ms,
+		       (elapsed_ms > 0) ? (uint32_t)((drain_rx_bytes * 1000ULL) / elapsed_ms) : 0U);
+	}
+
 	start_scan();
 }
 
@@ -555,66 +926,277 @@ BT_CONN_CB_DEFINE(conn_callbacks) = {
 
 static void on_obj_selected(struct bt_ots_client *ots_inst, struct bt_conn *conn, int err)
 {
-	printk("Current object selected cb OLCP result (%d)\n", err);
+	struct otc_conn_ctx *ctx = ctx_from_otc(ots_inst);
+
+	otc_mux_done(conn);
+	EVTLOG("Current object selected cb OLCP result (%d)\n", err);
+
+	if (IS_ENABLED(CONFIG_GATEWAY_BENCH) && bench_obj_selected(conn, err)) {
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_GATEWAY_FETCH) && fetch_obj_selected(conn, err)) {
+		return;
+	}
 
 	if (err == BT_GATT_OTS_OLCP_RES_OPERATION_FAILED) {
-		printk("BT_GATT_OTS_OLCP_RES_OPERATION_FAILED %d\n", err);
-		first_selected = false;
+		EVTLOG("BT_GATT_OTS_OLCP_RES_OPERATION_FAILED %d\n", err);
+		ctx->first_selected = false;
 	} else if (err == BT_GATT_OTS_OLCP_RES_OUT_OF_BONDS) {
-		printk("BT_GATT_OTS_OLCP_RES_OUT_OF_BONDS %d. Select first valid instead\n", err);
-		(void)bt_ots_client_select_id(&otc, default_conn, BT_OTS_OBJ_ID_MIN);
+		EVTLOG("BT_GATT_OTS_OLCP_RES_OUT_OF_BONDS %d. Select first valid instead\n", err);
+		(void)otc_mux_select_id(conn, BT_OTS_OBJ_ID_MIN);
+	}
+}
+
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+static int lzc_out(void *user_data, const uint8_t *data, size_t len, uint32_t offset)
+{
+	return obj_sink_write(user_data, offset, data, len);
+}
+
+/* The object took elapsed_ms for rx_len bytes on air; sending raw_len bytes
+ * at the same rate is what compression saved.
+ */
+static void lzc_report(struct otc_conn_ctx *ctx, uint32_t rx_len, uint32_t raw_len)
+{
+	uint32_t elapsed_ms = (uint32_t)(k_uptime_get() - ctx->obj_start_ms);
+	uint32_t saved_ms = 0;
+
+	if (rx_len > 0 && raw_len > rx_len) {
+		saved_ms = (uint32_t)(((uint64_t)elapsed_ms * (raw_len - rx_len)) / rx_len);
+	}
+
+	lzc_ms_saved += saved_ms;
+
+	EVTLOG("Decompressed %u to %u bytes, %u%% of raw\n", rx_len, raw_len,
+	       (raw_len > 0) ? (rx_len * 100U) / raw_len : 100U);
+	EVTLOG("Radio time saved: ~%u ms for this object, %u ms total\n", saved_ms,
+	       lzc_ms_saved);
+}
+#endif /* CONFIG_GATEWAY_OBJ_DECOMPRESS */
+
+/* Check a completely read object against the CRC tag in its name.
+ * Returns -ENOENT if the node did not tag it.
+ */
+static int obj_verify(struct otc_conn_ctx *ctx)
+{
+#if defined(CONFIG_GATEWAY_OBJ_CRC)
+	uint32_t expected;
+
+	if (crc32s_name_get(ctx->otc.cur_object.name_c, &expected) != 0) {
+		return -ENOENT;
+	}
+
+	if (ctx->obj_crc != expected) {
+		EVTLOG("Object CRC 0x%08x, expected 0x%08x\n", ctx->obj_crc, expected);
+		return -EBADMSG;
+	}
+
+	EVTLOG("Object CRC 0x%08x match\n", ctx->obj_crc);
+
+	return 0;
+#else
+	return -ENOENT;
+#endif
+}
+
+/* Hand one chunk at its record offset to the CRC, the decoder and the sinks. */
+static int obj_chunk(struct otc_conn_ctx *ctx, struct bt_conn *conn, uint32_t offset,
+		     const uint8_t *data, uint32_t len)
+{
+	ctx->obj_rx_len = offset + len;
+
+#if defined(CONFIG_GATEWAY_OBJ_CRC)
+	ctx->obj_crc = crc32s_update(ctx->obj_crc, data, len);
+#endif
+
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+	if (ctx->obj_lzc) {
+		/* Sinks see the decompressed stream, a window at a time. */
+		return lzc_dec_feed(&ctx->lzc, data, len, lzc_out, conn);
 	}
+#endif
 
-	(void)memset(obj_data_buf, 0, OBJ_MAX_SIZE);
+	/* Chunks go to the sinks straight from the L2CAP buffer. */
+	return obj_sink_write(conn, offset, data, len);
+}
+
+static void obj_end(struct otc_conn_ctx *ctx, struct bt_conn *conn, bool complete)
+{
+	obj_sink_end(conn, ctx_sink_len(ctx), complete);
+	ctx->obj_active = false;
+
+#if defined(CONFIG_GATEWAY_RESUME)
+	resume_end(conn, ctx->obj_rx_len, complete);
+#endif
+}
+
+static int obj_begin(struct otc_conn_ctx *ctx, struct bt_conn *conn)
+{
+	struct bt_ots_client *ots_inst = &ctx->otc;
+#if defined(CONFIG_GATEWAY_RESUME)
+	const uint8_t *prefix;
+	uint32_t prefix_len;
+#endif
+	int err = 0;
+
+	ctx->obj_active = true;
+	ctx->obj_start_ms = k_uptime_get();
+	ctx->obj_base = 0;
+	ctx->obj_rx_len = 0;
+#if defined(CONFIG_GATEWAY_OBJ_CRC)
+	ctx->obj_crc = 0;
+#endif
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+	ctx->obj_lzc = (bt_uuid_cmp(&ots_inst->cur_object.type.uuid, &lzc_obj_type.uuid) == 0);
+	if (ctx->obj_lzc) {
+		lzc_dec_init(&ctx->lzc);
+	}
+#endif
+	obj_sink_begin(conn, &ots_inst->cur_object);
+
+#if defined(CONFIG_GATEWAY_RESUME)
+	err = resume_begin(conn, ots_inst->cur_object.name_c, &prefix, &prefix_len);
+	if (err == -ENOENT) {
+		EVTLOG("Continuation of a record not kept, skipped\n");
+	} else if (prefix_len > 0) {
+		/* Replay the part kept from the read that was cut short. */
+		EVTLOG("Resuming object at offset %u\n", prefix_len);
+		ctx->obj_base = prefix_len;
+		err = obj_chunk(ctx, conn, 0, prefix, prefix_len);
+	}
+#endif
+
+	return err;
 }
 
 static int on_obj_data_read(struct bt_ots_client *ots_inst, struct bt_conn *conn, uint32_t offset,
 			    uint32_t len, uint8_t *data_p, bool is_complete)
 {
-	printk("Received OTS Object content, %i bytes at offset %i\n", len, offset);
+	struct otc_conn_ctx *ctx = ctx_from_otc(ots_inst);
+	uint32_t sink_len;
+	int64_t elapsed_ms;
+	int verified = -ENOENT;
+	int err = 0;
+
+	if (IS_ENABLED(CONFIG_GATEWAY_FETCH) &&
+	    fetch_dirlist_read(conn, data_p, len, is_complete)) {
+		return is_complete ? BT_OTS_STOP : BT_OTS_CONTINUE;
+	}
 
-	print_hex_number(data_p, len);
+	if (!ctx->obj_active) {
+		err = obj_begin(ctx, conn);
+	}
 
-	if ((offset + len) > OBJ_MAX_SIZE) {
-		printk("Can not fit whole object, drop the rest of data\n");
-	} else {
-		(void)memcpy((obj_data_buf + offset), data_p, MIN((OBJ_MAX_SIZE - offset), len));
+	ctx->rx_bytes += len;
+	drain_rx_bytes += len;
+	offset += ctx->obj_base;
+
+	if (err == 0) {
+#if defined(CONFIG_GATEWAY_RESUME)
+		resume_capture(conn, offset, data_p, len);
+#endif
+		err = obj_chunk(ctx, conn, offset, data_p, len);
+	}
+
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+	if (err == 0 && is_complete && ctx->obj_lzc && !lzc_dec_done(&ctx->lzc)) {
+		err = -EBADMSG;
+	}
+#endif
+
+	if (err == 0 && is_complete) {
+		verified = obj_verify(ctx);
+		if (verified == -EBADMSG) {
+			/* Sinks treat it as cut short; the node keeps it. */
+			err = verified;
+		}
+	}
+
+	if (err < 0) {
+		if (verified != -EBADMSG) {
+			EVTLOG("Object sink rejected data at offset %u (err %d)\n", offset, err);
+		}
+
+		obj_end(ctx, conn, false);
+		return BT_OTS_STOP;
 	}
 
 	if (is_complete) {
-		printk("Object total received %d\n", len + offset);
-		print_hex_number(obj_data_buf, len + offset);
-		(void)memset(obj_data_buf, 0, OBJ_MAX_SIZE);
-		otc_checksum_work.offset = 0;
-		otc_checksum_work.len = otc.cur_object.size.cur;
-		k_work_schedule(&otc_checksum_work.work, K_NO_WAIT);
+		sink_len = ctx_sink_len(ctx);
+		obj_end(ctx, conn, true);
+
+#if defined(CONFIG_GATEWAY_OBJ_DECOMPRESS)
+		if (ctx->obj_lzc) {
+			lzc_report(ctx, ctx->obj_rx_len, sink_len);
+		}
+#endif
+
+		elapsed_ms = k_uptime_get() - drain_start_ms;
+		EVTLOG("Aggregate: %u bytes from %u node(s) in %u ms\n", drain_rx_bytes,
+		       ctx_active_count(), (uint32_t)elapsed_ms);
+
+		/* Untagged objects cost a checksum round trip; automated reads skip it.
+		 * The node checksums a continuation only, not the whole record.
+		 */
+		if (verified != 0 && ctx->obj_base == 0 && !IS_ENABLED(CONFIG_GATEWAY_BENCH) &&
+		    !IS_ENABLED(CONFIG_GATEWAY_FETCH)) {
+			ctx->checksum_work.offset = 0;
+			ctx->checksum_work.len = ots_inst->cur_object.size.cur;
+			k_work_schedule(&ctx->checksum_work.work, K_NO_WAIT);
+		}
+
 		return BT_OTS_STOP;
 	}
 
 	return BT_OTS_CONTINUE;
 }
 
+static void on_obj_read_failed(struct bt_conn *conn, int err)
+{
+	struct otc_conn_ctx *ctx = ctx_lookup(conn);
+
+	EVTLOG("Object read failed (err %d)\n", err);
+
+	if (ctx == NULL) {
+		return;
+	}
+
+	if (IS_ENABLED(CONFIG_GATEWAY_FETCH) && fetch_dirlist_read(conn, NULL, 0, true)) {
+		return;
+	}
+
+	/* Sinks see every read end, even one that did not get a byte. */
+	if (!ctx->obj_active) {
+		(void)obj_begin(ctx, conn);
+	}
+
+	obj_end(ctx, conn, false);
+}
+
 static void on_obj_metadata_read(struct bt_ots_client *ots_inst, struct bt_conn *conn, int err,
 				 uint8_t metadata_read)
 {
+	otc_mux_done(conn);
 	printk("Object's meta data:\n");
 	printk("\tCurrent size\t:%u", ots_inst->cur_object.size.cur);
 	printk("\tAlloc size\t:%u\n", ots_inst->cur_object.size.alloc);
 
-	if (ots_inst->cur_object.size.cur > OBJ_MAX_SIZE) {
-		printk("Object larger than allocated buffer\n");
-	}
-
 	bt_ots_metadata_display(&ots_inst->cur_object, 1);
+
+	if (IS_ENABLED(CONFIG_GATEWAY_BENCH)) {
+		bench_obj_metadata_read(conn, err);
+	} else if (IS_ENABLED(CONFIG_GATEWAY_FETCH)) {
+		fetch_obj_metadata_read(conn, err);
+	}
 }
 static void on_obj_data_written(struct bt_ots_client *ots_inst, struct bt_conn *conn, size_t len)
 {
 	int err;
 
-	printk("Object been written %d\n", len);
+	EVTLOG("Object been written %u\n", len);
 	/* Update object size after write done*/
-	err = bt_ots_client_read_object_metadata(&otc, default_conn,
-						 BT_OTS_METADATA_REQ_ALL);
+	err = otc_mux_read_metadata(conn, BT_OTS_METADATA_REQ_ALL);
 	if (err != 0) {
 		printk("Failed to read object metadata (err %d)\n", err);
 	}
@@ -623,34 +1205,63 @@ static void on_obj_data_written(struct bt_ots_client *ots_inst, struct bt_conn *
 void on_obj_checksum_calculated(struct bt_ots_client *ots_inst,
 				struct bt_conn *conn, int err, uint32_t checksum)
 {
-	printk("Object Calculate checksum OACP result (%d)\nChecksum 0x%08x last sent 0x%08x %s\n",
-	       err, checksum, last_checksum, (checksum == last_checksum) ? "match" : "not match");
+	struct otc_conn_ctx *ctx = ctx_from_otc(ots_inst);
+#if defined(CONFIG_GATEWAY_OBJ_CRC)
+	/* Compare with what was read rather than what was last written. */
+	uint32_t expected = ctx->obj_crc;
+#else
+	uint32_t expected = ctx->last_checksum;
+#endif
+
+	otc_mux_done(conn);
+
+	if (checksum == expected) {
+		EVTLOG("Object checksum OACP result (%d), 0x%08x match\n", err, checksum);
+	} else {
+		EVTLOG("Object checksum OACP result (%d), 0x%08x, expected 0x%08x not match\n",
+		       err, checksum, expected);
+	}
 }
 
+static const struct otc_mux_cb mux_cb = {
+	.read_failed = on_obj_read_failed,
+};
+
 static void bt_otc_init(void)
 {
+	otc_mux_init(&mux_cb);
+
 	otc_cb.obj_data_read = on_obj_data_read;
 	otc_cb.obj_selected = on_obj_selected;
 	otc_cb.obj_metadata_read = on_obj_metadata_read;
 	otc_cb.obj_data_written = on_obj_data_written;
 	otc_cb.obj_checksum_calculated = on_obj_checksum_calculated;
-	otc.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
-	otc.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
 	printk("Current object selected callback: %p\n", otc_cb.obj_selected);
 	printk("Content callback: %p\n", otc_cb.obj_data_read);
 	printk("Metadata callback: %p\n", otc_cb.obj_metadata_read);
-	otc.cb = &otc_cb;
-	bt_ots_client_register(&otc);
+
+	for (size_t i = 0; i < ARRAY_SIZE(conn_ctxs); i++) {
+		struct otc_conn_ctx *ctx = &conn_ctxs[i];
+		int err;
+
+		/* Parked until the instance runs a procedure through otc_mux. */
+		ctx->otc.start_handle = 0;
+		ctx->otc.end_handle = 0;
+		ctx->otc.cb = &otc_cb;
+		k_work_init_delayable(&ctx->checksum_work.work, otc_checksum_work_fn);
+
+		err = bt_ots_client_register(&ctx->otc);
+		if (err != 0) {
+			printk("Failed to register OTS client %zu (err %d)\n", i, err);
+		}
+	}
 }
 
 int main(void)
 {
 	int err;
 
-	first_selected = false;
-	discovery_state = ATOMIC_INIT(0);
 	k_work_init_delayable(&otc_btn_work.work, otc_btn_work_fn);
-	k_work_init_delayable(&otc_checksum_work.work, otc_checksum_work_fn);
 
 	configure_buttons();
 	err = bt_enable(NULL);
@@ -660,9 +1271,21 @@ int main(void)
 		return 0;
 	}
 
+	err = settings_load();
+	if (err != 0) {
+		printk("Settings load failed (err %d)\n", err);
+	}
+
+	obj_sink_init();
+	if (IS_ENABLED(CONFIG_GATEWAY_BENCH)) {
+		bench_init();
+	} else if (IS_ENABLED(CONFIG_GATEWAY_FETCH)) {
+		fetch_init();
+	}
+
 	bt_otc_init();
 	printk("Bluetooth OTS client sample running\n");
 
 	start_scan();
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,331 @@
+/** @file
+ *  @brief Streaming sinks for incoming OTS object data
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/ring_buffer.h>
+#include <zephyr/sys/util.h>
+
+#include "evtlog.h"
+#include "obj_sink.h"
+#include "rec_fmt.h"
+
+static sys_slist_t sinks = SYS_SLIST_STATIC_INIT(&sinks);
+
+void obj_sink_register(struct obj_sink *sink)
+{
+	sys_slist_append(&sinks, &sink->node);
+}
+
+void obj_sink_begin(struct bt_conn *conn, const struct bt_ots_obj_metadata *obj)
+{
+	struct obj_sink *sink;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&sinks, sink, node) {
+		if (sink->api->begin != NULL) {
+			sink->api->begin(sink, conn, obj);
+		}
+	}
+}
+
+int obj_sink_write(struct bt_conn *conn, uint32_t offset, const uint8_t *data, uint32_t len)
+{
+	struct obj_sink *sink;
+	int err;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&sinks, sink, node) {
+		err = sink->api->write(sink, conn, offset, data, len);
+		if (err < 0) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+void obj_sink_end(struct bt_conn *conn, uint32_t total, bool complete)
+{
+	struct obj_sink *sink;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&sinks, sink, node) {
+		if (sink->api->end != NULL) {
+			sink->api->end(sink, conn, total, complete);
+		}
+	}
+}
+
+/* Per-connection transfer timing; a couple of words per chunk, no data copy. */
+static struct {
+	int64_t start_ms;
+	uint32_t chunks;
+} stats[CONFIG_BT_MAX_CONN];
+
+static void stats_begin(struct obj_sink *sink, struct bt_conn *conn,
+			const struct bt_ots_obj_metadata *obj)
+{
+	uint8_t idx = bt_conn_index(conn);
+
+	stats[idx].start_ms = k_uptime_get();
+	stats[idx].chunks = 0;
+}
+
+static int stats_write(struct obj_sink *sink, struct bt_conn *conn, uint32_t offset,
+		       const uint8_t *data, uint32_t len)
+{
+	stats[bt_conn_index(conn)].chunks++;
+
+	return 0;
+}
+
+static void stats_end(struct obj_sink *sink, struct bt_conn *conn, uint32_t total, bool complete)
+{
+	uint8_t idx = bt_conn_index(conn);
+	int64_t elapsed_ms = k_uptime_get() - stats[idx].start_ms;
+
+	if (complete) {
+		EVTLOG("Object received: %u bytes in %u chunks, %u ms\n", total,
+		       stats[idx].chunks, (uint32_t)elapsed_ms);
+	} else {
+		EVTLOG("Object aborted: %u bytes in %u chunks, %u ms\n", total,
+		       stats[idx].chunks, (uint32_t)elapsed_ms);
+	}
+}
+
+static const struct obj_sink_api stats_api = {
+	.begin = stats_begin,
+	.write = stats_write,
+	.end = stats_end,
+};
+
+static struct obj_sink stats_sink = {
+	.api = &stats_api,
+};
+
+#if defined(CONFIG_GATEWAY_SINK_HEXDUMP)
+/* Printing is far slower than the link. Chunks are copied into a ring
+ * buffer, each behind a small header, and printed by a low priority thread.
+ */
+#define HEXDUMP_LINE_LEN 16
+
+struct hexdump_hdr {
+	uint32_t offset;
+	uint16_t len;
+	uint8_t conn_idx;
+} __packed;
+
+RING_BUF_DECLARE(hexdump_ring, CONFIG_GATEWAY_SINK_HEXDUMP_BUF_SIZE);
+static struct k_spinlock hexdump_lock;
+static K_SEM_DEFINE(hexdump_sem, 0, 1);
+static uint32_t hexdump_dropped;
+
+static int hexdump_write(struct obj_sink *sink, struct bt_conn *conn, uint32_t offset,
+			 const uint8_t *data, uint32_t len)
+{
+	struct hexdump_hdr hdr = {
+		.offset = offset,
+		.len = len,
+		.conn_idx = bt_conn_index(conn),
+	};
+	k_spinlock_key_t key;
+	bool queued;
+
+	key = k_spin_lock(&hexdump_lock);
+
+	queued = (len <= UINT16_MAX && ring_buf_space_get(&hexdump_ring) >= sizeof(hdr) + len);
+	if (queued) {
+		(void)ring_buf_put(&hexdump_ring, (const uint8_t *)&hdr, sizeof(hdr));
+		(void)ring_buf_put(&hexdump_ring, data, len);
+	} else {
+		hexdump_dropped += len;
+	}
+
+	k_spin_unlock(&hexdump_lock, key);
+
+	if (queued) {
+		k_sem_give(&hexdump_sem);
+	}
+
+	return 0;
+}
+
+static uint32_t hexdump_get(uint8_t *buf, uint32_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&hexdump_lock);
+
+	len = ring_buf_get(&hexdump_ring, buf, len);
+	k_spin_unlock(&hexdump_lock, key);
+
+	return len;
+}
+
+static void hexdump_drain(void *p1, void *p2, void *p3)
+{
+	uint32_t reported_dropped = 0;
+	uint8_t line[HEXDUMP_LINE_LEN];
+	struct hexdump_hdr hdr;
+
+	while (1) {
+		k_sem_take(&hexdump_sem, K_FOREVER);
+
+		/* Chunks are queued whole, so the data follows every header. */
+		while (hexdump_get((uint8_t *)&hdr, sizeof(hdr)) == sizeof(hdr)) {
+			for (uint32_t done = 0; done < hdr.len; done += HEXDUMP_LINE_LEN) {
+				uint32_t n = hexdump_get(line, MIN(hdr.len - done, sizeof(line)));
+
+				printk("[%u] @%u:", hdr.conn_idx, hdr.offset + done);
+				for (uint32_t i = 0; i < n; i++) {
+					printk(" %02x", line[i]);
+				}
+
+				printk("\n");
+			}
+		}
+
+		if (hexdump_dropped != reported_dropped) {
+			reported_dropped = hexdump_dropped;
+			printk("--- hexdump: %u bytes dropped ---\n", reported_dropped);
+		}
+	}
+}
+
+K_THREAD_DEFINE(hexdump_thread, CONFIG_GATEWAY_SINK_HEXDUMP_STACK_SIZE, hexdump_drain, NULL, NULL,
+		NULL, K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+
+static const struct obj_sink_api hexdump_api = {
+	.write = hexdump_write,
+};
+
+static struct obj_sink hexdump_sink = {
+	.api = &hexdump_api,
+};
+#endif /* CONFIG_GATEWAY_SINK_HEXDUMP */
+
+#if defined(CONFIG_GATEWAY_SINK_RECORD)
+/* Objects are collected whole; the CRC covers the entire record. A slot is
+ * held by one connection from the start of an object to its end.
+ */
+struct record_slot {
+	struct bt_conn *conn;
+	uint8_t buf[CONFIG_GATEWAY_SINK_RECORD_MAX_SIZE];
+	uint32_t len;
+	bool overflow;
+};
+
+static struct record_slot records[CONFIG_GATEWAY_SINK_RECORD_SLOTS];
+
+/* Decoding runs on the RX thread only, so one sample buffer is enough.
+ * A delta encoded record holds at most one sample per payload byte.
+ */
+static int16_t record_samples[CONFIG_GATEWAY_SINK_RECORD_MAX_SIZE - REC_FMT_HDR_SIZE];
+
+/* Slot held by conn, or a free one for conn NULL. */
+static struct record_slot *record_slot_find(const struct bt_conn *conn)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(records); i++) {
+		if (records[i].conn == conn) {
+			return &records[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void record_begin(struct obj_sink *sink, struct bt_conn *conn,
+			 const struct bt_ots_obj_metadata *obj)
+{
+	struct record_slot *slot = record_slot_find(NULL);
+
+	if (slot == NULL) {
+		EVTLOG("Record from node %u not decoded, all %u slots busy\n",
+		       bt_conn_index(conn), CONFIG_GATEWAY_SINK_RECORD_SLOTS);
+		return;
+	}
+
+	slot->conn = conn;
+	slot->len = 0;
+	slot->overflow = false;
+}
+
+static int record_write(struct obj_sink *sink, struct bt_conn *conn, uint32_t offset,
+			const uint8_t *data, uint32_t len)
+{
+	struct record_slot *slot = record_slot_find(conn);
+
+	if (slot == NULL) {
+		return 0;
+	}
+
+	if (offset != slot->len || offset + len > sizeof(slot->buf)) {
+		slot->overflow = true;
+		return 0;
+	}
+
+	(void)memcpy(&slot->buf[offset], data, len);
+	slot->len += len;
+
+	return 0;
+}
+
+static void record_end(struct obj_sink *sink, struct bt_conn *conn, uint32_t total, bool complete)
+{
+	struct record_slot *slot = record_slot_find(conn);
+	struct rec_fmt_info info;
+	int ret;
+
+	if (slot == NULL) {
+		return;
+	}
+
+	/* Decoding runs right here, so the slot is free again on return. */
+	slot->conn = NULL;
+
+	if (!complete) {
+		return;
+	}
+
+	if (slot->overflow) {
+		EVTLOG("Record of %u bytes not decoded, max %u\n", total,
+		       CONFIG_GATEWAY_SINK_RECORD_MAX_SIZE);
+		return;
+	}
+
+	ret = rec_fmt_decode(slot->buf, slot->len, &info, record_samples,
+			     ARRAY_SIZE(record_samples));
+	if (ret < 0) {
+		EVTLOG("Record decode failed (%d), %u bytes\n", ret, total);
+		return;
+	}
+
+	EVTLOG("Record: sensor %u, window %u, %u samples\n", info.sensor, info.window, ret);
+	EVTLOG("Record: encoding %u, %u bytes, t=%u ms\n", info.enc, total, info.timestamp_ms);
+}
+
+static const struct obj_sink_api record_api = {
+	.begin = record_begin,
+	.write = record_write,
+	.end = record_end,
+};
+
+static struct obj_sink record_sink = {
+	.api = &record_api,
+};
+#endif /* CONFIG_GATEWAY_SINK_RECORD */
+
+void obj_sink_init(void)
+{
+	obj_sink_register(&stats_sink);
+
+#if defined(CONFIG_GATEWAY_SINK_RECORD)
+	obj_sink_register(&record_sink);
+#endif
+
+#if defined(CONFIG_GATEWAY_SINK_HEXDUMP)
+	obj_sink_register(&hexdump_sink);
+#endif
+}
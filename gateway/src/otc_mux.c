@@ -0,0 +1,614 @@
+/** @file
+ *  @brief Run the OTS client on many nodes at once
+ *
+ * The OTS client finds the instance of a GATT response or indication by
+ * attribute handle range, and the instance of L2CAP object data through
+ * one global current instance. Identical nodes have identical handle
+ * ranges, so two nodes running OTS procedures at once would get each
+ * other's results and data.
+ *
+ * Object data, which takes nearly all of the radio time, therefore
+ * bypasses the OTS client: every node gets an object channel and OACP
+ * Read and Write requests of its own, and all nodes transfer in parallel.
+ * The short procedures left to the OTS client run on one node at a time.
+ * Only that node has its service range in its instance; the ranges of all
+ * others are parked at 0, which matches no attribute.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/l2cap.h>
+#include <zephyr/bluetooth/services/ots.h>
+#include <zephyr/kernel.h>
+#include <zephyr/net_buf.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "otc_mux.h"
+
+/* Hardcoded here since definitions are in internal headers */
+#define BT_GATT_OTS_L2CAP_PSM        0x0025
+#define BT_GATT_OTS_OACP_PROC_READ   0x05
+#define BT_GATT_OTS_OACP_PROC_WRITE  0x06
+#define BT_GATT_OTS_OACP_PROC_RESP   0x60
+#define BT_GATT_OTS_OACP_RES_SUCCESS 0x01
+#define OTS_FEATURE_LEN              8
+
+/* A procedure is a few ATT round trips. One still running after this has
+ * lost its result, and waiting longer would stall every other node.
+ */
+#define PROC_TIMEOUT_MS 3000
+
+enum mux_op {
+	MUX_OP_NONE,
+	MUX_OP_READ,
+	MUX_OP_WRITE,
+};
+
+enum mux_chan_state {
+	MUX_CHAN_CLOSED,
+	MUX_CHAN_CONNECTING,
+	MUX_CHAN_OPEN,
+	MUX_CHAN_CLOSING,
+};
+
+struct mux_node {
+	struct bt_ots_client *otc;
+	struct bt_conn *conn;
+	/* OTS service range, copied into otc while running a procedure. */
+	uint16_t start_handle;
+	uint16_t end_handle;
+	struct bt_gatt_read_params feature_params;
+	/* Object channel and the read or write in progress on it. */
+	struct bt_l2cap_le_chan chan;
+	enum mux_chan_state chan_state;
+	enum mux_op op;
+	struct bt_gatt_write_params oacp_params;
+	uint8_t oacp_req[10];
+	uint32_t op_offset;
+	uint32_t op_len;
+	uint32_t op_done;
+	uint8_t write_mode;
+	const uint8_t *tx_data;
+};
+
+static struct mux_node nodes[CONFIG_BT_MAX_CONN];
+static const struct otc_mux_cb *mux_cb;
+
+/* Node running an OTS client procedure, the only one with its range set. */
+static struct mux_node *owner;
+static struct k_spinlock owner_lock;
+static struct k_work_delayable owner_timeout;
+
+/* One SDU is reassembled per channel at a time. */
+NET_BUF_POOL_FIXED_DEFINE(mux_rx_pool, CONFIG_BT_MAX_CONN,
+			  BT_L2CAP_SDU_BUF_SIZE(CONFIG_BT_OTS_L2CAP_CHAN_RX_MTU), 8, NULL);
+
+/* Writes come from the buttons only, an SDU at a time; the second buffer
+ * covers the next SDU being allocated before the last one is freed.
+ */
+NET_BUF_POOL_FIXED_DEFINE(mux_tx_pool, 2, BT_L2CAP_SDU_BUF_SIZE(CONFIG_BT_OTS_L2CAP_CHAN_TX_MTU),
+			  8, NULL);
+
+static struct mux_node *node_get(struct bt_conn *conn)
+{
+	struct mux_node *node = &nodes[bt_conn_index(conn)];
+
+	return (node->conn == conn) ? node : NULL;
+}
+
+static void node_park(struct mux_node *node)
+{
+	node->otc->start_handle = 0;
+	node->otc->end_handle = 0;
+}
+
+static int proc_begin(struct mux_node *node)
+{
+	k_spinlock_key_t key;
+	int err = 0;
+
+	if (node == NULL) {
+		return -ENOTCONN;
+	}
+
+	key = k_spin_lock(&owner_lock);
+
+	if (owner != NULL) {
+		err = -EBUSY;
+	} else {
+		owner = node;
+		node->otc->start_handle = node->start_handle;
+		node->otc->end_handle = node->end_handle;
+		(void)k_work_reschedule(&owner_timeout, K_MSEC(PROC_TIMEOUT_MS));
+	}
+
+	k_spin_unlock(&owner_lock, key);
+
+	return err;
+}
+
+static void proc_end(struct mux_node *node)
+{
+	k_spinlock_key_t key = k_spin_lock(&owner_lock);
+
+	if (owner == node) {
+		owner = NULL;
+		node_park(node);
+		(void)k_work_cancel_delayable(&owner_timeout);
+	}
+
+	k_spin_unlock(&owner_lock, key);
+}
+
+/* Ends the procedure again if the OTS client did not start it. */
+static int proc_started(struct mux_node *node, int err)
+{
+	if (err != 0) {
+		proc_end(node);
+	}
+
+	return err;
+}
+
+static void owner_timeout_fn(struct k_work *work)
+{
+	struct mux_node *node;
+	k_spinlock_key_t key = k_spin_lock(&owner_lock);
+
+	node = owner;
+	if (node != NULL) {
+		owner = NULL;
+		node_park(node);
+	}
+
+	k_spin_unlock(&owner_lock, key);
+
+	if (node != NULL) {
+		printk("OTS procedure of node %u timed out\n", (uint32_t)(node - nodes));
+	}
+}
+
+static void op_end(struct mux_node *node, int err)
+{
+	enum mux_op op = node->op;
+
+	node->op = MUX_OP_NONE;
+
+	if (op == MUX_OP_READ && mux_cb->read_failed != NULL) {
+		mux_cb->read_failed(node->conn, err);
+	} else if (op == MUX_OP_WRITE) {
+		printk("Object write failed (err %d)\n", err);
+	}
+}
+
+static void oacp_written(struct bt_conn *conn, uint8_t err, struct bt_gatt_write_params *params)
+{
+	struct mux_node *node = CONTAINER_OF(params, struct mux_node, oacp_params);
+
+	if (err == 0 || node->conn != conn || node->op == MUX_OP_NONE) {
+		/* The outcome comes with the OACP indication. */
+		return;
+	}
+
+	printk("OACP request failed (err 0x%02x)\n", err);
+	op_end(node, -EIO);
+}
+
+static int oacp_request(struct mux_node *node)
+{
+	uint8_t *req = node->oacp_req;
+
+	req[0] = (node->op == MUX_OP_READ) ? BT_GATT_OTS_OACP_PROC_READ
+					   : BT_GATT_OTS_OACP_PROC_WRITE;
+	sys_put_le32(node->op_offset, &req[1]);
+	sys_put_le32(node->op_len, &req[5]);
+	req[9] = node->write_mode;
+
+	node->oacp_params.func = oacp_written;
+	node->oacp_params.handle = node->otc->oacp_handle;
+	node->oacp_params.offset = 0;
+	node->oacp_params.data = req;
+	node->oacp_params.length = (node->op == MUX_OP_READ) ? 9 : 10;
+
+	return bt_gatt_write(node->conn, &node->oacp_params);
+}
+
+static void tx_next(struct mux_node *node)
+{
+	struct net_buf *buf;
+	uint32_t len;
+	int err;
+
+	if (node->op_done == node->op_len) {
+		node->op = MUX_OP_NONE;
+		if (node->otc->cb->obj_data_written != NULL) {
+			node->otc->cb->obj_data_written(node->otc, node->conn, node->op_len);
+		}
+
+		return;
+	}
+
+	buf = net_buf_alloc(&mux_tx_pool, K_NO_WAIT);
+	if (buf == NULL) {
+		op_end(node, -ENOMEM);
+		return;
+	}
+
+	len = MIN(node->op_len - node->op_done,
+		  MIN(node->chan.tx.mtu, CONFIG_BT_OTS_L2CAP_CHAN_TX_MTU));
+	net_buf_reserve(buf, BT_L2CAP_SDU_CHAN_SEND_RESERVE);
+	net_buf_add_mem(buf, &node->tx_data[node->op_done], len);
+
+	err = bt_l2cap_chan_send(&node->chan.chan, buf);
+	if (err < 0) {
+		net_buf_unref(buf);
+		op_end(node, err);
+		return;
+	}
+
+	node->op_done += len;
+}
+
+static void chan_close(struct mux_node *node)
+{
+	/* Closing the channel is what stops the node sending the rest. */
+	if (bt_l2cap_chan_disconnect(&node->chan.chan) == 0) {
+		node->chan_state = MUX_CHAN_CLOSING;
+	}
+}
+
+static struct net_buf *chan_alloc_buf(struct bt_l2cap_chan *chan)
+{
+	return net_buf_alloc(&mux_rx_pool, K_NO_WAIT);
+}
+
+static void chan_connected(struct bt_l2cap_chan *chan)
+{
+	struct mux_node *node = CONTAINER_OF(chan, struct mux_node, chan.chan);
+	int err;
+
+	node->chan_state = MUX_CHAN_OPEN;
+
+	if (node->op != MUX_OP_NONE) {
+		err = oacp_request(node);
+		if (err != 0) {
+			op_end(node, err);
+		}
+	}
+}
+
+static void chan_disconnected(struct bt_l2cap_chan *chan)
+{
+	struct mux_node *node = CONTAINER_OF(chan, struct mux_node, chan.chan);
+
+	node->chan_state = MUX_CHAN_CLOSED;
+
+	if (node->conn != NULL && node->op != MUX_OP_NONE) {
+		op_end(node, -ECONNRESET);
+	}
+}
+
+static int chan_recv(struct bt_l2cap_chan *chan, struct net_buf *buf)
+{
+	struct mux_node *node = CONTAINER_OF(chan, struct mux_node, chan.chan);
+	uint32_t offset = node->op_done;
+	uint32_t len;
+	bool complete;
+	int ret;
+
+	if (node->op != MUX_OP_READ) {
+		/* Rest of a read that was stopped. */
+		return 0;
+	}
+
+	len = MIN(buf->len, node->op_len - offset);
+	complete = (offset + len == node->op_len);
+	node->op_done += len;
+	if (complete) {
+		node->op = MUX_OP_NONE;
+	}
+
+	ret = node->otc->cb->obj_data_read(node->otc, node->conn, offset, len, buf->data,
+					   complete);
+	if (!complete && ret == BT_OTS_STOP) {
+		node->op = MUX_OP_NONE;
+		chan_close(node);
+	}
+
+	return 0;
+}
+
+static void chan_sent(struct bt_l2cap_chan *chan)
+{
+	struct mux_node *node = CONTAINER_OF(chan, struct mux_node, chan.chan);
+
+	if (node->op == MUX_OP_WRITE) {
+		tx_next(node);
+	}
+}
+
+static const struct bt_l2cap_chan_ops chan_ops = {
+	.alloc_buf = chan_alloc_buf,
+	.connected = chan_connected,
+	.disconnected = chan_disconnected,
+	.recv = chan_recv,
+	.sent = chan_sent,
+};
+
+/* Send the OACP request of node->op, opening the channel first if needed. */
+static int op_start(struct mux_node *node)
+{
+	int err;
+
+	switch (node->chan_state) {
+	case MUX_CHAN_OPEN:
+		err = oacp_request(node);
+		break;
+	case MUX_CHAN_CLOSED:
+		(void)memset(&node->chan, 0, sizeof(node->chan));
+		node->chan.chan.ops = &chan_ops;
+		node->chan.rx.mtu = CONFIG_BT_OTS_L2CAP_CHAN_RX_MTU;
+
+		err = bt_l2cap_chan_connect(node->conn, &node->chan.chan, BT_GATT_OTS_L2CAP_PSM);
+		if (err == 0) {
+			node->chan_state = MUX_CHAN_CONNECTING;
+		}
+		break;
+	default:
+		err = -EBUSY;
+		break;
+	}
+
+	if (err != 0) {
+		node->op = MUX_OP_NONE;
+	}
+
+	return err;
+}
+
+static uint8_t feature_read(struct bt_conn *conn, uint8_t err, struct bt_gatt_read_params *params,
+			    const void *data, uint16_t length)
+{
+	struct mux_node *node = CONTAINER_OF(params, struct mux_node, feature_params);
+
+	if (node->conn != conn) {
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (err != 0 || data == NULL || length != OTS_FEATURE_LEN) {
+		printk("OTS feature read failed (err 0x%02x, %u bytes)\n", err, length);
+		return BT_GATT_ITER_STOP;
+	}
+
+	node->otc->features.oacp = sys_get_le32(data);
+	node->otc->features.olcp = sys_get_le32((const uint8_t *)data + sizeof(uint32_t));
+
+	return BT_GATT_ITER_STOP;
+}
+
+void otc_mux_init(const struct otc_mux_cb *cb)
+{
+	mux_cb = cb;
+	k_work_init_delayable(&owner_timeout, owner_timeout_fn);
+}
+
+void otc_mux_attach(struct bt_ots_client *otc, struct bt_conn *conn, uint16_t start_handle,
+		    uint16_t end_handle)
+{
+	struct mux_node *node = &nodes[bt_conn_index(conn)];
+
+	node->otc = otc;
+	node->conn = conn;
+	node->start_handle = start_handle;
+	node->end_handle = end_handle;
+	node->chan_state = MUX_CHAN_CLOSED;
+	node->op = MUX_OP_NONE;
+	node_park(node);
+}
+
+void otc_mux_detach(struct bt_conn *conn)
+{
+	struct mux_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return;
+	}
+
+	proc_end(node);
+
+	/* The channel goes down with the link. */
+	node->op = MUX_OP_NONE;
+	node->chan_state = MUX_CHAN_CLOSED;
+	node->conn = NULL;
+}
+
+int otc_mux_read_feature(struct bt_conn *conn)
+{
+	struct mux_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return -ENOTCONN;
+	}
+
+	node->feature_params.func = feature_read;
+	node->feature_params.handle_count = 1;
+	node->feature_params.single.handle = node->otc->feature_handle;
+	node->feature_params.single.offset = 0;
+
+	return bt_gatt_read(conn, &node->feature_params);
+}
+
+int otc_mux_select_id(struct bt_conn *conn, uint64_t id)
+{
+	struct mux_node *node = node_get(conn);
+	int err = proc_begin(node);
+
+	if (err == 0) {
+		err = proc_started(node, bt_ots_client_select_id(node->otc, conn, id));
+	}
+
+	return err;
+}
+
+int otc_mux_select_first(struct bt_conn *conn)
+{
+	struct mux_node *node = node_get(conn);
+	int err = proc_begin(node);
+
+	if (err == 0) {
+		err = proc_started(node, bt_ots_client_select_first(node->otc, conn));
+	}
+
+	return err;
+}
+
+int otc_mux_select_next(struct bt_conn *conn)
+{
+	struct mux_node *node = node_get(conn);
+	int err = proc_begin(node);
+
+	if (err == 0) {
+		err = proc_started(node, bt_ots_client_select_next(node->otc, conn));
+	}
+
+	return err;
+}
+
+int otc_mux_read_metadata(struct bt_conn *conn, uint8_t metadata)
+{
+	struct mux_node *node = node_get(conn);
+	int err = proc_begin(node);
+
+	if (err == 0) {
+		err = proc_started(node,
+				   bt_ots_client_read_object_metadata(node->otc, conn, metadata));
+	}
+
+	return err;
+}
+
+int otc_mux_get_checksum(struct bt_conn *conn, off_t offset, size_t len)
+{
+	struct mux_node *node = node_get(conn);
+	int err = proc_begin(node);
+
+	if (err == 0) {
+		err = proc_started(node, bt_ots_client_get_object_checksum(node->otc, conn,
+									     offset, len));
+	}
+
+	return err;
+}
+
+void otc_mux_done(struct bt_conn *conn)
+{
+	struct mux_node *node = node_get(conn);
+
+	if (node != NULL) {
+		proc_end(node);
+	}
+}
+
+int otc_mux_read_data(struct bt_conn *conn)
+{
+	struct mux_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return -ENOTCONN;
+	}
+
+	if (node->op != MUX_OP_NONE) {
+		return -EBUSY;
+	}
+
+	if (node->otc->cur_object.size.cur == 0) {
+		/* Nothing to put on air. */
+		(void)node->otc->cb->obj_data_read(node->otc, conn, 0, 0, NULL, true);
+		return 0;
+	}
+
+	node->op = MUX_OP_READ;
+	node->op_offset = 0;
+	node->op_len = node->otc->cur_object.size.cur;
+	node->op_done = 0;
+	node->write_mode = 0;
+
+	return op_start(node);
+}
+
+int otc_mux_write_data(struct bt_conn *conn, const void *buf, size_t len, off_t offset,
+		       enum bt_ots_oacp_write_op_mode mode)
+{
+	struct mux_node *node = node_get(conn);
+
+	if (node == NULL) {
+		return -ENOTCONN;
+	}
+
+	if (len == 0 || len > UINT32_MAX || offset < 0 || offset > UINT32_MAX) {
+		return -EINVAL;
+	}
+
+	if (node->op != MUX_OP_NONE) {
+		return -EBUSY;
+	}
+
+	node->op = MUX_OP_WRITE;
+	node->op_offset = offset;
+	node->op_len = len;
+	node->op_done = 0;
+	node->write_mode = mode;
+	node->tx_data = buf;
+
+	return op_start(node);
+}
+
+uint8_t otc_mux_indicate(struct bt_conn *conn, struct bt_gatt_subscribe_params *params,
+			 const void *data, uint16_t length)
+{
+	struct mux_node *node = node_get(conn);
+	const uint8_t *rsp = data;
+	uint8_t req_op;
+	k_spinlock_key_t key;
+	bool running;
+
+	if (data == NULL) {
+		/* Unsubscribed. */
+		return BT_GATT_ITER_STOP;
+	}
+
+	if (node == NULL) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	req_op = (node->op == MUX_OP_READ) ? BT_GATT_OTS_OACP_PROC_READ
+					   : BT_GATT_OTS_OACP_PROC_WRITE;
+	if (node->op != MUX_OP_NONE && params->value_handle == node->otc->oacp_handle &&
+	    length >= 3 && rsp[0] == BT_GATT_OTS_OACP_PROC_RESP && rsp[1] == req_op) {
+		if (rsp[2] != BT_GATT_OTS_OACP_RES_SUCCESS) {
+			printk("OACP request 0x%02x rejected (res %u)\n", req_op, rsp[2]);
+			op_end(node, -EIO);
+		} else if (node->op == MUX_OP_WRITE) {
+			tx_next(node);
+		}
+
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	key = k_spin_lock(&owner_lock);
+	running = (owner == node);
+	k_spin_unlock(&owner_lock, key);
+
+	if (!running) {
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	return bt_ots_client_indicate_handler(conn, params, data, length);
+}
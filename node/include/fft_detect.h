@@ -0,0 +1,58 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef FFT_DETECT_H
+#define FFT_DETECT_H
+
+#include <stdbool.h>
+
+#include <zephyr/types.h>
+
+/* Samples per accelerometer capture: 2 KB of 16-bit samples. */
+#define FFT_DETECT_LEN 1024
+
+/**
+ * @brief Outcome of one spectrum analysis
+ *
+ * Spectrum values are scaled by 1/FFT_DETECT_LEN, so a full-scale sine
+ * shows up as a bin magnitude of about 16384.
+ */
+struct fft_detect_result {
+	/* Sum of |X[k]|^2 over each of CONFIG_NODE_FFT_BANDS equal-width bands. */
+	uint64_t band_energy[CONFIG_NODE_FFT_BANDS];
+	uint16_t peak_bin;
+	uint16_t peak_mag;
+	bool anomaly;
+	/* Cycles spent in the FFT and band accumulation. */
+	uint32_t cycles;
+};
+
+/**
+ * @brief Prepare the twiddle tables and FFT instance
+ *
+ * @return int 0 on success, negative errno on failure
+ */
+int fft_detect_init(void);
+
+/**
+ * @brief Buffer a capture of FFT_DETECT_LEN Q15 samples is written to
+ *
+ * The buffer is transformed in place by fft_detect_run(), so anything
+ * that needs the raw samples must consume them before that.
+ */
+int16_t *fft_detect_capture_buf(void);
+
+/**
+ * @brief Transform the capture and compare its peak against the threshold
+ *
+ * @param result Filled with band energies, peak and verdict
+ */
+void fft_detect_run(struct fft_detect_result *result);
+
+/**
+ * @brief Set the peak magnitude above which a capture is abnormal
+ */
+void fft_detect_set_threshold(uint16_t threshold);
+
+#endif /* FFT_DETECT_H */
@@ -0,0 +1,28 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MTW_H
+#define MTW_H
+
+#include <stdbool.h>
+
+/**
+ * @brief Prepare the measurement pipeline
+ *
+ * @return int 0 on success, negative errno on failure
+ */
+int mtw_init(void);
+
+/**
+ * @brief Run one measurement window
+ *
+ * Captures the (mocked) accelerometer, microphone and ADC data, stores
+ * each capture as a record and runs the FFT anomaly check on the
+ * accelerometer capture.
+ *
+ * @return true if the accelerometer capture is abnormal
+ */
+bool mtw_run(void);
+
+#endif /* MTW_H */
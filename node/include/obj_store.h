@@ -0,0 +1,115 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef OBJ_STORE_H
+#define OBJ_STORE_H
+
+#include <sys/types.h>
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/services/ots.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/types.h>
+
+/**
+ * @brief Kind of measurement held by a stored record
+ */
+enum obj_store_type {
+	OBJ_STORE_ACCEL,
+	OBJ_STORE_PDM,
+	OBJ_STORE_ADC,
+
+	OBJ_STORE_TYPE_NUM,
+};
+
+/* The payload is LZC compressed and exposed with the LZC object type. */
+#define OBJ_STORE_FLAG_LZC BIT(0)
+/* crc holds the CRC-32 of the payload as stored. */
+#define OBJ_STORE_FLAG_CRC BIT(1)
+
+/**
+ * @brief Header written in front of every record in flash
+ */
+struct obj_store_hdr {
+	uint8_t type;
+	uint8_t flags;
+	uint8_t reserved[2];
+	uint32_t crc;
+	uint32_t seq;
+	uint32_t timestamp_ms;
+};
+
+/**
+ * @brief Mount the flash ring and expose the oldest records as OTS objects
+ *
+ * @param ots Initialized OTS instance the records are added to
+ * @return int 0 on success, negative errno on failure
+ */
+int obj_store_init(struct bt_ots *ots);
+
+/**
+ * @brief Append one measurement to the flash ring
+ *
+ * If the ring is full its oldest sector is erased first, together with
+ * the objects it still exposes. While the gateway reads an object of that
+ * sector the record is queued in RAM instead and stored once the read is
+ * over. With CONFIG_NODE_OBJ_COMPRESS the payload
+ * is stored compressed whenever that makes it smaller. With CONFIG_NODE_OBJ_CRC
+ * the CRC-32 of the stored payload is kept in the record header and
+ * published in the object name. The record becomes an OTS object as soon
+ * as the object pool has room for it.
+ *
+ * @param type Kind of measurement
+ * @param data Record payload
+ * @param len Payload length in bytes
+ * @return int 0 on success, negative errno on failure
+ */
+int obj_store_append(enum obj_store_type type, const void *data, size_t len);
+
+/**
+ * @brief OTS obj_created handler; only objects added by the store are accepted
+ */
+int obj_store_obj_created(uint64_t id, const struct bt_ots_obj_add_param *add_param,
+			  struct bt_ots_obj_created_desc *created_desc);
+
+/**
+ * @brief OTS obj_deleted handler; marks the record consumed
+ *
+ * The lowest sequence number not consumed yet is persisted in the ring, so
+ * consumed records are not exposed again after a reboot.
+ */
+int obj_store_obj_deleted(uint64_t id);
+
+/**
+ * @brief OTS obj_read handler; copies the next chunk of a record out of flash
+ *
+ * @return Length of the chunk placed in @p data, or negative errno
+ */
+ssize_t obj_store_obj_read(uint64_t id, void **data, size_t len, off_t offset);
+
+/**
+ * @brief OTS obj_read completion; the whole object reached the gateway
+ *
+ * Its sector may be erased again, so queued records get stored.
+ */
+void obj_store_obj_read_done(uint64_t id);
+
+/**
+ * @brief End the reads of a lost connection
+ *
+ * With CONFIG_NODE_OBJ_RESUME, each record whose read was cut short
+ * becomes an object holding only the part the gateway has not acknowledged
+ * yet, named with the offset it starts at.
+ */
+void obj_store_conn_lost(void);
+
+/**
+ * @brief OTS obj_cal_checksum handler
+ *
+ * Ranges are checksummed in place on memory mapped flash. Otherwise they
+ * are copied out of flash, up to CONFIG_NODE_OBJ_STORE_CHECKSUM_MAX bytes.
+ */
+int obj_store_obj_checksum(uint64_t id, off_t offset, size_t len, void **data);
+
+#endif /* OBJ_STORE_H */
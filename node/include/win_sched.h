@@ -0,0 +1,70 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef WIN_SCHED_H
+#define WIN_SCHED_H
+
+#include <stdbool.h>
+
+#include <zephyr/types.h>
+
+/**
+ * @brief Time windows of the node
+ */
+enum win_id {
+	/* Measurement: capture, store and FFT check, radio stays off. */
+	WIN_MTW,
+	/* Data sending: advertise so the gateway can fetch stored records. */
+	WIN_DTW,
+	/* Alarm sending: random period, or pulled in by an abnormal MTW. */
+	WIN_ATW,
+
+	WIN_NUM,
+};
+
+/**
+ * @brief Awake-time statistics of one window
+ */
+struct win_stats {
+	/* Wakes that served this window. */
+	uint32_t wakes;
+	/* Of those, wakes that were started for another window. */
+	uint32_t coalesced;
+	uint32_t awake_ms_total;
+	uint32_t awake_ms_max;
+};
+
+/**
+ * @brief Radio control hooks, called from the scheduler work queue
+ */
+struct win_sched_cb {
+	/* Start advertising for the gateway. */
+	void (*radio_on)(void);
+	/* Stop advertising and drop the gateway connection. */
+	void (*radio_off)(void);
+	/* Optional: true while the gateway is reading an object. The radio is
+	 * then kept on past the end of the wake, for at most
+	 * CONFIG_NODE_WIN_RADIO_HOLD_MS.
+	 */
+	bool (*transfer_active)(void);
+};
+
+/**
+ * @brief Start the window scheduler
+ *
+ * The radio stays off until the first window that needs it.
+ *
+ * @param cb Radio control hooks
+ */
+void win_sched_start(const struct win_sched_cb *cb);
+
+/**
+ * @brief Copy the statistics of one window
+ *
+ * The scheduler also prints them at the end of every wake that served a
+ * data sending window.
+ */
+void win_sched_stats_get(enum win_id win, struct win_stats *stats);
+
+#endif /* WIN_SCHED_H */
@@ -0,0 +1,84 @@
+/** @file
+ *  @brief Fixed-point FFT anomaly detector for accelerometer captures
+ *
+ * The transform is the shared q15_fft, CMSIS-DSP when
+ * CONFIG_CMSIS_DSP_TRANSFORMS is enabled and portable otherwise, so the
+ * same detector runs on the nRF52 and on native_sim. Both produce the
+ * spectrum scaled by 1/FFT_DETECT_LEN, so the threshold means the same
+ * thing on either path.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "fft_detect.h"
+#include "q15_fft.h"
+
+#define BINS       (FFT_DETECT_LEN / 2)
+#define BAND_WIDTH (BINS / CONFIG_NODE_FFT_BANDS)
+
+BUILD_ASSERT((BINS % CONFIG_NODE_FFT_BANDS) == 0,
+	     "CONFIG_NODE_FFT_BANDS must divide FFT_DETECT_LEN / 2");
+
+/* Interleaved re/im spectrum, FFT_DETECT_LEN complex bins. */
+static int16_t spectrum[2 * FFT_DETECT_LEN];
+static uint32_t threshold_sq = (uint32_t)CONFIG_NODE_FFT_THRESHOLD * CONFIG_NODE_FFT_THRESHOLD;
+
+Q15_FFT_DEFINE(fft, FFT_DETECT_LEN);
+
+#if defined(CONFIG_CMSIS_DSP_TRANSFORMS)
+/* arm_rfft_q15() needs a separate source. */
+static int16_t capture[FFT_DETECT_LEN];
+#else
+/* Real samples go in the first half and are spread out in place. */
+static int16_t *const capture = spectrum;
+#endif
+
+int fft_detect_init(void)
+{
+	return q15_fft_init(&fft);
+}
+
+int16_t *fft_detect_capture_buf(void)
+{
+	return capture;
+}
+
+void fft_detect_set_threshold(uint16_t threshold)
+{
+	threshold_sq = (uint32_t)threshold * threshold;
+}
+
+void fft_detect_run(struct fft_detect_result *result)
+{
+	uint32_t start = k_cycle_get_32();
+	uint32_t peak_sq = 0;
+
+	q15_fft_run(&fft, capture, spectrum);
+
+	(void)memset(result, 0, sizeof(*result));
+
+	/* Skip DC; the accelerometer's gravity offset is not a vibration. */
+	for (size_t k = 1; k < BINS; k++) {
+		int32_t re = spectrum[2 * k];
+		int32_t im = spectrum[2 * k + 1];
+		uint32_t mag_sq = (uint32_t)(re * re) + (uint32_t)(im * im);
+
+		result->band_energy[k / BAND_WIDTH] += mag_sq;
+
+		if (mag_sq > peak_sq) {
+			peak_sq = mag_sq;
+			result->peak_bin = k;
+		}
+	}
+
+	result->cycles = k_cycle_get_32() - start;
+	result->peak_mag = (uint16_t)MIN(sqrt((double)peak_sq), UINT16_MAX);
+	result->anomaly = (peak_sq > threshold_sq);
+}
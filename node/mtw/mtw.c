@@ -0,0 +1,169 @@
+/** @file
+ *  @brief Measurement time window: capture, store and FFT check
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/timing/timing.h>
+
+#include "fft_detect.h"
+#include "mtw.h"
+#include "obj_store.h"
+#include "rec_fmt.h"
+
+#define PDM_CAPTURE_LEN 400
+#define ADC_SAMPLES     250
+
+/* Awake budget of a normal window; the FFT has to fit well inside it. */
+#define MTW_NORMAL_WINDOW_MS 2000
+
+#define FFT_BENCH_RUNS 16
+
+static int16_t pdm_capture[PDM_CAPTURE_LEN / sizeof(int16_t)];
+static uint16_t adc_capture[ADC_SAMPLES];
+static uint8_t rec_buf[REC_FMT_BUF_SIZE(FFT_DETECT_LEN)];
+
+/* Background vibration with noise; now and then a strong spike. */
+static void mock_accel(int16_t *samples, bool spike)
+{
+	uint32_t base_bin = 8 + (sys_rand32_get() % 32);
+	uint32_t spike_bin = 64 + (sys_rand32_get() % 256);
+
+	for (size_t i = 0; i < FFT_DETECT_LEN; i++) {
+		double v = 3000.0 * sin((2.0 * M_PI * base_bin * i) / FFT_DETECT_LEN);
+
+		if (spike) {
+			v += 16000.0 * sin((2.0 * M_PI * spike_bin * i) / FFT_DETECT_LEN);
+		}
+
+		samples[i] = (int16_t)(v + (int32_t)(sys_rand32_get() % 1024) - 512);
+	}
+}
+
+static void mock_pdm_adc(void)
+{
+	sys_rand_get(pdm_capture, sizeof(pdm_capture));
+
+	for (size_t i = 0; i < ARRAY_SIZE(adc_capture); i++) {
+		adc_capture[i] = sys_rand32_get() & 0x0fff;
+	}
+}
+
+static void store_capture(enum obj_store_type type, enum rec_fmt_sensor sensor,
+			  const int16_t *samples, size_t count)
+{
+	const struct rec_fmt_info info = {
+		.window = REC_FMT_WIN_MTW,
+		.sensor = sensor,
+		.enc = REC_FMT_ENC_AUTO,
+		.timestamp_ms = k_uptime_get_32(),
+	};
+	int len;
+
+	if (!IS_ENABLED(CONFIG_REC_FMT)) {
+		(void)obj_store_append(type, samples, count * sizeof(int16_t));
+		return;
+	}
+
+	len = rec_fmt_encode(&info, samples, count, rec_buf, sizeof(rec_buf));
+	if (len < 0) {
+		printk("Failed to encode record (err %d)\n", len);
+		return;
+	}
+
+	(void)obj_store_append(type, rec_buf, len);
+}
+
+bool mtw_run(void)
+{
+	bool spike = (sys_rand32_get() % CONFIG_NODE_MTW_MOCK_ANOMALY_RATE) == 0;
+	int16_t *accel = fft_detect_capture_buf();
+	struct fft_detect_result res;
+
+	mock_accel(accel, spike);
+	mock_pdm_adc();
+
+	/* Store the raw capture before the FFT transforms it in place. */
+	if (IS_ENABLED(CONFIG_NODE_OBJ_STORE)) {
+		store_capture(OBJ_STORE_ACCEL, REC_FMT_SENSOR_ACCEL, accel, FFT_DETECT_LEN);
+		store_capture(OBJ_STORE_PDM, REC_FMT_SENSOR_PDM, pdm_capture,
+			      ARRAY_SIZE(pdm_capture));
+		store_capture(OBJ_STORE_ADC, REC_FMT_SENSOR_ADC, (const int16_t *)adc_capture,
+			      ARRAY_SIZE(adc_capture));
+	}
+
+	fft_detect_run(&res);
+
+	printk("[%08u] FFT analysis: %s, peak %u at bin %u, %u us\n", k_uptime_get_32(),
+	       res.anomaly ? "Abnormal" : "Normal", res.peak_mag, res.peak_bin,
+	       k_cyc_to_us_floor32(res.cycles));
+
+	return res.anomaly;
+}
+
+#if defined(CONFIG_NODE_FFT_BENCH)
+static void fft_bench(void)
+{
+	struct fft_detect_result res;
+	timing_t start;
+	timing_t end;
+	uint64_t cycles;
+	uint64_t min = UINT64_MAX;
+	uint64_t max = 0;
+	uint64_t sum = 0;
+	uint32_t max_us;
+
+	/* CPU cycle counter; the kernel cycle counter may tick at 32 kHz. */
+	timing_init();
+	timing_start();
+
+	for (size_t i = 0; i < FFT_BENCH_RUNS; i++) {
+		mock_accel(fft_detect_capture_buf(), (i % 2) != 0);
+
+		start = timing_counter_get();
+		fft_detect_run(&res);
+		end = timing_counter_get();
+
+		cycles = timing_cycles_get(&start, &end);
+		min = MIN(min, cycles);
+		max = MAX(max, cycles);
+		sum += cycles;
+	}
+
+	timing_stop();
+
+	max_us = (uint32_t)(timing_cycles_to_ns(max) / NSEC_PER_USEC);
+
+	printk("FFT bench (%s, %u points, %u runs): cycles min %u avg %u max %u\n",
+	       IS_ENABLED(CONFIG_CMSIS_DSP_TRANSFORMS) ? "CMSIS-DSP" : "portable", FFT_DETECT_LEN,
+	       FFT_BENCH_RUNS, (uint32_t)min, (uint32_t)(sum / FFT_BENCH_RUNS), (uint32_t)max);
+	printk("FFT bench: worst case %u us, %u.%02u%% of the %u ms MTW budget\n", max_us,
+	       max_us / (MTW_NORMAL_WINDOW_MS * 10), (max_us / (MTW_NORMAL_WINDOW_MS / 10)) % 100,
+	       MTW_NORMAL_WINDOW_MS);
+}
+#endif /* CONFIG_NODE_FFT_BENCH */
+
+int mtw_init(void)
+{
+	int err;
+
+	err = fft_detect_init();
+	if (err != 0) {
+		printk("Failed to init FFT (err %d)\n", err);
+		return err;
+	}
+
+	fft_detect_set_threshold(CONFIG_NODE_FFT_THRESHOLD);
+
+#if defined(CONFIG_NODE_FFT_BENCH)
+	fft_bench();
+#endif
+
+	return 0;
+}
@@ -0,0 +1,269 @@
+/** @file
+ *  @brief Duty-cycled MTW/DTW/ATW scheduler with a single wakeup timer
+ *
+ * Every window keeps its own next due time, but only the earliest of
+ * them is armed. On a wake, every window due within the coalescing slack
+ * or before the wake would end anyway is served too, so an MTW falling
+ * next to a DTW costs one wake and one radio power-up instead of two.
+ * The radio is only on while a wake serves a DTW or an ATW, and is held
+ * past the end of the wake while an object transfer is still running.
+ *
+ * The scheduler runs on its own work queue, since an MTW captures, encodes
+ * and checks a measurement, which is too long for the system workqueue.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "mtw.h"
+#include "win_sched.h"
+
+#define MTW_AWAKE_MS          2000
+#define MTW_ABNORMAL_AWAKE_MS 5000
+#define DTW_AWAKE_MS          5000
+#define ATW_AWAKE_MS          5000
+/* How often a held radio checks whether the transfer has ended. */
+#define RADIO_HOLD_POLL_MS    500
+
+BUILD_ASSERT(CONFIG_NODE_ATW_MIN_S <= CONFIG_NODE_ATW_MAX_S,
+	     "CONFIG_NODE_ATW_MIN_S must not exceed CONFIG_NODE_ATW_MAX_S");
+
+struct win {
+	const char *name;
+	int64_t due_ms;
+	uint32_t awake_ms;
+	bool needs_radio;
+	struct win_stats stats;
+};
+
+static struct win wins[WIN_NUM] = {
+	[WIN_MTW] = {.name = "MTW", .awake_ms = MTW_AWAKE_MS},
+	[WIN_DTW] = {.name = "DTW", .awake_ms = DTW_AWAKE_MS, .needs_radio = true},
+	[WIN_ATW] = {.name = "ATW", .awake_ms = ATW_AWAKE_MS, .needs_radio = true},
+};
+
+static const struct win_sched_cb *radio_cb;
+static bool awake;
+static bool radio_on;
+static int64_t wake_start_ms;
+static int64_t wake_end_ms;
+/* Latest time the radio is held for a transfer, 0 until it is held. */
+static int64_t hold_end_ms;
+/* Window the wake in progress was armed for. */
+static enum win_id trigger;
+/* Windows served by the wake in progress, as a bitmask of enum win_id. */
+static uint32_t serving;
+static struct k_spinlock lock;
+
+static K_THREAD_STACK_DEFINE(sched_stack, CONFIG_NODE_WIN_SCHED_STACK_SIZE);
+static struct k_work_q sched_q;
+
+static void sched_work_fn(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(sched_work, sched_work_fn);
+
+static uint32_t atw_period_ms(void)
+{
+	uint32_t span = CONFIG_NODE_ATW_MAX_S - CONFIG_NODE_ATW_MIN_S + 1;
+
+	return (CONFIG_NODE_ATW_MIN_S + (sys_rand32_get() % span)) * MSEC_PER_SEC;
+}
+
+static uint32_t win_period_ms(enum win_id id)
+{
+	switch (id) {
+	case WIN_MTW:
+		return CONFIG_NODE_MTW_PERIOD_S * MSEC_PER_SEC;
+	case WIN_DTW:
+		return CONFIG_NODE_DTW_PERIOD_S * MSEC_PER_SEC;
+	default:
+		return atw_period_ms();
+	}
+}
+
+static enum win_id next_win(void)
+{
+	enum win_id next = WIN_MTW;
+
+	for (size_t i = 1; i < ARRAY_SIZE(wins); i++) {
+		if (wins[i].due_ms < wins[next].due_ms) {
+			next = i;
+		}
+	}
+
+	return next;
+}
+
+static void win_serve(enum win_id id, int64_t now)
+{
+	struct win *win = &wins[id];
+	uint32_t awake_ms = win->awake_ms;
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	win->stats.wakes++;
+	if (id != trigger) {
+		win->stats.coalesced++;
+	}
+
+	k_spin_unlock(&lock, key);
+
+	serving |= BIT(id);
+
+	/* Periods run from the due time, not from when the window was served. */
+	win->due_ms += win_period_ms(id);
+	if (win->due_ms <= now) {
+		win->due_ms = now + win_period_ms(id);
+	}
+
+	printk("[%08u] Wakeup: %s started\n", k_uptime_get_32(), win->name);
+
+	if (id == WIN_MTW && IS_ENABLED(CONFIG_NODE_MTW) && mtw_run()) {
+		/* Abnormal capture: stay up longer and send the alarm now. */
+		awake_ms = MTW_ABNORMAL_AWAKE_MS;
+		wins[WIN_ATW].due_ms = now;
+	}
+
+	if (win->needs_radio && !radio_on) {
+		radio_on = true;
+		radio_cb->radio_on();
+	}
+
+	wake_end_ms = MAX(wake_end_ms, now + awake_ms);
+}
+
+/* Serve every window due before the wake would end anyway. */
+static void wake_collect(int64_t now)
+{
+	bool served;
+
+	do {
+		served = false;
+
+		for (size_t i = 0; i < ARRAY_SIZE(wins); i++) {
+			if (wins[i].due_ms <= MAX(now + CONFIG_NODE_WIN_COALESCE_MS, wake_end_ms)) {
+				win_serve(i, now);
+				served = true;
+			}
+		}
+	} while (served);
+}
+
+/* Keep the radio up while the gateway is still reading, within the limit. */
+static bool radio_held(int64_t now)
+{
+	if (!radio_on || radio_cb->transfer_active == NULL || !radio_cb->transfer_active()) {
+		return false;
+	}
+
+	if (hold_end_ms == 0) {
+		hold_end_ms = now + CONFIG_NODE_WIN_RADIO_HOLD_MS;
+		printk("[%08u] Radio held for a transfer\n", k_uptime_get_32());
+	}
+
+	if (now >= hold_end_ms) {
+		printk("[%08u] Transfer still running after %u ms hold, radio off\n",
+		       k_uptime_get_32(), CONFIG_NODE_WIN_RADIO_HOLD_MS);
+		return false;
+	}
+
+	return true;
+}
+
+static void stats_print(void)
+{
+	struct win_stats stats;
+
+	for (size_t i = 0; i < ARRAY_SIZE(wins); i++) {
+		win_sched_stats_get(i, &stats);
+		printk("%s: %u wakes, %u coalesced, awake %u ms total, %u ms max\n",
+		       wins[i].name, stats.wakes, stats.coalesced, stats.awake_ms_total,
+		       stats.awake_ms_max);
+	}
+}
+
+static void wake_finish(int64_t now)
+{
+	uint32_t awake_ms = (uint32_t)(now - wake_start_ms);
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	for (size_t i = 0; i < ARRAY_SIZE(wins); i++) {
+		if ((serving & BIT(i)) != 0) {
+			wins[i].stats.awake_ms_total += awake_ms;
+			wins[i].stats.awake_ms_max = MAX(wins[i].stats.awake_ms_max, awake_ms);
+		}
+	}
+
+	k_spin_unlock(&lock, key);
+
+	printk("[%08u] Sleeping after %u ms awake\n", k_uptime_get_32(), awake_ms);
+
+	/* Once per data window is often enough to follow the duty cycle. */
+	if ((serving & BIT(WIN_DTW)) != 0) {
+		stats_print();
+	}
+
+	serving = 0;
+	awake = false;
+
+	if (radio_on) {
+		radio_on = false;
+		radio_cb->radio_off();
+	}
+}
+
+static void sched_work_fn(struct k_work *work)
+{
+	int64_t now = k_uptime_get();
+
+	if (!awake) {
+		awake = true;
+		trigger = next_win();
+		wake_start_ms = now;
+		wake_end_ms = now;
+		hold_end_ms = 0;
+	} else if (now >= wake_end_ms) {
+		if (!radio_held(now)) {
+			wake_finish(now);
+			k_work_schedule_for_queue(&sched_q, &sched_work,
+						  K_TIMEOUT_ABS_MS(wins[next_win()].due_ms));
+			return;
+		}
+
+		wake_end_ms = now + RADIO_HOLD_POLL_MS;
+	}
+
+	/* Also serves an alarm pulled in while awake. */
+	wake_collect(now);
+	k_work_schedule_for_queue(&sched_q, &sched_work, K_TIMEOUT_ABS_MS(wake_end_ms));
+}
+
+void win_sched_stats_get(enum win_id win, struct win_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+
+	*stats = wins[win].stats;
+
+	k_spin_unlock(&lock, key);
+}
+
+void win_sched_start(const struct win_sched_cb *cb)
+{
+	int64_t now = k_uptime_get();
+
+	radio_cb = cb;
+
+	/* First MTW right away, the others after a period. */
+	wins[WIN_MTW].due_ms = now;
+	wins[WIN_DTW].due_ms = now + win_period_ms(WIN_DTW);
+	wins[WIN_ATW].due_ms = now + win_period_ms(WIN_ATW);
+
+	k_work_queue_start(&sched_q, sched_stack, K_THREAD_STACK_SIZEOF(sched_stack),
+			   K_LOWEST_APPLICATION_THREAD_PRIO, NULL);
+	k_thread_name_set(&sched_q.thread, "win_sched");
+
+	k_work_schedule_for_queue(&sched_q, &sched_work, K_NO_WAIT);
+}
@@ -17,6 +17,12 @@
 
 #include <zephyr/bluetooth/services/ots.h>
 
+#include "evtlog.h"
+#include "link_tune.h"
+#include "mtw.h"
+#include "obj_store.h"
+#include "win_sched.h"
+
 #define DEVICE_NAME      CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN  (sizeof(DEVICE_NAME) - 1)
 
@@ -48,6 +54,28 @@ struct object_creation_data {
 
 static struct object_creation_data *object_being_created;
 
+#if defined(CONFIG_NODE_BENCH)
+/* Synthetic objects served to the gateway benchmark, smallest first. */
+static const uint32_t bench_sizes[] = {100, 1024, 4096, 16384, 65536};
+
+/* Repeating 0..255 pattern, long enough that any SDU can be served from
+ * a single pointer at (offset % 256) without copying.
+ */
+static uint8_t bench_pattern[256 + CONFIG_BT_OTS_L2CAP_CHAN_TX_MTU];
+
+BUILD_ASSERT(ARRAY_SIZE(bench_sizes) <= OBJ_POOL_SIZE,
+	     "CONFIG_BT_OTS_MAX_OBJ_CNT too small for the benchmark objects");
+#endif /* CONFIG_NODE_BENCH */
+
+/* Gateway connection, dropped when the radio window closes. */
+static struct bt_conn *gateway_conn;
+
+/* Timing of the object read in progress, for throughput reporting. */
+static int64_t read_start_ms;
+static uint32_t read_bytes;
+/* Set while an object read is in progress, so the radio is not cut under it. */
+static atomic_t read_active;
+
 static void connected(struct bt_conn *conn, uint8_t err)
 {
 	if (err) {
@@ -56,11 +84,30 @@ static void connected(struct bt_conn *conn, uint8_t err)
 	}
 
 	printk("Connected\n");
+
+	if (gateway_conn == NULL) {
+		gateway_conn = bt_conn_ref(conn);
+	}
+
+	if (IS_ENABLED(CONFIG_LINK_TUNE)) {
+		link_tune_start(conn);
+	}
 }
 
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
 	printk("Disconnected, reason %u %s\n", reason, bt_hci_err_to_str(reason));
+
+	if (conn == gateway_conn) {
+		bt_conn_unref(gateway_conn);
+		gateway_conn = NULL;
+	}
+
+	atomic_clear(&read_active);
+
+#if defined(CONFIG_NODE_OBJ_STORE)
+	obj_store_conn_lost();
+#endif
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
@@ -75,6 +122,10 @@ static int ots_obj_created(struct bt_ots *ots, struct bt_conn *conn, uint64_t id
 	char id_str[BT_OTS_OBJ_ID_STR_LEN];
 	uint64_t index;
 
+	if (IS_ENABLED(CONFIG_NODE_OBJ_STORE)) {
+		return obj_store_obj_created(id, add_param, created_desc);
+	}
+
 	bt_ots_obj_id_to_str(id, id_str, sizeof(id_str));
 
 	if (obj_cnt >= ARRAY_SIZE(objects)) {
@@ -83,7 +134,7 @@ static int ots_obj_created(struct bt_ots *ots, struct bt_conn *conn, uint64_t id
 		return -ENOMEM;
 	}
 
-	if (add_param->size > OBJ_MAX_SIZE) {
+	if (!IS_ENABLED(CONFIG_NODE_BENCH) && add_param->size > OBJ_MAX_SIZE) {
 		printk("Object pool item is too small for Object with %s ID\n",
 		       id_str);
 		return -ENOMEM;
@@ -114,11 +165,11 @@ static int ots_obj_created(struct bt_ots *ots, struct bt_conn *conn, uint64_t id
 static int ots_obj_deleted(struct bt_ots *ots, struct bt_conn *conn,
 			    uint64_t id)
 {
-	char id_str[BT_OTS_OBJ_ID_STR_LEN];
-
-	bt_ots_obj_id_to_str(id, id_str, sizeof(id_str));
+	EVTLOG("Object 0x%x has been deleted\n", (uint32_t)id);
 
-	printk("Object with %s ID has been deleted\n", id_str);
+	if (IS_ENABLED(CONFIG_NODE_OBJ_STORE)) {
+		return obj_store_obj_deleted(id);
+	}
 
 	obj_cnt--;
 
@@ -128,41 +179,63 @@ static int ots_obj_deleted(struct bt_ots *ots, struct bt_conn *conn,
 static void ots_obj_selected(struct bt_ots *ots, struct bt_conn *conn,
 			     uint64_t id)
 {
-	char id_str[BT_OTS_OBJ_ID_STR_LEN];
-
-	bt_ots_obj_id_to_str(id, id_str, sizeof(id_str));
-
-	printk("Object with %s ID has been selected\n", id_str);
+	EVTLOG("Object 0x%x has been selected\n", (uint32_t)id);
 }
 
 static ssize_t ots_obj_read(struct bt_ots *ots, struct bt_conn *conn,
 			    uint64_t id, void **data, size_t len,
 			    off_t offset)
 {
-	char id_str[BT_OTS_OBJ_ID_STR_LEN];
 	uint32_t obj_index = OTS_OBJ_ID_TO_OBJ_IDX(id);
 
-	bt_ots_obj_id_to_str(id, id_str, sizeof(id_str));
-
 	if (!data) {
-		printk("Object with %s ID has been successfully read\n",
-		       id_str);
+		EVTLOG("Object 0x%x has been successfully read, %u bytes in %u ms\n",
+		       (uint32_t)id, read_bytes, (uint32_t)(k_uptime_get() - read_start_ms));
+		atomic_clear(&read_active);
+
+#if defined(CONFIG_NODE_OBJ_STORE)
+		obj_store_obj_read_done(id);
+#endif
 
 		return 0;
 	}
 
+	if (offset == 0) {
+		read_start_ms = k_uptime_get();
+		read_bytes = 0;
+		atomic_set(&read_active, 1);
+	}
+
+#if defined(CONFIG_NODE_OBJ_STORE)
+	ssize_t ret = obj_store_obj_read(id, data, len, offset);
+
+	ARG_UNUSED(obj_index);
+	if (ret < 0) {
+		return ret;
+	}
+
+	len = ret;
+#elif defined(CONFIG_NODE_BENCH)
+	ARG_UNUSED(obj_index);
+	*data = &bench_pattern[offset % 256];
+	len = MIN(len, sizeof(bench_pattern) - (offset % 256));
+#else
 	*data = &objects[obj_index].data[offset];
+#endif
 
+#if defined(CONFIG_NODE_OTS_FRAGMENT_DEMO)
 	/* Send even-indexed objects in 20 byte packets
 	 * to demonstrate fragmented transmission.
 	 */
 	if ((obj_index % 2) == 0) {
 		len = (len < 20) ? len : 20;
 	}
+#endif
 
-	printk("Object with %s ID is being read\n"
-		"Offset = %lu, Length = %zu\n",
-		id_str, (long)offset, len);
+	read_bytes += len;
+
+	EVTLOG("Object 0x%x is being read, offset %u, length %u\n",
+	       (uint32_t)id, (uint32_t)offset, len);
 
 	return len;
 }
@@ -171,14 +244,10 @@ static ssize_t ots_obj_write(struct bt_ots *ots, struct bt_conn *conn,
 			     uint64_t id, const void *data, size_t len,
 			     off_t offset, size_t rem)
 {
-	char id_str[BT_OTS_OBJ_ID_STR_LEN];
 	uint32_t obj_index = OTS_OBJ_ID_TO_OBJ_IDX(id);
 
-	bt_ots_obj_id_to_str(id, id_str, sizeof(id_str));
-
-	printk("Object with %s ID is being written\n"
-		"Offset = %lu, Length = %zu, Remaining= %zu\n",
-		id_str, (long)offset, len, rem);
+	EVTLOG("Object 0x%x is being written, offset %u, length %u\n",
+	       (uint32_t)id, (uint32_t)offset, len);
 
 	(void)memcpy(&objects[obj_index].data[offset], data, len);
 
@@ -201,6 +270,10 @@ static int ots_obj_cal_checksum(struct bt_ots *ots, struct bt_conn *conn, uint64
 {
 	uint32_t obj_index = OTS_OBJ_ID_TO_OBJ_IDX(id);
 
+	if (IS_ENABLED(CONFIG_NODE_OBJ_STORE)) {
+		return obj_store_obj_checksum(id, offset, len, data);
+	}
+
 	if (obj_index >= OBJ_POOL_SIZE) {
 		return -ENOENT;
 	}
@@ -219,6 +292,45 @@ static struct bt_ots_cb ots_callbacks = {
 	.obj_cal_checksum = ots_obj_cal_checksum,
 };
 
+#if defined(CONFIG_NODE_BENCH)
+static int bench_objects_add(struct bt_ots *ots)
+{
+	struct object_creation_data obj_data;
+	struct bt_ots_obj_add_param param;
+	int err;
+
+	for (size_t i = 0; i < sizeof(bench_pattern); i++) {
+		bench_pattern[i] = (uint8_t)i;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(bench_sizes); i++) {
+		(void)snprintk(objects[i].name, sizeof(objects[i].name), "bench_%u.bin",
+			       bench_sizes[i]);
+
+		(void)memset(&obj_data, 0, sizeof(obj_data));
+		obj_data.name = objects[i].name;
+		obj_data.size.cur = bench_sizes[i];
+		obj_data.size.alloc = bench_sizes[i];
+		BT_OTS_OBJ_SET_PROP_READ(obj_data.props);
+		object_being_created = &obj_data;
+
+		param.size = bench_sizes[i];
+		param.type.uuid.type = BT_UUID_TYPE_16;
+		param.type.uuid_16.val = BT_UUID_OTS_TYPE_UNSPECIFIED_VAL;
+		err = bt_ots_obj_add(ots, &param);
+		object_being_created = NULL;
+		if (err < 0) {
+			printk("Failed to add benchmark object (err: %d)\n", err);
+			return err;
+		}
+	}
+
+	printk("Added %u benchmark objects\n", ARRAY_SIZE(bench_sizes));
+
+	return 0;
+}
+#endif /* CONFIG_NODE_BENCH */
+
 static int ots_init(void)
 {
 	int err;
@@ -254,6 +366,12 @@ static int ots_init(void)
 		return err;
 	}
 
+#if defined(CONFIG_NODE_OBJ_STORE)
+	return obj_store_init(ots);
+#elif defined(CONFIG_NODE_BENCH)
+	return bench_objects_add(ots);
+#endif
+
 	/* Prepare first object demo data and add it to the instance. */
 	cur_size = sizeof(objects[0].data) / 2;
 	alloc_size = sizeof(objects[0].data);
@@ -315,6 +433,36 @@ static int ots_init(void)
 	return 0;
 }
 
+static void radio_on(void)
+{
+	int err;
+
+	err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_1, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+	if (err) {
+		printk("Advertising failed to start (err %d)\n", err);
+	}
+}
+
+static void radio_off(void)
+{
+	(void)bt_le_adv_stop();
+
+	if (gateway_conn != NULL) {
+		(void)bt_conn_disconnect(gateway_conn, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	}
+}
+
+static bool transfer_active(void)
+{
+	return atomic_get(&read_active) != 0;
+}
+
+static const struct win_sched_cb win_sched_callbacks = {
+	.radio_on = radio_on,
+	.radio_off = radio_off,
+	.transfer_active = transfer_active,
+};
+
 int main(void)
 {
 	int err;
@@ -335,6 +483,20 @@ int main(void)
 		return 0;
 	}
 
+	if (IS_ENABLED(CONFIG_NODE_MTW)) {
+		err = mtw_init();
+		if (err) {
+			printk("Failed to init MTW (err:%d)\n", err);
+			return 0;
+		}
+	}
+
+	if (IS_ENABLED(CONFIG_NODE_WIN_SCHED)) {
+		win_sched_start(&win_sched_callbacks);
+		printk("Window scheduler started\n");
+		return 0;
+	}
+
 	err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_1, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
 	if (err) {
 		printk("Advertising failed to start (err %d)\n", err);
@@ -0,0 +1,878 @@
+/** @file
+ *  @brief OTS object store backed by a flash circular buffer
+ *
+ * Records are appended to an FCB on the storage partition. Only the
+ * oldest records, as many as the OTS object pool holds, are exposed as
+ * objects at a time. Deleting an object over OACP marks its record
+ * consumed and exposes the next one. Once every record of the oldest
+ * sector is consumed the sector is erased. Reads copy one SDU-sized chunk
+ * at a time out of flash, so RAM use does not grow with the backlog.
+ *
+ * The OTS server only asks for the next chunk once the previous one has
+ * been acknowledged by the gateway's link layer. If the link drops mid
+ * read, the record is exposed again starting at the first chunk that was
+ * not acknowledged, so the next connection does not resend the rest.
+ *
+ * Consumption survives a reboot through marker records in the ring itself:
+ * whenever the lowest sequence number not yet consumed advances, it is
+ * appended as a marker, and records below the newest marker are not
+ * exposed again. Records consumed out of order above it are.
+ *
+ * A sector whose object is being read cannot be erased, so a record that
+ * finds the ring full meanwhile waits in RAM until the read is over.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/devicetree.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include "crc32s.h"
+#include "evtlog.h"
+#include "lzc.h"
+#include "obj_resume.h"
+#include "obj_store.h"
+
+#define STORE_PARTITION_ID FIXED_PARTITION_ID(storage_partition)
+#define STORE_FCB_MAGIC    0x4f545331
+
+/* Internal record type; the payload is the consumed-sequence watermark. */
+#define STORE_TYPE_MARK 0xff
+
+/* Internal SoC flash is memory mapped, except for its simulation on POSIX
+ * boards, so checksums are computed over the record in place. The memory
+ * node only exists for a partition on the SoC's own flash; the MTD would be
+ * the flash controller.
+ */
+#define STORE_MEM DT_MEM_FROM_FIXED_PARTITION(DT_NODELABEL(storage_partition))
+#if DT_NODE_EXISTS(STORE_MEM) && !defined(CONFIG_ARCH_POSIX)
+#define STORE_FLASH_MAPPED 1
+#define STORE_FLASH_BASE   DT_REG_ADDR(STORE_MEM)
+#endif
+
+/* The directory listing object takes one entry of the OTS object pool. */
+#define STORE_SLOTS (CONFIG_BT_OTS_MAX_OBJ_CNT - IS_ENABLED(CONFIG_BT_OTS_DIR_LIST_OBJ))
+
+/* Largest flash write block the unaligned payload tail is padded to. */
+#define STORE_ALIGN_MAX 16
+
+/* Keeps the payload aligned for flash writes. */
+BUILD_ASSERT((sizeof(struct obj_store_hdr) % STORE_ALIGN_MAX) == 0);
+
+struct store_obj {
+	uint64_t id;
+	struct fcb_entry loc;
+	uint32_t seq;
+	/* Payload offset the object starts at, non-zero for a continuation. */
+	uint32_t start;
+	uint32_t size;
+#if defined(CONFIG_NODE_OBJ_RESUME)
+	/* Object bytes the gateway acknowledged during this connection. */
+	uint32_t acked;
+	/* Connections that read other objects but passed this continuation. */
+	uint8_t passed;
+#endif
+	char name[CONFIG_BT_OTS_OBJ_MAX_NAME_LEN + 1];
+	bool in_use;
+	/* The gateway is reading it; its sector cannot be erased meanwhile. */
+	bool reading;
+};
+
+#if CONFIG_NODE_OBJ_STORE_PENDING_SIZE > 0
+/* Record waiting for room in the ring, followed by its payload. */
+struct pending_rec {
+	struct obj_store_hdr hdr;
+	uint32_t len;
+};
+#endif
+
+static const char *const type_names[OBJ_STORE_TYPE_NUM] = {
+	[OBJ_STORE_ACCEL] = "acc",
+	[OBJ_STORE_PDM] = "pdm",
+	[OBJ_STORE_ADC] = "adc",
+};
+
+static struct fcb fcb;
+static struct flash_sector sectors[CONFIG_NODE_OBJ_STORE_MAX_SECTORS];
+static struct bt_ots *store_ots;
+static struct store_obj objs[STORE_SLOTS];
+/* Object being added; consumed by obj_store_obj_created(). */
+static struct store_obj *adding;
+/* Newest record exposed so far; a NULL sector means none. */
+static struct fcb_entry cursor;
+/* Sequence number of the record at the cursor, valid with its sector. */
+static uint32_t cursor_seq;
+static uint32_t next_seq;
+/* Every record below this sequence number is consumed, as last persisted. */
+static uint32_t consumed_seq;
+static uint32_t dropped_sectors;
+static uint8_t chunk[CONFIG_BT_OTS_L2CAP_CHAN_TX_MTU];
+#if !defined(STORE_FLASH_MAPPED)
+static uint8_t checksum_buf[CONFIG_NODE_OBJ_STORE_CHECKSUM_MAX];
+#endif
+#if CONFIG_NODE_OBJ_STORE_PENDING_SIZE > 0
+static uint8_t __aligned(4) pending[CONFIG_NODE_OBJ_STORE_PENDING_SIZE];
+static size_t pending_used;
+#endif
+/* Recursive, so OTS callbacks fired from our own OTS calls can take it. */
+static K_MUTEX_DEFINE(store_lock);
+static struct k_work store_work;
+static atomic_t conn_lost;
+#if defined(CONFIG_NODE_OBJ_RESUME)
+/* The gateway read at least one chunk during this connection. */
+static bool conn_read;
+#endif
+
+#if defined(CONFIG_NODE_OBJ_COMPRESS)
+static const struct bt_uuid_128 lzc_obj_type = BT_UUID_INIT_128(LZC_OBJ_TYPE_UUID_VAL);
+static struct lzc_enc lz_enc;
+static uint8_t lz_buf[CONFIG_NODE_OBJ_COMPRESS_BUF_SIZE];
+static uint64_t lz_raw_total;
+static uint64_t lz_stored_total;
+#endif
+
+static struct store_obj *slot_find(uint64_t id)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		if (objs[i].in_use && objs[i].id == id) {
+			return &objs[i];
+		}
+	}
+
+	return NULL;
+}
+
+static struct store_obj *slot_free(void)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		if (!objs[i].in_use) {
+			return &objs[i];
+		}
+	}
+
+	return NULL;
+}
+
+static bool sector_exposed(const struct flash_sector *sector)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		if (objs[i].in_use && objs[i].loc.fe_sector == sector) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* The gateway checks the data against the CRC tag without another request,
+ * and resumes a continuation from the offset in its name.
+ */
+static void store_name(struct store_obj *obj, const struct obj_store_hdr *hdr)
+{
+	const char *ext = ((hdr->flags & OBJ_STORE_FLAG_LZC) != 0) ? "lz" : "bin";
+	/* snprintk() returns the length it wanted, not what fit. */
+	const size_t max = sizeof(obj->name) - 1;
+	size_t n;
+
+	n = snprintk(obj->name, sizeof(obj->name), "%s_%08u", type_names[hdr->type], hdr->seq);
+	n = MIN(n, max);
+
+	if (obj->start > 0) {
+		n += snprintk(&obj->name[n], sizeof(obj->name) - n, OBJ_RESUME_NAME_FMT,
+			      obj->start);
+		n = MIN(n, max);
+	}
+
+	if ((hdr->flags & OBJ_STORE_FLAG_CRC) != 0) {
+		n += snprintk(&obj->name[n], sizeof(obj->name) - n, CRC32S_NAME_TAG_FMT, hdr->crc);
+		n = MIN(n, max);
+	}
+
+	(void)snprintk(&obj->name[n], sizeof(obj->name) - n, ".%s", ext);
+}
+
+/* Expose a record, or its tail from start on, as an OTS object. */
+static int store_add(struct store_obj *obj, const struct fcb_entry *loc,
+		     const struct obj_store_hdr *hdr, uint32_t start)
+{
+	struct bt_ots_obj_add_param param;
+	int err;
+
+	obj->loc = *loc;
+	obj->seq = hdr->seq;
+	obj->reading = false;
+	obj->start = start;
+	obj->size = loc->fe_data_len - sizeof(*hdr) - start;
+#if defined(CONFIG_NODE_OBJ_RESUME)
+	obj->acked = 0;
+	obj->passed = 0;
+#endif
+	store_name(obj, hdr);
+
+	(void)memset(&param, 0, sizeof(param));
+	param.size = obj->size;
+#if defined(CONFIG_NODE_OBJ_COMPRESS)
+	if ((hdr->flags & OBJ_STORE_FLAG_LZC) != 0) {
+		param.type.uuid_128 = lzc_obj_type;
+	} else
+#endif
+	{
+		param.type.uuid.type = BT_UUID_TYPE_16;
+		param.type.uuid_16.val = BT_UUID_OTS_TYPE_UNSPECIFIED_VAL;
+	}
+
+	adding = obj;
+	err = bt_ots_obj_add(store_ots, &param);
+	adding = NULL;
+
+	return (err < 0) ? err : 0;
+}
+
+/* Add records after the cursor as objects until the pool is full. */
+static void store_expose(void)
+{
+	struct obj_store_hdr hdr;
+	struct store_obj *obj;
+	struct fcb_entry loc = cursor;
+	int err;
+
+	while ((obj = slot_free()) != NULL) {
+		if (fcb_getnext(&fcb, &loc) != 0) {
+			break;
+		}
+
+		if (loc.fe_data_len < sizeof(hdr) ||
+		    flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), &hdr, sizeof(hdr)) != 0 ||
+		    hdr.type >= OBJ_STORE_TYPE_NUM) {
+			/* Unreadable record or a marker, skip it for good. */
+			cursor = loc;
+			continue;
+		}
+
+		if (hdr.seq < consumed_seq) {
+			/* Consumed before a reboot, but its sector not erased yet. */
+			cursor = loc;
+			cursor_seq = hdr.seq;
+			continue;
+		}
+
+		err = store_add(obj, &loc, &hdr, 0);
+		if (err < 0) {
+			/* Cursor stays put, the record is retried on the next pass. */
+			printk("Failed to expose stored record (err %d)\n", err);
+			break;
+		}
+
+		cursor = loc;
+		cursor_seq = hdr.seq;
+	}
+}
+
+/* Erase the oldest sector once the gateway has consumed all its records. */
+static void store_reclaim(void)
+{
+	while (cursor.fe_sector != NULL && fcb.f_oldest != cursor.fe_sector &&
+	       !sector_exposed(fcb.f_oldest)) {
+		if (fcb_rotate(&fcb) != 0) {
+			break;
+		}
+	}
+}
+
+#if defined(CONFIG_NODE_OBJ_RESUME)
+static void store_resume(void);
+#endif
+
+static int store_put(const struct obj_store_hdr *hdr, const void *data, size_t len,
+		     bool may_drop);
+static void store_mark_consumed(void);
+static void store_flush_pending(void);
+
+static void store_work_fn(struct k_work *work)
+{
+	k_mutex_lock(&store_lock, K_FOREVER);
+	if (atomic_clear(&conn_lost) != 0) {
+		for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+			objs[i].reading = false;
+		}
+#if defined(CONFIG_NODE_OBJ_RESUME)
+		store_resume();
+#endif
+	}
+	store_reclaim();
+	store_flush_pending();
+	store_expose();
+	store_mark_consumed();
+	k_mutex_unlock(&store_lock);
+}
+
+/* Make room by erasing the oldest sector, consumed or not. */
+static int store_drop_oldest(void)
+{
+	struct flash_sector *oldest = fcb.f_oldest;
+	int err;
+
+	/* Checked up front, so no object is deleted unless the sector goes. */
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		if (objs[i].in_use && objs[i].reading && objs[i].loc.fe_sector == oldest) {
+			return -EBUSY;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		if (objs[i].in_use && objs[i].loc.fe_sector == oldest) {
+			/* Also fails with -EBUSY while the object is being transferred. */
+			err = bt_ots_obj_delete(store_ots, objs[i].id);
+			if (err != 0) {
+				return err;
+			}
+		}
+	}
+
+	if (cursor.fe_sector == oldest) {
+		cursor.fe_sector = NULL;
+	}
+
+	dropped_sectors++;
+	EVTLOG("Object store full, dropped oldest sector (%u total)\n", dropped_sectors);
+
+	return fcb_rotate(&fcb);
+}
+
+static int store_write(off_t off, const uint8_t *data, size_t len)
+{
+	uint8_t tail[STORE_ALIGN_MAX];
+	size_t bulk = ROUND_DOWN(len, fcb.f_align);
+	int err;
+
+	if (bulk > 0) {
+		err = flash_area_write(fcb.fap, off, data, bulk);
+		if (err != 0) {
+			return err;
+		}
+	}
+
+	if (bulk == len) {
+		return 0;
+	}
+
+	(void)memset(tail, fcb.f_erase_value, sizeof(tail));
+	(void)memcpy(tail, &data[bulk], len - bulk);
+
+	return flash_area_write(fcb.fap, off + bulk, tail, fcb.f_align);
+}
+
+/* Append one record. Only measurements may erase unconsumed records. */
+static int store_put(const struct obj_store_hdr *hdr, const void *data, size_t len,
+		     bool may_drop)
+{
+	struct fcb_entry loc;
+	int err;
+
+	err = fcb_append(&fcb, sizeof(*hdr) + len, &loc);
+	if (err == -ENOSPC && may_drop) {
+		err = store_drop_oldest();
+		if (err == 0) {
+			err = fcb_append(&fcb, sizeof(*hdr) + len, &loc);
+		}
+	}
+
+	if (err != 0) {
+		return err;
+	}
+
+	err = store_write(FCB_ENTRY_FA_DATA_OFF(loc), (const uint8_t *)hdr, sizeof(*hdr));
+	if (err == 0) {
+		err = store_write(FCB_ENTRY_FA_DATA_OFF(loc) + sizeof(*hdr), data, len);
+	}
+
+	if (err == 0) {
+		err = fcb_append_finish(&fcb, &loc);
+	}
+
+	return err;
+}
+
+/* Lowest sequence number not consumed yet: exposed records, then the ones
+ * after the cursor.
+ */
+static uint32_t store_unconsumed_seq(void)
+{
+	uint32_t seq = (cursor.fe_sector != NULL) ? cursor_seq + 1 : consumed_seq;
+
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		if (objs[i].in_use) {
+			seq = MIN(seq, objs[i].seq);
+		}
+	}
+
+	return MAX(seq, consumed_seq);
+}
+
+/* Persist the watermark once it advanced. A full ring is not made room in
+ * for it; the next one carries it.
+ */
+static void store_mark_consumed(void)
+{
+	struct obj_store_hdr hdr = {
+		.type = STORE_TYPE_MARK,
+		.timestamp_ms = k_uptime_get_32(),
+	};
+	uint32_t seq = store_unconsumed_seq();
+	int err;
+
+	if (seq == consumed_seq) {
+		return;
+	}
+
+	hdr.seq = seq;
+	err = store_put(&hdr, &seq, sizeof(seq), false);
+	if (err != 0) {
+		printk("Failed to persist consumed records (err %d)\n", err);
+		return;
+	}
+
+	consumed_seq = seq;
+}
+
+#if CONFIG_NODE_OBJ_STORE_PENDING_SIZE > 0
+static size_t pending_size(size_t len)
+{
+	return ROUND_UP(sizeof(struct pending_rec) + len, 4);
+}
+
+/* Keep a record that found the ring full while its oldest sector is read. */
+static int store_queue(const struct obj_store_hdr *hdr, const void *data, size_t len)
+{
+	struct pending_rec *rec = (struct pending_rec *)&pending[pending_used];
+
+	if (pending_size(len) > sizeof(pending) - pending_used) {
+		return -ENOMEM;
+	}
+
+	rec->hdr = *hdr;
+	rec->len = len;
+	(void)memcpy(rec + 1, data, len);
+	pending_used += pending_size(len);
+
+	return 0;
+}
+
+/* Store queued records in order, as long as the ring takes them. */
+static void store_flush_pending(void)
+{
+	size_t done = 0;
+	int err = 0;
+
+	while (done < pending_used) {
+		struct pending_rec *rec = (struct pending_rec *)&pending[done];
+
+		err = store_put(&rec->hdr, rec + 1, rec->len, true);
+		if (err == -EBUSY) {
+			break;
+		}
+
+		if (err != 0) {
+			printk("Queued record %u lost (err %d)\n", rec->hdr.seq, err);
+		} else {
+			EVTLOG("Stored queued record %u, %u bytes\n", rec->hdr.seq, rec->len);
+		}
+
+		done += pending_size(rec->len);
+	}
+
+	(void)memmove(pending, &pending[done], pending_used - done);
+	pending_used -= done;
+}
+#else
+static int store_queue(const struct obj_store_hdr *hdr, const void *data, size_t len)
+{
+	return -ENOMEM;
+}
+
+static void store_flush_pending(void)
+{
+}
+#endif /* CONFIG_NODE_OBJ_STORE_PENDING_SIZE > 0 */
+
+static bool store_has_pending(void)
+{
+#if CONFIG_NODE_OBJ_STORE_PENDING_SIZE > 0
+	return pending_used > 0;
+#else
+	return false;
+#endif
+}
+
+#if defined(CONFIG_NODE_OBJ_COMPRESS)
+/* Swap in the compressed payload if it is smaller; reads serve it as is. */
+static void store_compress(struct obj_store_hdr *hdr, const void **data, size_t *len)
+{
+	int clen = -ENOSPC;
+
+	if (*len > LZC_HDR_SIZE) {
+		clen = lzc_compress(&lz_enc, *data, *len, lz_buf, MIN(*len - 1, sizeof(lz_buf)));
+	}
+
+	lz_raw_total += *len;
+	if (clen > 0) {
+		hdr->flags |= OBJ_STORE_FLAG_LZC;
+		*data = lz_buf;
+		*len = clen;
+	}
+
+	lz_stored_total += *len;
+
+	EVTLOG("Record %u stored in %u bytes, %u%% of raw overall\n", hdr->seq, *len,
+	       (uint32_t)((lz_stored_total * 100U) / lz_raw_total));
+}
+#endif /* CONFIG_NODE_OBJ_COMPRESS */
+
+int obj_store_append(enum obj_store_type type, const void *data, size_t len)
+{
+	struct obj_store_hdr hdr = {
+		.type = type,
+		.timestamp_ms = k_uptime_get_32(),
+	};
+	int err;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	/* Records queued earlier go first. */
+	store_flush_pending();
+
+	hdr.seq = next_seq;
+
+#if defined(CONFIG_NODE_OBJ_COMPRESS)
+	store_compress(&hdr, &data, &len);
+#endif
+
+#if defined(CONFIG_NODE_OBJ_CRC)
+	/* Computed once here; reads and checksum requests never walk it again. */
+	hdr.crc = crc32s_update(0, data, len);
+	hdr.flags |= OBJ_STORE_FLAG_CRC;
+#endif
+
+	err = store_has_pending() ? -EBUSY : store_put(&hdr, data, len, true);
+	if (err == -EBUSY) {
+		/* The oldest sector is being read; store the record once it is not. */
+		err = store_queue(&hdr, data, len);
+		if (err == 0) {
+			next_seq++;
+			EVTLOG("Object store busy, record %u queued\n", hdr.seq);
+			goto unlock;
+		}
+	}
+
+	if (err != 0) {
+		printk("Object store append failed (err %d)\n", err);
+		goto unlock;
+	}
+
+	next_seq++;
+	EVTLOG("Stored record %u, type %u, %u bytes\n", hdr.seq, type, len);
+
+	store_expose();
+
+unlock:
+	k_mutex_unlock(&store_lock);
+
+	return err;
+}
+
+int obj_store_obj_created(uint64_t id, const struct bt_ots_obj_add_param *add_param,
+			  struct bt_ots_obj_created_desc *created_desc)
+{
+	if (adding == NULL) {
+		/* Objects are only created by measurements, not over OACP. */
+		return -ENOTSUP;
+	}
+
+	adding->id = id;
+	adding->in_use = true;
+
+	created_desc->name = adding->name;
+	created_desc->size.cur = adding->size;
+	created_desc->size.alloc = adding->size;
+	BT_OTS_OBJ_SET_PROP_READ(created_desc->props);
+	BT_OTS_OBJ_SET_PROP_DELETE(created_desc->props);
+
+	return 0;
+}
+
+int obj_store_obj_deleted(uint64_t id)
+{
+	struct store_obj *obj;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	obj = slot_find(id);
+	if (obj != NULL) {
+		obj->in_use = false;
+		k_work_submit(&store_work);
+	}
+
+	k_mutex_unlock(&store_lock);
+
+	return (obj != NULL) ? 0 : -ENOENT;
+}
+
+static int store_read_chunk(uint64_t id, off_t offset, size_t len)
+{
+	struct store_obj *obj;
+	int err;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	obj = slot_find(id);
+	if (obj == NULL || offset >= obj->size) {
+		err = -ENOENT;
+		goto unlock;
+	}
+
+	len = MIN(len, obj->size - offset);
+	err = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(obj->loc) + sizeof(struct obj_store_hdr) +
+				       obj->start + offset, chunk, len);
+
+unlock:
+	k_mutex_unlock(&store_lock);
+
+	return (err == 0) ? (int)len : err;
+}
+
+ssize_t obj_store_obj_read(uint64_t id, void **data, size_t len, off_t offset)
+{
+	struct store_obj *obj;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	obj = slot_find(id);
+	if (obj != NULL) {
+		obj->reading = true;
+#if defined(CONFIG_NODE_OBJ_RESUME)
+		/* Asked for this chunk, so everything before it was acknowledged. */
+		obj->acked = MAX(obj->acked, (uint32_t)offset);
+#endif
+	}
+
+#if defined(CONFIG_NODE_OBJ_RESUME)
+	conn_read = true;
+#endif
+
+	k_mutex_unlock(&store_lock);
+
+	*data = chunk;
+
+	return store_read_chunk(id, offset, MIN(len, sizeof(chunk)));
+}
+
+void obj_store_obj_read_done(uint64_t id)
+{
+	struct store_obj *obj;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	obj = slot_find(id);
+	if (obj != NULL) {
+		obj->reading = false;
+#if defined(CONFIG_NODE_OBJ_RESUME)
+		obj->acked = obj->size;
+#endif
+	}
+
+	if (store_has_pending()) {
+		k_work_submit(&store_work);
+	}
+
+	k_mutex_unlock(&store_lock);
+}
+
+#if defined(CONFIG_NODE_OBJ_RESUME)
+/* Expose the record of obj again from the given payload offset. */
+static int store_readd(struct store_obj *obj, uint32_t start)
+{
+	struct fcb_entry loc = obj->loc;
+	struct obj_store_hdr hdr;
+	int err;
+
+	err = flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), &hdr, sizeof(hdr));
+	if (err == 0) {
+		/* Frees the slot; the record stays unconsumed. */
+		err = bt_ots_obj_delete(store_ots, obj->id);
+	}
+
+	if (err == 0) {
+		err = store_add(obj, &loc, &hdr, start);
+	}
+
+	return err;
+}
+
+static void store_resume(void)
+{
+	struct store_obj *obj;
+	uint32_t start;
+	int err;
+
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		obj = &objs[i];
+
+		if (!obj->in_use || obj->acked >= obj->size) {
+			continue;
+		}
+
+		if (obj->acked > 0) {
+			start = obj->start + obj->acked;
+		} else if (obj->start > 0 && conn_read &&
+			   ++obj->passed >= CONFIG_NODE_OBJ_RESUME_MAX_PASSED) {
+			/* The gateway keeps reading around this continuation, so
+			 * it has most likely lost the part it had: start over.
+			 */
+			start = 0;
+		} else {
+			continue;
+		}
+
+		err = store_readd(obj, start);
+		if (err != 0) {
+			printk("Failed to re-expose record at offset %u (err %d)\n", start, err);
+			continue;
+		}
+
+		EVTLOG("Record re-exposed from offset %u, %u bytes left\n", start, obj->size);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(objs); i++) {
+		objs[i].acked = 0;
+	}
+
+	conn_read = false;
+}
+#endif /* CONFIG_NODE_OBJ_RESUME */
+
+void obj_store_conn_lost(void)
+{
+	/* Objects are deleted and added from the workqueue, not the RX thread. */
+	atomic_set(&conn_lost, 1);
+	k_work_submit(&store_work);
+}
+
+int obj_store_obj_checksum(uint64_t id, off_t offset, size_t len, void **data)
+{
+	struct store_obj *obj;
+	off_t off;
+	int err = 0;
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+
+	obj = slot_find(id);
+	if (obj == NULL || offset < 0 || (size_t)offset > obj->size ||
+	    len > obj->size - (size_t)offset) {
+		err = -EINVAL;
+		goto unlock;
+	}
+
+	off = FCB_ENTRY_FA_DATA_OFF(obj->loc) + sizeof(struct obj_store_hdr) + obj->start + offset;
+
+#if defined(STORE_FLASH_MAPPED)
+	*data = (void *)(uintptr_t)(STORE_FLASH_BASE + fcb.fap->fa_off + off);
+#else
+	if (len > sizeof(checksum_buf)) {
+		err = -ENOMEM;
+		goto unlock;
+	}
+
+	err = flash_area_read(fcb.fap, off, checksum_buf, len);
+	*data = checksum_buf;
+#endif
+
+unlock:
+	k_mutex_unlock(&store_lock);
+
+	return err;
+}
+
+int obj_store_init(struct bt_ots *ots)
+{
+	struct obj_store_hdr hdr;
+	struct fcb_entry loc = {0};
+	uint32_t sector_cnt = ARRAY_SIZE(sectors);
+	uint32_t records = 0;
+	int err;
+
+	err = flash_area_get_sectors(STORE_PARTITION_ID, &sector_cnt, sectors);
+	if (err != 0) {
+		printk("Failed to get object store sectors (err %d)\n", err);
+		return err;
+	}
+
+	fcb.f_magic = STORE_FCB_MAGIC;
+	fcb.f_sectors = sectors;
+	fcb.f_sector_cnt = sector_cnt;
+
+	err = fcb_init(STORE_PARTITION_ID, &fcb);
+	if (err != 0) {
+		/* Partition holds something else; start over with an empty ring. */
+		const struct flash_area *fa;
+
+		printk("Object store unreadable (err %d), erasing\n", err);
+
+		err = flash_area_open(STORE_PARTITION_ID, &fa);
+		if (err == 0) {
+			err = flash_area_erase(fa, 0, fa->fa_size);
+			flash_area_close(fa);
+		}
+
+		if (err == 0) {
+			err = fcb_init(STORE_PARTITION_ID, &fcb);
+		}
+	}
+
+	if (err != 0) {
+		printk("Failed to init object store (err %d)\n", err);
+		return err;
+	}
+
+	if (fcb.f_align > STORE_ALIGN_MAX) {
+		return -ENOTSUP;
+	}
+
+	/* Continue the sequence numbers of the records kept across reboots, and
+	 * skip those the newest marker says were consumed.
+	 */
+	while (fcb_getnext(&fcb, &loc) == 0) {
+		if (flash_area_read(fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), &hdr, sizeof(hdr)) != 0) {
+			continue;
+		}
+
+		if (hdr.type == STORE_TYPE_MARK) {
+			consumed_seq = MAX(consumed_seq, hdr.seq);
+			continue;
+		}
+
+		next_seq = MAX(next_seq, hdr.seq + 1);
+		records++;
+	}
+
+	/* Markers may outlive the records they covered. */
+	next_seq = MAX(next_seq, consumed_seq);
+
+	printk("Object store: %u records in %u sectors, consumed below %u\n", records,
+	       sector_cnt, consumed_seq);
+
+	store_ots = ots;
+	k_work_init(&store_work, store_work_fn);
+
+	k_mutex_lock(&store_lock, K_FOREVER);
+	store_expose();
+	k_mutex_unlock(&store_lock);
+
+	return 0;
+}
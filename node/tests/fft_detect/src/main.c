@@ -0,0 +1,151 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include "fft_detect.h"
+
+#define BINS       (FFT_DETECT_LEN / 2)
+#define BAND_WIDTH (BINS / CONFIG_NODE_FFT_BANDS)
+#define THRESHOLD  CONFIG_NODE_FFT_THRESHOLD
+
+/* A sine of amplitude A reads A / 2 in its bin. */
+#define MAG(amplitude) ((amplitude) / 2)
+
+/* Write a sine that completes bin periods per capture, on top of offset. */
+static void tone(uint32_t bin, int32_t amplitude, int32_t offset)
+{
+	int16_t *capture = fft_detect_capture_buf();
+
+	for (size_t i = 0; i < FFT_DETECT_LEN; i++) {
+		double phase = (2.0 * M_PI * bin * i) / FFT_DETECT_LEN + 0.3;
+
+		capture[i] = (int16_t)CLAMP(lround(sin(phase) * amplitude) + offset, INT16_MIN,
+					    INT16_MAX);
+	}
+}
+
+static void run(struct fft_detect_result *result)
+{
+	(void)memset(result, 0x5a, sizeof(*result));
+	fft_detect_run(result);
+}
+
+ZTEST(fft_detect, test_silence)
+{
+	struct fft_detect_result result;
+
+	(void)memset(fft_detect_capture_buf(), 0, FFT_DETECT_LEN * sizeof(int16_t));
+	run(&result);
+
+	zassert_equal(result.peak_mag, 0);
+	zassert_false(result.anomaly);
+
+	for (size_t b = 0; b < CONFIG_NODE_FFT_BANDS; b++) {
+		zassert_equal(result.band_energy[b], 0, "band %zu", b);
+	}
+}
+
+ZTEST(fft_detect, test_peak_bin)
+{
+	static const uint16_t bins[] = {1, 5, 100, 255, 256, 300, BINS - 1};
+	struct fft_detect_result result;
+
+	for (size_t i = 0; i < ARRAY_SIZE(bins); i++) {
+		tone(bins[i], 16000, 0);
+		run(&result);
+
+		zassert_equal(result.peak_bin, bins[i], "bin %u: peak at %u", bins[i],
+			      result.peak_bin);
+		zassert_within(result.peak_mag, MAG(16000), 200, "bin %u: magnitude %u", bins[i],
+			       result.peak_mag);
+	}
+}
+
+ZTEST(fft_detect, test_full_scale)
+{
+	struct fft_detect_result result;
+
+	tone(64, INT16_MAX, 0);
+	run(&result);
+
+	zassert_equal(result.peak_bin, 64);
+	zassert_within(result.peak_mag, 16384, 200, "magnitude %u", result.peak_mag);
+	zassert_true(result.anomaly);
+}
+
+ZTEST(fft_detect, test_bands)
+{
+	struct fft_detect_result result;
+
+	for (size_t b = 0; b < CONFIG_NODE_FFT_BANDS; b++) {
+		/* Middle of the band, well clear of its neighbours. */
+		tone(b * BAND_WIDTH + BAND_WIDTH / 2, 16000, 0);
+		run(&result);
+
+		for (size_t other = 0; other < CONFIG_NODE_FFT_BANDS; other++) {
+			if (other != b) {
+				zassert_true(result.band_energy[b] > 100 * result.band_energy[other],
+					     "tone in band %zu, band %zu too loud", b, other);
+			}
+		}
+	}
+}
+
+/* Gravity is a constant offset on the axis, not a vibration. */
+ZTEST(fft_detect, test_dc_ignored)
+{
+	struct fft_detect_result result;
+
+	tone(0, 0, 16000);
+	run(&result);
+
+	zassert_true(result.peak_mag < 100, "magnitude %u", result.peak_mag);
+	zassert_false(result.anomaly);
+
+	tone(40, 4000, 16000);
+	run(&result);
+
+	zassert_equal(result.peak_bin, 40);
+	zassert_within(result.peak_mag, MAG(4000), 100, "magnitude %u", result.peak_mag);
+}
+
+ZTEST(fft_detect, test_threshold)
+{
+	struct fft_detect_result result;
+
+	/* 5 % either side of the threshold. */
+	tone(100, 2 * THRESHOLD * 105 / 100, 0);
+	run(&result);
+	zassert_true(result.anomaly, "magnitude %u", result.peak_mag);
+
+	tone(100, 2 * THRESHOLD * 95 / 100, 0);
+	run(&result);
+	zassert_false(result.anomaly, "magnitude %u", result.peak_mag);
+
+	/* A lower threshold turns the same capture into an anomaly. */
+	fft_detect_set_threshold(THRESHOLD * 90 / 100);
+	tone(100, 2 * THRESHOLD * 95 / 100, 0);
+	run(&result);
+	zassert_true(result.anomaly, "magnitude %u", result.peak_mag);
+}
+
+static void *fft_detect_setup(void)
+{
+	zassert_ok(fft_detect_init());
+
+	return NULL;
+}
+
+static void fft_detect_after(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	fft_detect_set_threshold(THRESHOLD);
+}
+
+ZTEST_SUITE(fft_detect, NULL, fft_detect_setup, NULL, fft_detect_after, NULL);
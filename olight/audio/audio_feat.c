@@ -0,0 +1,247 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/stats/stats.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_CMSIS_DSP)
+#include <arm_math.h>
+#endif
+
+#include "audio_feat.h"
+#include "pdm.h"
+#include "q15_fft.h"
+
+LOG_MODULE_REGISTER(audio_feat, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* Spectrum bins are 31.25 Hz wide; DC is skipped and the top band ends at fs / 2. */
+#define BAND_EDGE_TOP 256
+
+static const uint16_t band_edge[] = {1, 8, 16, 32, 64, 128, BAND_EDGE_TOP};
+
+BUILD_ASSERT(ARRAY_SIZE(band_edge) == AUDIO_FEAT_BANDS + 1);
+BUILD_ASSERT(BAND_EDGE_TOP <= AUDIO_FEAT_FFT_LEN / 2);
+
+STATS_SECT_START(audio_feat_stats)
+STATS_SECT_ENTRY(blocks)
+STATS_SECT_ENTRY(rms)
+STATS_SECT_ENTRY(zcr)
+STATS_SECT_ENTRY(band0)
+STATS_SECT_ENTRY(band1)
+STATS_SECT_ENTRY(band2)
+STATS_SECT_ENTRY(band3)
+STATS_SECT_ENTRY(band4)
+STATS_SECT_ENTRY(band5)
+STATS_SECT_END;
+
+STATS_NAME_START(audio_feat_stats)
+STATS_NAME(audio_feat_stats, blocks)
+STATS_NAME(audio_feat_stats, rms)
+STATS_NAME(audio_feat_stats, zcr)
+STATS_NAME(audio_feat_stats, band0)
+STATS_NAME(audio_feat_stats, band1)
+STATS_NAME(audio_feat_stats, band2)
+STATS_NAME(audio_feat_stats, band3)
+STATS_NAME(audio_feat_stats, band4)
+STATS_NAME(audio_feat_stats, band5)
+STATS_NAME_END(audio_feat_stats);
+
+STATS_SECT_DECL(audio_feat_stats) audio_feat_stats;
+
+/* Interleaved re/im spectrum, AUDIO_FEAT_FFT_LEN complex bins. */
+static int16_t spectrum[2 * AUDIO_FEAT_FFT_LEN];
+
+static struct audio_feat latest;
+static bool have_latest;
+static struct k_spinlock lock;
+
+Q15_FFT_DEFINE(fft, AUDIO_FEAT_FFT_LEN);
+
+#if defined(CONFIG_CMSIS_DSP_TRANSFORMS)
+/* arm_rfft_q15() modifies its source, so every frame is copied first. */
+static int16_t frame[AUDIO_FEAT_FFT_LEN];
+#else
+/* The portable FFT spreads the frame out in place. */
+static int16_t *const frame = spectrum;
+#endif
+
+static void fft_transform(const int16_t *samples)
+{
+	(void)memcpy(frame, samples, AUDIO_FEAT_FFT_LEN * sizeof(int16_t));
+
+	q15_fft_run(&fft, frame, spectrum);
+}
+
+static uint64_t sum_of_squares(const int16_t *samples, size_t count)
+{
+#if defined(CONFIG_CMSIS_DSP)
+	q63_t power;
+
+	/* Dual 16-bit MACs; the Q30 products sum up to the plain integer sum. */
+	arm_power_q15(samples, count, &power);
+
+	return (uint64_t)power;
+#else
+	uint64_t sum = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		sum += (uint64_t)((int32_t)samples[i] * samples[i]);
+	}
+
+	return sum;
+#endif
+}
+
+static uint32_t isqrt64(uint64_t x)
+{
+	uint64_t root = 0;
+	uint64_t bit = 1ULL << 62;
+
+	while (bit > x) {
+		bit >>= 2;
+	}
+
+	while (bit != 0) {
+		if (x >= root + bit) {
+			x -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+
+		bit >>= 2;
+	}
+
+	return (uint32_t)root;
+}
+
+/* log2 in Q8, with the fraction linearly interpolated between powers of two. */
+static uint16_t log2_q8(uint64_t x)
+{
+	uint32_t n;
+	uint32_t frac;
+
+	if (x == 0) {
+		return 0;
+	}
+
+	n = 63 - __builtin_clzll(x);
+	frac = (uint32_t)((n >= 8) ? (x >> (n - 8)) : (x << (8 - n))) & 0xff;
+
+	return (uint16_t)((n << 8) | frac);
+}
+
+void audio_feat_compute(const int16_t *samples, size_t count, uint32_t seq,
+			struct audio_feat *feat)
+{
+	uint64_t band_energy[AUDIO_FEAT_BANDS] = {0};
+	uint32_t crossings = 0;
+
+	(void)memset(feat, 0, sizeof(*feat));
+	feat->seq = seq;
+
+	if (count == 0) {
+		return;
+	}
+
+	feat->rms = (uint16_t)MIN(isqrt64(sum_of_squares(samples, count) / count), UINT16_MAX);
+
+	for (size_t i = 1; i < count; i++) {
+		if ((samples[i - 1] < 0) != (samples[i] < 0)) {
+			crossings++;
+		}
+	}
+
+	feat->zcr = (uint16_t)((crossings * 1000U) / count);
+
+	/* Sum the spectra of every whole frame in the block. */
+	for (size_t off = 0; off + AUDIO_FEAT_FFT_LEN <= count; off += AUDIO_FEAT_FFT_LEN) {
+		fft_transform(&samples[off]);
+
+		for (size_t b = 0; b < AUDIO_FEAT_BANDS; b++) {
+			for (size_t k = band_edge[b]; k < band_edge[b + 1]; k++) {
+				int32_t re = spectrum[2 * k];
+				int32_t im = spectrum[2 * k + 1];
+
+				band_energy[b] += (uint32_t)(re * re) + (uint32_t)(im * im);
+			}
+		}
+	}
+
+	for (size_t b = 0; b < AUDIO_FEAT_BANDS; b++) {
+		feat->band[b] = log2_q8(band_energy[b]);
+	}
+}
+
+int audio_feat_latest(struct audio_feat *feat)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	int rc = have_latest ? 0 : -ENODATA;
+
+	*feat = latest;
+
+	k_spin_unlock(&lock, key);
+
+	return rc;
+}
+
+static void on_pdm_block(struct pdm_consumer *consumer, const struct pdm_block *block)
+{
+	struct audio_feat feat;
+	k_spinlock_key_t key;
+
+	audio_feat_compute(block->samples, block->size / sizeof(int16_t), block->seq, &feat);
+
+	key = k_spin_lock(&lock);
+	latest = feat;
+	have_latest = true;
+	k_spin_unlock(&lock, key);
+
+	STATS_INC(audio_feat_stats, blocks);
+	STATS_SET(audio_feat_stats, rms, feat.rms);
+	STATS_SET(audio_feat_stats, zcr, feat.zcr);
+	STATS_SET(audio_feat_stats, band0, feat.band[0]);
+	STATS_SET(audio_feat_stats, band1, feat.band[1]);
+	STATS_SET(audio_feat_stats, band2, feat.band[2]);
+	STATS_SET(audio_feat_stats, band3, feat.band[3]);
+	STATS_SET(audio_feat_stats, band4, feat.band[4]);
+	STATS_SET(audio_feat_stats, band5, feat.band[5]);
+
+	LOG_DBG("%u: rms %u zcr %u bands %u %u %u %u %u %u", feat.seq, feat.rms, feat.zcr,
+		feat.band[0], feat.band[1], feat.band[2], feat.band[3], feat.band[4],
+		feat.band[5]);
+}
+
+static struct pdm_consumer feat_consumer = {
+	.consume = on_pdm_block,
+};
+
+static int audio_feat_init(void)
+{
+	int rc;
+
+	rc = q15_fft_init(&fft);
+	if (rc < 0) {
+		LOG_ERR("Failed to init FFT [%d]", rc);
+		return rc;
+	}
+
+	rc = STATS_INIT_AND_REG(audio_feat_stats, STATS_SIZE_32, "audio_feat");
+	if (rc < 0) {
+		LOG_ERR("Error initializing audio stats [%d]", rc);
+	}
+
+	/* Registered before the PDM threads start capturing. */
+	pdm_consumer_register(&feat_consumer);
+
+	return 0;
+}
+
+SYS_INIT(audio_feat_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -11,11 +11,21 @@
 #include <zephyr/bluetooth/hci.h>
 #include <zephyr/mgmt/mcumgr/transport/smp_bt.h>
 
+#include "ble_sched.h"
+#include "common.h"
+
 #define LOG_LEVEL LOG_LEVEL_DBG
 #include <zephyr/logging/log.h>
 LOG_MODULE_REGISTER(smp_bt_sample);
 
-static struct k_work advertise_work;
+/* Advertising interval in 0.625 ms units. */
+#define ADV_INTERVAL(ms) (((ms) * 8) / 5)
+
+static void start_advertising(struct k_work *work);
+static void stop_advertising(struct k_work *work);
+
+static K_WORK_DEFINE(advertise_work, start_advertising);
+static K_WORK_DEFINE(stop_advertise_work, stop_advertising);
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -26,25 +36,132 @@ static const struct bt_data sd[] = {
 	BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
 };
 
+/* Uptime in ticks when the current active window was requested. */
+static int64_t wake_ticks;
+static uint32_t wake_latency_us;
+
+/* Advertising is wanted: the active window is open. */
+static bool adv_active;
+
+static void conn_count(struct bt_conn *conn, void *data)
+{
+	(*(int *)data)++;
+}
+
+/* Any connection, until it is recycled; on_conn_recycled() restarts advertising. */
+static bool conn_active(void)
+{
+	int count = 0;
+
+	bt_conn_foreach(BT_CONN_TYPE_LE, conn_count, &count);
+
+	return count > 0;
+}
+
+#if defined(CONFIG_OLIGHT_BT_KEEP_ALIVE)
+static struct bt_le_ext_adv *adv_set;
+
+static int adv_set_start(uint32_t interval_ms)
+{
+	const struct bt_le_adv_param param = BT_LE_ADV_PARAM_INIT(
+		BT_LE_ADV_OPT_CONN, ADV_INTERVAL(interval_ms), ADV_INTERVAL(interval_ms), NULL);
+	int rc;
+
+	rc = bt_le_ext_adv_stop(adv_set);
+	if (rc == 0)
+	{
+		rc = bt_le_ext_adv_update_param(adv_set, &param);
+	}
+
+	if (rc == 0)
+	{
+		rc = bt_le_ext_adv_start(adv_set, BT_LE_EXT_ADV_START_DEFAULT);
+	}
+
+	return rc;
+}
+#endif
+
 static void start_advertising(struct k_work *work)
 {
 	int rc;
 
+	if (conn_active())
+	{
+		/* No free connection to advertise for; the manager is already here. */
+		wake_ticks = 0;
+		return;
+	}
+
+#if defined(CONFIG_OLIGHT_BT_KEEP_ALIVE)
+	if (adv_set == NULL)
+	{
+		rc = bt_le_ext_adv_create(BT_LE_ADV_CONN_FAST_1, NULL, &adv_set);
+		if (rc == 0)
+		{
+			rc = bt_le_ext_adv_set_data(adv_set, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+		}
+
+		if (rc)
+		{
+			LOG_ERR("Advertising set creation failed (rc %d)", rc);
+			wake_ticks = 0;
+			return;
+		}
+	}
+
+	rc = adv_set_start(CONFIG_OLIGHT_ADV_INTERVAL_MS);
+#else
 	rc = bt_le_adv_start(BT_LE_ADV_CONN_FAST_1, ad, ARRAY_SIZE(ad), sd, ARRAY_SIZE(sd));
+#endif
 	if (rc)
 	{
 		LOG_ERR("Advertising failed to start (rc %d)", rc);
+		/* Not a wake latency any more once the next window starts. */
+		wake_ticks = 0;
 		return;
 	}
 
-	LOG_INF("Advertising successfully started");
+	if (wake_ticks != 0)
+	{
+		wake_latency_us = k_ticks_to_us_ceil32(k_uptime_ticks() - wake_ticks);
+		wake_ticks = 0;
+		LOG_INF("Advertising started %u us after wake", wake_latency_us);
+	}
+	else
+	{
+		LOG_INF("Advertising successfully started");
+	}
 }
 
 static void stop_advertising(struct k_work *work)
 {
 	int rc;
 
+#if defined(CONFIG_OLIGHT_BT_KEEP_ALIVE)
+	if (adv_set == NULL)
+	{
+		return;
+	}
+
+	if (CONFIG_OLIGHT_SLEEP_ADV_INTERVAL_MS > 0 && conn_active())
+	{
+		/* Advertising stopped when the connection came in and stays off. */
+		return;
+	}
+
+	if (CONFIG_OLIGHT_SLEEP_ADV_INTERVAL_MS > 0)
+	{
+		/* Stay discoverable, but at a fraction of the radio time. */
+		rc = adv_set_start(CONFIG_OLIGHT_SLEEP_ADV_INTERVAL_MS);
+	}
+	else
+	{
+		rc = bt_le_ext_adv_stop(adv_set);
+	}
+#else
 	rc = bt_le_adv_stop();
+#endif
 	if (rc)
 	{
 		LOG_ERR("Advertising failed to stop (rc %d)", rc);
@@ -54,18 +171,20 @@ static void stop_advertising(struct k_work *work)
 	LOG_INF("Advertising successfully stopped");
 }
 
-
-
 static void connected(struct bt_conn *conn, uint8_t err)
 {
 	if (err)
 	{
 		LOG_ERR("Connection failed, err 0x%02x %s", err, bt_hci_err_to_str(err));
-		k_work_submit(&advertise_work);
+		if (adv_active)
+		{
+			k_work_submit(&advertise_work);
+		}
 	}
 	else
 	{
 		LOG_INF("Connected");
+		ble_sched_activity();
 	}
 }
 
@@ -76,7 +195,14 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 
 static void on_conn_recycled(void)
 {
-	k_work_submit(&advertise_work);
+	if (adv_active)
+	{
+		k_work_submit(&advertise_work);
+	}
+	else if (IS_ENABLED(CONFIG_OLIGHT_BT_KEEP_ALIVE) && CONFIG_OLIGHT_SLEEP_ADV_INTERVAL_MS > 0)
+	{
+		k_work_submit(&stop_advertise_work);
+	}
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
@@ -101,8 +227,15 @@ void start_smp_bluetooth_adverts(void)
 {
 	int rc;
 
-	k_work_init(&advertise_work, start_advertising
-);
+	wake_ticks = k_uptime_ticks();
+	adv_active = true;
+
+	if (IS_ENABLED(CONFIG_OLIGHT_BT_KEEP_ALIVE) && bt_is_ready())
+	{
+		k_work_submit(&advertise_work);
+		return;
+	}
+
 	rc = bt_enable(bt_ready);
 
 	if (rc != 0)
@@ -115,7 +248,15 @@ void stop_smp_bluetooth_adverts(void)
 {
 	int rc;
 
-	k_work_init(&advertise_work, stop_advertising);
+	adv_active = false;
+
+	if (IS_ENABLED(CONFIG_OLIGHT_BT_KEEP_ALIVE))
+	{
+		/* The stack stays up; only advertising is toggled. */
+		k_work_submit(&stop_advertise_work);
+		return;
+	}
+
 	rc = bt_disable();
 
 	if (rc != 0)
@@ -123,3 +264,8 @@ void stop_smp_bluetooth_adverts(void)
 		LOG_ERR("Bluetooth disable failed: %d", rc);
 	}
 }
+
+uint32_t smp_bluetooth_wake_latency_us(void)
+{
+	return wake_latency_us;
+}
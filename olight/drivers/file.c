@@ -1,7 +1,11 @@
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/fs/fs.h>
+#include <zephyr/storage/flash_map.h>
+#include <stdlib.h>
+#include <string.h>
 #include "file.h"
+#include "perf.h"
 
 LOG_MODULE_REGISTER(file, CONFIG_LOG_DEFAULT_LEVEL);
 
@@ -67,6 +71,369 @@ int create_file(const char *dir_path, const char *file_name, const void *data, s
     return 0;
 }
 
+#if defined(CONFIG_FS_LITTLEFS_PROG_SIZE)
+// Whole staging buffers map onto whole LittleFS program units
+BUILD_ASSERT((CONFIG_OLIGHT_LOG_STAGE_SIZE % CONFIG_FS_LITTLEFS_PROG_SIZE) == 0,
+             "CONFIG_OLIGHT_LOG_STAGE_SIZE must be a multiple of the LittleFS program size");
+#endif
+
+#define SEGMENT_PREFIX "seg"
+
+static int segment_path(const struct log_writer *lw, char *path, size_t len)
+{
+    int rc = snprintf(path, len, "%s/" SEGMENT_PREFIX "%05u.log", lw->dir_path, lw->segment);
+
+    if (rc < 0 || (size_t)rc >= len) {
+        return -ENAMETOOLONG;
+    }
+
+    return 0;
+}
+
+static int segment_open(struct log_writer *lw)
+{
+    char path[MAX_PATH_LEN];
+    struct fs_dirent entry;
+    int rc;
+
+    rc = segment_path(lw, path, sizeof(path));
+    if (rc < 0) {
+        return rc;
+    }
+
+    fs_file_t_init(&lw->file);
+    rc = fs_open(&lw->file, path, FS_O_CREATE | FS_O_WRITE | FS_O_APPEND);
+    if (rc < 0) {
+        LOG_ERR("Failed to open %s: %d", path, rc);
+        return rc;
+    }
+
+    rc = fs_stat(path, &entry);
+    if (rc < 0) {
+        LOG_ERR("Failed to stat %s: %d", path, rc);
+        fs_close(&lw->file);
+        return rc;
+    }
+
+    lw->segment_size = entry.size;
+    lw->open = true;
+
+    LOG_DBG("Log segment %s at %zu bytes", path, lw->segment_size);
+    return 0;
+}
+
+// Newest segment in the directory, 0 if there is none yet
+static int segment_find_last(const char *dir_path, uint32_t *segment)
+{
+    struct fs_dir_t dir;
+    struct fs_dirent entry;
+    int rc;
+
+    *segment = 0;
+
+    fs_dir_t_init(&dir);
+    rc = fs_opendir(&dir, dir_path);
+    if (rc < 0) {
+        return rc;
+    }
+
+    while ((rc = fs_readdir(&dir, &entry)) == 0 && entry.name[0] != '\0') {
+        if (entry.type == FS_DIR_ENTRY_FILE &&
+            strncmp(entry.name, SEGMENT_PREFIX, strlen(SEGMENT_PREFIX)) == 0) {
+            uint32_t n = strtoul(entry.name + strlen(SEGMENT_PREFIX), NULL, 10);
+
+            *segment = MAX(*segment, n);
+        }
+    }
+
+    fs_closedir(&dir);
+    return rc;
+}
+
+static int stage_write(struct log_writer *lw)
+{
+    ssize_t rc;
+
+    if (lw->staged == 0) {
+        return 0;
+    }
+
+    rc = fs_write(&lw->file, lw->stage, lw->staged);
+    if (rc < 0) {
+        LOG_ERR("Failed to write log segment %u: %d", lw->segment, (int)rc);
+        return (int)rc;
+    }
+
+    if ((size_t)rc != lw->staged) {
+        LOG_ERR("Incomplete write to log segment %u: %d/%zu", lw->segment, (int)rc, lw->staged);
+        return -EIO;
+    }
+
+    lw->segment_size += lw->staged;
+    lw->unsynced += lw->staged;
+    lw->stats.bytes += lw->staged;
+    lw->stats.writes++;
+    lw->staged = 0;
+    return 0;
+}
+
+int log_writer_flush(struct log_writer *lw)
+{
+    int rc;
+
+    if (!lw->open) {
+        return -EBADF;
+    }
+
+    rc = stage_write(lw);
+    if (rc < 0) {
+        return rc;
+    }
+
+    lw->last_sync_ms = k_uptime_get();
+
+    if (lw->unsynced == 0) {
+        return 0;
+    }
+
+    // One LittleFS metadata commit for everything written since the last sync
+    rc = fs_sync(&lw->file);
+    if (rc < 0) {
+        LOG_ERR("Failed to sync log segment %u: %d", lw->segment, rc);
+        return rc;
+    }
+
+    lw->unsynced = 0;
+    lw->stats.syncs++;
+    return 0;
+}
+
+static int segment_rotate(struct log_writer *lw)
+{
+    int rc;
+
+    rc = log_writer_close(lw);
+    if (rc < 0) {
+        return rc;
+    }
+
+    lw->segment++;
+    lw->stats.rotations++;
+
+    return segment_open(lw);
+}
+
+int log_writer_open(struct log_writer *lw, const char *dir_path)
+{
+    int rc;
+
+    if (!lw || !dir_path) {
+        return -EINVAL;
+    }
+
+    if (strlen(dir_path) >= sizeof(lw->dir_path)) {
+        LOG_ERR("Path too long");
+        return -ENAMETOOLONG;
+    }
+
+    memset(lw, 0, sizeof(*lw));
+    strcpy(lw->dir_path, dir_path);
+
+    // The directory is looked up once here, not on every record
+    rc = fs_mkdir(dir_path);
+    if (rc < 0 && rc != -EEXIST) {
+        LOG_ERR("Failed to create directory %s: %d", dir_path, rc);
+        return rc;
+    }
+
+    rc = segment_find_last(dir_path, &lw->segment);
+    if (rc < 0) {
+        LOG_ERR("Failed to list %s: %d", dir_path, rc);
+        return rc;
+    }
+
+    lw->last_sync_ms = k_uptime_get();
+
+    rc = segment_open(lw);
+    if (rc < 0) {
+        return rc;
+    }
+
+    if (lw->segment_size >= CONFIG_OLIGHT_LOG_SEGMENT_SIZE) {
+        return segment_rotate(lw);
+    }
+
+    return 0;
+}
+
+int log_writer_append(struct log_writer *lw, const void *record, size_t size)
+{
+    const uint8_t *src = record;
+    size_t chunk;
+    int rc;
+
+    if (!lw || !record || !size) {
+        return -EINVAL;
+    }
+
+    if (!lw->open) {
+        return -EBADF;
+    }
+
+    if (size > CONFIG_OLIGHT_LOG_SEGMENT_SIZE) {
+        return -EFBIG;
+    }
+
+    if (lw->segment_size + lw->staged + size > CONFIG_OLIGHT_LOG_SEGMENT_SIZE) {
+        rc = segment_rotate(lw);
+        if (rc < 0) {
+            return rc;
+        }
+    }
+
+    while (size > 0) {
+        chunk = MIN(size, sizeof(lw->stage) - lw->staged);
+        memcpy(&lw->stage[lw->staged], src, chunk);
+        lw->staged += chunk;
+        src += chunk;
+        size -= chunk;
+
+        if (lw->staged == sizeof(lw->stage)) {
+            rc = stage_write(lw);
+            if (rc < 0) {
+                return rc;
+            }
+        }
+    }
+
+    lw->stats.records++;
+
+    if (lw->unsynced + lw->staged >= CONFIG_OLIGHT_LOG_SYNC_BYTES ||
+        k_uptime_get() - lw->last_sync_ms >= CONFIG_OLIGHT_LOG_SYNC_MS) {
+        return log_writer_flush(lw);
+    }
+
+    return 0;
+}
+
+int log_writer_close(struct log_writer *lw)
+{
+    int rc;
+
+    if (!lw->open) {
+        return 0;
+    }
+
+    rc = log_writer_flush(lw);
+    if (rc < 0) {
+        return rc;
+    }
+
+    lw->open = false;
+
+    rc = fs_close(&lw->file);
+    if (rc < 0) {
+        LOG_ERR("Failed to close log segment %u: %d", lw->segment, rc);
+        return rc;
+    }
+
+    return 0;
+}
+
+#if defined(CONFIG_OLIGHT_LOG_BENCH)
+#define BENCH_RECORDS     100
+#define BENCH_RECORD_SIZE 20
+#define BENCH_FILES_DIR   "/lfs1/bench/files"
+#define BENCH_LOG_DIR     "/lfs1/bench/log"
+
+static void bench_remove_files(const char *dir_path)
+{
+    char path[MAX_PATH_LEN];
+    struct fs_dir_t dir;
+    struct fs_dirent entry;
+
+    fs_dir_t_init(&dir);
+    if (fs_opendir(&dir, dir_path) < 0) {
+        return;
+    }
+
+    while (fs_readdir(&dir, &entry) == 0 && entry.name[0] != '\0') {
+        snprintf(path, sizeof(path), "%s/%s", dir_path, entry.name);
+        fs_unlink(path);
+    }
+
+    fs_closedir(&dir);
+}
+
+static void bench_report(const char *name, int64_t ticks, uint32_t bytes)
+{
+    uint32_t us = MAX(k_ticks_to_us_ceil32(ticks), 1);
+
+    LOG_INF("%s: %u records in %u us, %u records/s, %u flash bytes/record", name,
+            BENCH_RECORDS, us, (uint32_t)(BENCH_RECORDS * 1000000ULL / us),
+            bytes / BENCH_RECORDS);
+}
+
+int log_writer_bench(void)
+{
+    static struct log_writer lw;
+    uint8_t record[BENCH_RECORD_SIZE];
+    char name[MAX_FILENAME_LEN];
+    uint32_t flash_bytes;
+    int64_t start;
+    int rc = 0;
+
+    fs_mkdir("/lfs1/bench");
+    bench_remove_files(BENCH_FILES_DIR);
+    bench_remove_files(BENCH_LOG_DIR);
+
+    // Current path: one create_file() per record
+    flash_bytes = perf_get(PERF_FLASH_BYTES);
+    start = k_uptime_ticks();
+
+    for (uint32_t i = 0; i < BENCH_RECORDS && rc == 0; i++) {
+        memset(record, (uint8_t)i, sizeof(record));
+        snprintf(name, sizeof(name), "rec%03u.bin", i);
+        rc = create_file(BENCH_FILES_DIR, name, record, sizeof(record));
+    }
+
+    if (rc < 0) {
+        LOG_ERR("create_file() bench failed: %d", rc);
+        return rc;
+    }
+
+    bench_report("create_file", k_uptime_ticks() - start,
+                 perf_get(PERF_FLASH_BYTES) - flash_bytes);
+
+    // Log writer, including the final flush
+    flash_bytes = perf_get(PERF_FLASH_BYTES);
+    start = k_uptime_ticks();
+
+    rc = log_writer_open(&lw, BENCH_LOG_DIR);
+    for (uint32_t i = 0; i < BENCH_RECORDS && rc == 0; i++) {
+        memset(record, (uint8_t)i, sizeof(record));
+        rc = log_writer_append(&lw, record, sizeof(record));
+    }
+
+    if (rc == 0) {
+        rc = log_writer_close(&lw);
+    }
+
+    if (rc < 0) {
+        LOG_ERR("Log writer bench failed: %d", rc);
+        return rc;
+    }
+
+    bench_report("log_writer", k_uptime_ticks() - start,
+                 perf_get(PERF_FLASH_BYTES) - flash_bytes);
+    LOG_INF("log_writer: %u writes, %u syncs", lw.stats.writes, lw.stats.syncs);
+
+    bench_remove_files(BENCH_FILES_DIR);
+    bench_remove_files(BENCH_LOG_DIR);
+    return 0;
+}
+#endif /* CONFIG_OLIGHT_LOG_BENCH */
+
 int test_create_text_file(void)
 {
     static const char test_string[] = "caoi bella aq";
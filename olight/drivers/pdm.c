@@ -1,4 +1,5 @@
 #include "pdm.h"
+#include "perf.h"
 
 LOG_MODULE_REGISTER(dmic_sample);
 
@@ -8,24 +9,134 @@ LOG_MODULE_REGISTER(dmic_sample);
 /* Milliseconds to wait for a block to be read. */
 #define READ_TIMEOUT     1000
 
+/* Consecutive failed reads after which the DMIC is stopped and restarted. */
+#define READ_ERRORS_RESTART 5
+/* Restarts in a row without a good read after which capture gives up. */
+#define RESTARTS_MAX        3
+
 /* Size of a block for 100 ms of audio data. */
 #define BLOCK_SIZE(_sample_rate, _number_of_channels) \
 	(BYTES_PER_SAMPLE * (_sample_rate / 10) * _number_of_channels)
 
+/* Log the pipeline counters every this many blocks (10 s). */
+#define STATS_LOG_BLOCKS 100
+
+#define CONSUMER_STACKSIZE 1024
+#define CONSUMER_PRIORITY  K_PRIO_PREEMPT(2)
+
 /* Driver will allocate blocks from this slab to receive audio data into them.
- * Application, after getting a given block from the driver and processing its
- * data, needs to free that block.
+ * The capture thread hands every filled block to the consumer thread, which
+ * frees it once all consumers have seen it. Besides the blocks the driver
+ * holds for double buffering, the slab has room for a full consumer queue.
  */
-#define MAX_BLOCK_SIZE   BLOCK_SIZE(MAX_SAMPLE_RATE, 2)
-#define BLOCK_COUNT      4
+#define MAX_BLOCK_SIZE   BLOCK_SIZE(MAX_SAMPLE_RATE, 1)
+#define BLOCK_COUNT      (CONFIG_OLIGHT_PDM_QUEUE_DEPTH + 2)
 K_MEM_SLAB_DEFINE_STATIC(mem_slab, MAX_BLOCK_SIZE, BLOCK_COUNT, 4);
 
-static int do_pdm_transfer(const struct device *dmic_dev,
-			   struct dmic_cfg *cfg,
-			   size_t block_count)
+/* Zero-copy handoff: only the block pointer and size travel. */
+struct block_msg {
+	void *buffer;
+	uint32_t size;
+	uint32_t seq;
+};
+
+K_MSGQ_DEFINE(block_q, sizeof(struct block_msg), CONFIG_OLIGHT_PDM_QUEUE_DEPTH, 4);
+
+static sys_slist_t consumers = SYS_SLIST_STATIC_INIT(&consumers);
+static struct pdm_stats stats;
+static struct k_spinlock stats_lock;
+
+void pdm_consumer_register(struct pdm_consumer *consumer)
+{
+	sys_slist_append(&consumers, &consumer->node);
+}
+
+void pdm_stats_get(struct pdm_stats *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&stats_lock);
+
+	*out = stats;
+
+	k_spin_unlock(&stats_lock, key);
+}
+
+static void handoff(void *buffer, uint32_t size, uint32_t seq)
+{
+	struct block_msg msg = {
+		.buffer = buffer,
+		.size = size,
+		.seq = seq,
+	};
+	k_spinlock_key_t key;
+	bool dropped;
+
+	/* Never block the capture thread; a full queue drops the newest block. */
+	dropped = (k_msgq_put(&block_q, &msg, K_NO_WAIT) != 0);
+	if (dropped) {
+		k_mem_slab_free(&mem_slab, buffer);
+		perf_inc(PERF_PDM_OVERRUNS);
+	}
+	perf_inc(PERF_PDM_BLOCKS);
+
+	key = k_spin_lock(&stats_lock);
+	stats.blocks++;
+	if (dropped) {
+		stats.overruns++;
+	}
+	stats.max_depth = MAX(stats.max_depth, k_msgq_num_used_get(&block_q));
+	k_spin_unlock(&stats_lock, key);
+}
+
+static void consumer_thread(void *arg1, void *arg2, void *arg3)
+{
+	struct pdm_consumer *consumer;
+	struct block_msg msg;
+	struct pdm_block block;
+
+	while (1) {
+		k_msgq_get(&block_q, &msg, K_FOREVER);
+
+		block.samples = msg.buffer;
+		block.size = msg.size;
+		block.seq = msg.seq;
+
+		SYS_SLIST_FOR_EACH_CONTAINER(&consumers, consumer, node) {
+			consumer->consume(consumer, &block);
+		}
+
+		k_mem_slab_free(&mem_slab, msg.buffer);
+	}
+}
+
+K_THREAD_DEFINE(pdm_consumer_id, CONSUMER_STACKSIZE, consumer_thread, NULL, NULL, NULL,
+		CONSUMER_PRIORITY, 0, 0);
+
+static int dmic_restart(const struct device *dmic_dev)
 {
 	int ret;
 
+	ret = dmic_trigger(dmic_dev, DMIC_TRIGGER_STOP);
+	if (ret < 0) {
+		LOG_ERR("STOP trigger failed: %d", ret);
+		return ret;
+	}
+
+	ret = dmic_trigger(dmic_dev, DMIC_TRIGGER_START);
+	if (ret < 0) {
+		LOG_ERR("START trigger failed: %d", ret);
+	}
+
+	return ret;
+}
+
+static int do_pdm_capture(const struct device *dmic_dev, struct dmic_cfg *cfg)
+{
+	struct pdm_stats snapshot;
+	uint32_t seq = 0;
+	uint32_t errors = 0;
+	uint32_t restarts = 0;
+	int ret;
+
 	LOG_INF("PCM output rate: %u, channels: %u",
 		cfg->streams[0].pcm_rate, cfg->channel.req_num_chan);
 
@@ -41,36 +152,64 @@ static int do_pdm_transfer(const struct device *dmic_dev,
 		return ret;
 	}
 
-	for (int i = 0; i < block_count; ++i) {
+	while (1) {
 		void *buffer;
 		uint32_t size;
 
 		ret = dmic_read(dmic_dev, 0, &buffer, &size, READ_TIMEOUT);
 		if (ret < 0) {
-			LOG_ERR("%d - read failed: %d", i, ret);
-			return ret;
-		}
+			k_spinlock_key_t key = k_spin_lock(&stats_lock);
 
-		LOG_INF("%d - got buffer %p of %u bytes", i, buffer, size);
+			stats.read_errors++;
+			k_spin_unlock(&stats_lock, key);
 
-		k_mem_slab_free(&mem_slab, buffer);
-	}
+			/* No block was captured, so seq stays: gaps only mean drops. */
+			if (errors++ == 0) {
+				LOG_ERR("%u - read failed: %d", seq, ret);
+			}
 
-	ret = dmic_trigger(dmic_dev, DMIC_TRIGGER_STOP);
-	if (ret < 0) {
-		LOG_ERR("STOP trigger failed: %d", ret);
-		return ret;
+			if (errors < READ_ERRORS_RESTART) {
+				continue;
+			}
+
+			if (restarts++ == RESTARTS_MAX) {
+				LOG_ERR("Reads still failing after %u restarts, capture stopped",
+					RESTARTS_MAX);
+				(void)dmic_trigger(dmic_dev, DMIC_TRIGGER_STOP);
+				return ret;
+			}
+
+			LOG_WRN("%u reads failed in a row, restarting the DMIC", errors);
+			errors = 0;
+
+			ret = dmic_restart(dmic_dev);
+			if (ret < 0) {
+				return ret;
+			}
+
+			continue;
+		}
+
+		errors = 0;
+		restarts = 0;
+		handoff(buffer, size, seq++);
+
+		if ((seq % STATS_LOG_BLOCKS) == 0) {
+			pdm_stats_get(&snapshot);
+			LOG_INF("PDM: %u blocks, %u overruns, %u read errors, max depth %u/%u",
+				snapshot.blocks, snapshot.overruns, snapshot.read_errors,
+				snapshot.max_depth, CONFIG_OLIGHT_PDM_QUEUE_DEPTH);
+		}
 	}
 
-	return ret;
+	return 0;
 }
 
 int pdm_test(void)
 {
 	const struct device *const dmic_dev = DEVICE_DT_GET(DT_NODELABEL(dmic_dev));
-	int ret;
 
-	LOG_INF("DMIC sample");
+	LOG_INF("DMIC capture");
 
 	if (!device_is_ready(dmic_dev)) {
 		LOG_ERR("%s is not ready", dmic_dev->name);
@@ -105,24 +244,8 @@ int pdm_test(void)
 	cfg.streams[0].block_size =
 		BLOCK_SIZE(cfg.streams[0].pcm_rate, cfg.channel.req_num_chan);
 
-	ret = do_pdm_transfer(dmic_dev, &cfg, 2 * BLOCK_COUNT);
-	if (ret < 0) {
-		return 0;
-	}
-
-	cfg.channel.req_num_chan = 2;
-	cfg.channel.req_chan_map_lo =
-		dmic_build_channel_map(0, 0, PDM_CHAN_LEFT) |
-		dmic_build_channel_map(1, 0, PDM_CHAN_RIGHT);
-	cfg.streams[0].pcm_rate = MAX_SAMPLE_RATE;
-	cfg.streams[0].block_size =
-		BLOCK_SIZE(cfg.streams[0].pcm_rate, cfg.channel.req_num_chan);
-
-	ret = do_pdm_transfer(dmic_dev, &cfg, 2 * BLOCK_COUNT);
-	if (ret < 0) {
-		return 0;
-	}
+	(void)do_pdm_capture(dmic_dev, &cfg);
 
 	LOG_INF("Exiting");
 	return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,51 @@
+#ifndef AUDIO_FEAT_H
+#define AUDIO_FEAT_H
+
+#include <stddef.h>
+
+#include <zephyr/sys/util.h>
+#include <zephyr/types.h>
+
+/* Octave bands from 31.25 Hz to 8 kHz at 16 kHz sample rate. */
+#define AUDIO_FEAT_BANDS 6
+
+/* Samples per spectrum frame; a 100 ms block holds three of them. */
+#define AUDIO_FEAT_FFT_LEN 512
+
+/**
+ * @brief Features of one 100 ms PCM block, stored and sent instead of the PCM
+ */
+struct audio_feat {
+	/* Sequence number of the PDM block. */
+	uint32_t seq;
+	/* Root mean square of the samples, in sample units. */
+	uint16_t rms;
+	/* Zero crossings per 1000 samples. */
+	uint16_t zcr;
+	/* Band energies as log2 in Q8, i.e. 256 per doubling (3 dB). */
+	uint16_t band[AUDIO_FEAT_BANDS];
+} __packed;
+
+/**
+ * @brief Compute the features of a block of 16-bit PCM
+ *
+ * Has no dependency on the microphone, so it can be fed synthetic input,
+ * e.g. on native_sim where the scalar kernels are used.
+ *
+ * @param samples PCM samples
+ * @param count Number of samples; the spectrum needs at least
+ *              AUDIO_FEAT_FFT_LEN of them
+ * @param seq Sequence number stored in the features
+ * @param feat Filled with the features
+ */
+void audio_feat_compute(const int16_t *samples, size_t count, uint32_t seq,
+			struct audio_feat *feat);
+
+/**
+ * @brief Copy the features of the latest PDM block
+ *
+ * @return int 0 on success, -ENODATA before the first block
+ */
+int audio_feat_latest(struct audio_feat *feat);
+
+#endif /* AUDIO_FEAT_H */
@@ -0,0 +1,18 @@
+#ifndef AWAKE_MGMT_H
+#define AWAKE_MGMT_H
+
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt_defines.h>
+
+/* Custom SMP group controlling the advertising/sleep schedule. */
+#define AWAKE_MGMT_GROUP_ID MGMT_GROUP_ID_PERUSER
+
+/**
+ * Command IDs of the awake group.
+ *
+ * AWAKE_MGMT_ID_STAY
+ *   write {"s": seconds} -> {"s": granted seconds, "sleep": next sleep in ms}
+ *   read  -> {"active": ms, "sleep": ms, "stay": s, "idle": cycles}
+ */
+#define AWAKE_MGMT_ID_STAY 0
+
+#endif /* AWAKE_MGMT_H */
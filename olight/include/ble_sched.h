@@ -0,0 +1,58 @@
+#ifndef BLE_SCHED_H
+#define BLE_SCHED_H
+
+#include <zephyr/types.h>
+
+/**
+ * @brief Current advertising/sleep schedule
+ */
+struct ble_sched_state {
+	/* Length of the last active window in milliseconds. */
+	uint32_t active_ms;
+	/* Length of the current or next sleep in milliseconds. */
+	uint32_t sleep_ms;
+	/* Seconds left of the last stay-awake request. */
+	uint32_t stay_awake_s;
+	/* Consecutive cycles without SMP activity. */
+	uint32_t idle_cycles;
+};
+
+/**
+ * @brief Record SMP or connection activity
+ *
+ * The next sleep is cut to CONFIG_OLIGHT_SLEEP_MIN_MS.
+ */
+void ble_sched_activity(void);
+
+/**
+ * @brief Keep the device advertising for the given number of seconds
+ *
+ * Extends the current active window, or ends the current sleep early,
+ * and counts as activity. 0 cancels an earlier request: a window held
+ * open by it ends at its minimum length, a sleeping device stays asleep,
+ * and the call itself does not count as activity.
+ *
+ * @param seconds Requested time, capped at CONFIG_OLIGHT_STAY_AWAKE_MAX_S
+ * @return uint32_t Granted number of seconds
+ */
+uint32_t ble_sched_stay_awake(uint32_t seconds);
+
+/**
+ * @brief Block until the active window, including stay-awake time, is over
+ */
+void ble_sched_wait_active(void);
+
+/**
+ * @brief Pick the next sleep length and block for it
+ *
+ * Recent activity resets the sleep to its minimum; otherwise it doubles
+ * up to CONFIG_OLIGHT_SLEEP_MAX_MS. A stay-awake request ends it early.
+ */
+void ble_sched_wait_sleep(void);
+
+/**
+ * @brief Copy the current schedule
+ */
+void ble_sched_get(struct ble_sched_state *state);
+
+#endif /* BLE_SCHED_H */
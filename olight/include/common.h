@@ -4,5 +4,10 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
+#include <zephyr/types.h>
+
 void start_smp_bluetooth_adverts(void);
-void stop_smp_bluetooth_adverts(void);
\ No newline at end of file
+void stop_smp_bluetooth_adverts(void);
+
+/* Time from the last start_smp_bluetooth_adverts() call to advertising. */
+uint32_t smp_bluetooth_wake_latency_us(void);
@@ -2,6 +2,57 @@
 
 #include "zephyr.h"
 
+#include <zephyr/sys/slist.h>
+
+/**
+ * @brief One filled block of 16-bit mono PCM, owned by the pipeline
+ *
+ * Consumers may read the samples only while their callback runs; the
+ * block goes back to the driver's slab afterwards.
+ */
+struct pdm_block {
+	const int16_t *samples;
+	uint32_t size;
+	/* Index of the block since capture started, gaps mean dropped blocks. */
+	uint32_t seq;
+};
+
+/**
+ * @brief Consumer of captured audio blocks
+ *
+ * Called from the PDM consumer thread, in registration order.
+ */
+struct pdm_consumer {
+	void (*consume)(struct pdm_consumer *consumer, const struct pdm_block *block);
+	sys_snode_t node;
+};
+
+/**
+ * @brief Capture pipeline counters
+ */
+struct pdm_stats {
+	uint32_t blocks;
+	/* Blocks dropped because the consumer queue was full. */
+	uint32_t overruns;
+	/* Failed dmic_read() calls, e.g. the driver ran out of slab blocks. */
+	uint32_t read_errors;
+	/* Highest number of blocks waiting for the consumer. */
+	uint32_t max_depth;
+};
+
+/**
+ * @brief Add a consumer of captured blocks
+ */
+void pdm_consumer_register(struct pdm_consumer *consumer);
+
+/**
+ * @brief Copy the pipeline counters
+ */
+void pdm_stats_get(struct pdm_stats *stats);
+
+/**
+ * @brief Capture thread: stream mono PCM blocks into the consumer queue
+ */
 int pdm_test(void);
 
-// End of pdm.h
\ No newline at end of file
+// End of pdm.h
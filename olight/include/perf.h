@@ -0,0 +1,69 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/types.h>
+
+/**
+ * @brief Performance counters, in the order the perf group reports them
+ *
+ * All counters are 32 bits and wrap; a manager takes differences.
+ */
+enum perf_counter {
+	/* Active advertising windows opened. */
+	PERF_ADV_CYCLES,
+	/* Milliseconds spent connected, summed over connections. */
+	PERF_CONN_MS,
+	/* PDM blocks handed to the consumer queue, dropped ones included. */
+	PERF_PDM_BLOCKS,
+	/* PDM blocks dropped because the consumer queue was full. */
+	PERF_PDM_OVERRUNS,
+	/* Bytes programmed through flash_area_write(), e.g. by LittleFS. */
+	PERF_FLASH_BYTES,
+	/* SMP response bytes notified over Bluetooth. */
+	PERF_SMP_BYTES,
+	PERF_COUNT,
+};
+
+#if defined(CONFIG_OLIGHT_PERF)
+/* One row per CPU, so CPUs never contend for a counter. Summed on read. */
+extern atomic_t perf_counters[CONFIG_MP_MAX_NUM_CPUS][PERF_COUNT];
+
+/**
+ * @brief Add to a counter
+ *
+ * Lock free and callable from any context, including ISRs.
+ */
+static inline void perf_add(enum perf_counter counter, uint32_t n)
+{
+#if defined(CONFIG_SMP)
+	atomic_add(&perf_counters[arch_curr_cpu()->id][counter], (atomic_val_t)n);
+#else
+	atomic_add(&perf_counters[0][counter], (atomic_val_t)n);
+#endif
+}
+
+/**
+ * @brief Read one counter
+ */
+uint32_t perf_get(enum perf_counter counter);
+
+/**
+ * @brief Read all counters
+ *
+ * The counters are read one by one, not as an atomic set.
+ */
+void perf_snapshot(uint32_t values[PERF_COUNT]);
+#else
+static inline void perf_add(enum perf_counter counter, uint32_t n)
+{
+}
+#endif
+
+static inline void perf_inc(enum perf_counter counter)
+{
+	perf_add(counter, 1);
+}
+
+#endif /* PERF_H */
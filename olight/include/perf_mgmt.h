@@ -0,0 +1,26 @@
+#ifndef PERF_MGMT_H
+#define PERF_MGMT_H
+
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt_defines.h>
+
+/* Custom SMP group reporting the performance counters of perf.h. */
+#define PERF_MGMT_GROUP_ID (MGMT_GROUP_ID_PERUSER + 1)
+
+/**
+ * Command IDs of the perf group.
+ *
+ * PERF_MGMT_ID_READ
+ *   read -> {"t": uptime ms, "c": [counters in enum perf_counter order]}
+ *
+ * PERF_MGMT_ID_SUB
+ *   write {"ms": period} -> {"ms": granted period}
+ *   Every period, the read response is notified unrequested to the
+ *   connection that wrote the subscription, with its own sequence
+ *   numbers. A later subscription takes the notifications over. 0 ends
+ *   the subscription, as does a disconnect of the subscriber. Only over
+ *   the Bluetooth transport.
+ */
+#define PERF_MGMT_ID_READ 0
+#define PERF_MGMT_ID_SUB  1
+
+#endif /* PERF_MGMT_H */
@@ -0,0 +1,130 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/atomic.h>
+
+#if defined(CONFIG_BT_CONN)
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#endif
+#if defined(CONFIG_MCUMGR_TRANSPORT_BT)
+#include <zephyr/mgmt/mcumgr/transport/smp_bt.h>
+#endif
+
+#include "perf.h"
+
+atomic_t perf_counters[CONFIG_MP_MAX_NUM_CPUS][PERF_COUNT];
+
+#if defined(CONFIG_BT_CONN)
+/* Uptime up to which each open connection is counted, 0 if closed. */
+static int64_t conn_marks[CONFIG_BT_MAX_CONN];
+static struct k_spinlock conn_lock;
+
+/* Count the time of the open connections so far, so a reader sees it. */
+static void conn_time_flush(void)
+{
+	int64_t now = k_uptime_get();
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+
+	for (size_t i = 0; i < ARRAY_SIZE(conn_marks); i++) {
+		if (conn_marks[i] != 0) {
+			perf_add(PERF_CONN_MS, (uint32_t)(now - conn_marks[i]));
+			conn_marks[i] = now;
+		}
+	}
+
+	k_spin_unlock(&conn_lock, key);
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	k_spinlock_key_t key;
+
+	if (err) {
+		return;
+	}
+
+	key = k_spin_lock(&conn_lock);
+	conn_marks[bt_conn_index(conn)] = k_uptime_get();
+	k_spin_unlock(&conn_lock, key);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	uint8_t index = bt_conn_index(conn);
+	k_spinlock_key_t key = k_spin_lock(&conn_lock);
+
+	if (conn_marks[index] != 0) {
+		perf_add(PERF_CONN_MS, (uint32_t)(k_uptime_get() - conn_marks[index]));
+		conn_marks[index] = 0;
+	}
+
+	k_spin_unlock(&conn_lock, key);
+}
+
+BT_CONN_CB_DEFINE(perf_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+};
+#else
+static void conn_time_flush(void)
+{
+}
+#endif /* CONFIG_BT_CONN */
+
+/* The wrappers below are linked in with --wrap, see CMakeLists.txt. */
+
+int __real_flash_area_write(const struct flash_area *fa, off_t off, const void *src, size_t len);
+
+int __wrap_flash_area_write(const struct flash_area *fa, off_t off, const void *src, size_t len)
+{
+	int rc = __real_flash_area_write(fa, off, src, len);
+
+	if (rc == 0) {
+		perf_add(PERF_FLASH_BYTES, len);
+	}
+
+	return rc;
+}
+
+#if defined(CONFIG_MCUMGR_TRANSPORT_BT)
+int __real_bt_gatt_notify_cb(struct bt_conn *conn, struct bt_gatt_notify_params *params);
+
+/* The SMP transport sends every response as notifications of its characteristic. */
+int __wrap_bt_gatt_notify_cb(struct bt_conn *conn, struct bt_gatt_notify_params *params)
+{
+	int rc = __real_bt_gatt_notify_cb(conn, params);
+
+	if (rc == 0 && params->attr != NULL && bt_uuid_cmp(params->attr->uuid, SMP_BT_CHR_UUID) == 0) {
+		perf_add(PERF_SMP_BYTES, params->len);
+	}
+
+	return rc;
+}
+#endif /* CONFIG_MCUMGR_TRANSPORT_BT */
+
+uint32_t perf_get(enum perf_counter counter)
+{
+	uint32_t sum = 0;
+
+	if (counter == PERF_CONN_MS) {
+		conn_time_flush();
+	}
+
+	for (size_t cpu = 0; cpu < ARRAY_SIZE(perf_counters); cpu++) {
+		sum += (uint32_t)atomic_get(&perf_counters[cpu][counter]);
+	}
+
+	return sum;
+}
+
+void perf_snapshot(uint32_t values[PERF_COUNT])
+{
+	for (int counter = 0; counter < PERF_COUNT; counter++) {
+		values[counter] = perf_get(counter);
+	}
+}
@@ -0,0 +1,278 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/mgmt/mcumgr/mgmt/handlers.h>
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt.h>
+#include <zephyr/mgmt/mcumgr/smp/smp.h>
+#include <zephyr/sys/byteorder.h>
+
+#include <zcbor_common.h>
+#include <zcbor_decode.h>
+#include <zcbor_encode.h>
+
+#include <mgmt/mcumgr/util/zcbor_bulk.h>
+
+#if defined(CONFIG_MCUMGR_TRANSPORT_BT)
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/mgmt/mcumgr/transport/smp_bt.h>
+#include <zephyr/net_buf.h>
+#endif
+
+#include "perf.h"
+#include "perf_mgmt.h"
+
+LOG_MODULE_REGISTER(perf_mgmt, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* The map, the counter array and a spare one. */
+#define CBOR_ENCODER_STATE_NUM 3
+
+/* Header plus {"t": u32, "c": [u32 x PERF_COUNT]}, containers may be indefinite. */
+#define PUSH_BUF_SIZE (sizeof(struct smp_hdr) + 16 + 5 * PERF_COUNT)
+
+static bool perf_encode(zcbor_state_t *zse)
+{
+	uint32_t values[PERF_COUNT];
+	bool ok;
+
+	perf_snapshot(values);
+
+	ok = zcbor_tstr_put_lit(zse, "t") && zcbor_uint32_put(zse, k_uptime_get_32()) &&
+	     zcbor_tstr_put_lit(zse, "c") && zcbor_list_start_encode(zse, PERF_COUNT);
+
+	for (size_t i = 0; ok && i < PERF_COUNT; i++) {
+		ok = zcbor_uint32_put(zse, values[i]);
+	}
+
+	return ok && zcbor_list_end_encode(zse, PERF_COUNT);
+}
+
+static int perf_mgmt_read(struct smp_streamer *ctxt)
+{
+	return perf_encode(ctxt->writer->zs) ? MGMT_ERR_EOK : MGMT_ERR_EMSGSIZE;
+}
+
+#if defined(CONFIG_MCUMGR_TRANSPORT_BT)
+static atomic_t push_period_ms;
+static uint8_t push_seq;
+/* Connection that subscribed, the only one the counters are pushed to. */
+static struct bt_conn *push_conn;
+static struct k_spinlock push_lock;
+
+static void push_work_fn(struct k_work *work);
+
+static K_WORK_DELAYABLE_DEFINE(push_work, push_work_fn);
+
+/* Swap the subscribed connection, NULL to end the subscription. */
+static void push_conn_set(struct bt_conn *conn)
+{
+	k_spinlock_key_t key = k_spin_lock(&push_lock);
+	struct bt_conn *old = push_conn;
+
+	push_conn = (conn != NULL) ? bt_conn_ref(conn) : NULL;
+	k_spin_unlock(&push_lock, key);
+
+	if (old != NULL) {
+		bt_conn_unref(old);
+	}
+}
+
+static struct bt_conn *push_conn_get(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&push_lock);
+	struct bt_conn *conn = (push_conn != NULL) ? bt_conn_ref(push_conn) : NULL;
+
+	k_spin_unlock(&push_lock, key);
+
+	return conn;
+}
+
+struct conn_match {
+	const void *candidate;
+	struct bt_conn *conn;
+};
+
+static void conn_match_cb(struct bt_conn *conn, void *data)
+{
+	struct conn_match *match = data;
+
+	if (conn == match->candidate) {
+		match->conn = conn;
+	}
+}
+
+/* The Bluetooth transport keeps the connection a request came in on at the
+ * start of the request buffer's user data (struct smp_bt_user_data, private
+ * to smp_bt.c). The shell leaves the user data unset and UDP keeps an
+ * address there, so the pointer is only taken when it is one of the open
+ * connections.
+ */
+static struct bt_conn *request_conn(const struct smp_streamer *ctxt)
+{
+	struct conn_match match = {0};
+
+	if (ctxt->smpt == NULL || ctxt->smpt->functions.ud_copy == NULL) {
+		return NULL;
+	}
+
+	(void)memcpy(&match.candidate, net_buf_user_data(ctxt->reader->nb),
+		     sizeof(match.candidate));
+	bt_conn_foreach(BT_CONN_TYPE_LE, conn_match_cb, &match);
+
+	return match.conn;
+}
+
+static void push_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	k_spinlock_key_t key = k_spin_lock(&push_lock);
+	bool ours = (conn == push_conn);
+
+	k_spin_unlock(&push_lock, key);
+
+	if (ours) {
+		atomic_set(&push_period_ms, 0);
+		k_work_cancel_delayable(&push_work);
+		push_conn_set(NULL);
+	}
+}
+
+BT_CONN_CB_DEFINE(perf_mgmt_conn_callbacks) = {
+	.disconnected = push_disconnected,
+};
+
+static void push_work_fn(struct k_work *work)
+{
+	static const struct bt_gatt_attr *attr;
+	static uint8_t buf[PUSH_BUF_SIZE];
+	struct smp_hdr *hdr = (struct smp_hdr *)buf;
+	zcbor_state_t zse[CBOR_ENCODER_STATE_NUM];
+	uint32_t period = (uint32_t)atomic_get(&push_period_ms);
+	struct bt_conn *conn;
+	size_t len;
+	int rc;
+
+	if (period == 0) {
+		return;
+	}
+
+	if (attr == NULL) {
+		attr = bt_gatt_find_by_uuid(NULL, 0, SMP_BT_CHR_UUID);
+		if (attr == NULL) {
+			LOG_ERR("SMP characteristic not found");
+			atomic_set(&push_period_ms, 0);
+			return;
+		}
+	}
+
+	zcbor_new_encode_state(zse, ARRAY_SIZE(zse), &buf[sizeof(*hdr)], sizeof(buf) - sizeof(*hdr),
+			       0);
+
+	if (!zcbor_map_start_encode(zse, 2) || !perf_encode(zse) || !zcbor_map_end_encode(zse, 2)) {
+		LOG_ERR("Counters do not fit a notification");
+		atomic_set(&push_period_ms, 0);
+		return;
+	}
+
+	len = zse->payload - &buf[sizeof(*hdr)];
+
+	/* Framed as a response to a read of the counters. */
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->nh_op = MGMT_OP_READ_RSP;
+	hdr->nh_len = sys_cpu_to_be16(len);
+	hdr->nh_group = sys_cpu_to_be16(PERF_MGMT_GROUP_ID);
+	hdr->nh_seq = push_seq++;
+	hdr->nh_id = PERF_MGMT_ID_READ;
+
+	conn = push_conn_get();
+	if (conn == NULL) {
+		atomic_set(&push_period_ms, 0);
+		return;
+	}
+
+	rc = bt_gatt_notify(conn, attr, buf, sizeof(*hdr) + len);
+	bt_conn_unref(conn);
+	if (rc == -ENOTCONN || rc == -EINVAL) {
+		/* The subscriber is gone or no longer subscribed. */
+		atomic_set(&push_period_ms, 0);
+		push_conn_set(NULL);
+		return;
+	}
+
+	if (rc != 0) {
+		LOG_WRN("Counter notification failed (rc %d)", rc);
+	}
+
+	k_work_reschedule(&push_work, K_MSEC(period));
+}
+
+static int perf_mgmt_sub(struct smp_streamer *ctxt)
+{
+	zcbor_state_t *zse = ctxt->writer->zs;
+	zcbor_state_t *zsd = ctxt->reader->zs;
+	struct bt_conn *conn = request_conn(ctxt);
+	uint32_t period = 0;
+	size_t decoded;
+
+	struct zcbor_map_decode_key_val sub_decode[] = {
+		ZCBOR_MAP_DECODE_KEY_DECODER("ms", zcbor_uint32_decode, &period),
+	};
+
+	if (zcbor_map_decode_bulk(zsd, sub_decode, ARRAY_SIZE(sub_decode), &decoded) != 0 ||
+	    decoded == 0) {
+		return MGMT_ERR_EINVAL;
+	}
+
+	/* Notifications only exist on the Bluetooth transport. */
+	if (conn == NULL) {
+		return MGMT_ERR_ENOTSUP;
+	}
+
+	if (period != 0) {
+		period = MAX(period, CONFIG_OLIGHT_PERF_PUSH_MIN_MS);
+	}
+
+	atomic_set(&push_period_ms, (atomic_val_t)period);
+
+	if (period != 0) {
+		/* A new subscriber takes the pushes over from the previous one. */
+		push_conn_set(conn);
+		/* The first one follows this response. */
+		k_work_reschedule(&push_work, K_MSEC(period));
+	} else {
+		k_work_cancel_delayable(&push_work);
+		push_conn_set(NULL);
+	}
+
+	return (zcbor_tstr_put_lit(zse, "ms") && zcbor_uint32_put(zse, period)) ? MGMT_ERR_EOK
+									      : MGMT_ERR_EMSGSIZE;
+}
+#endif /* CONFIG_MCUMGR_TRANSPORT_BT */
+
+static const struct mgmt_handler perf_mgmt_handlers[] = {
+	[PERF_MGMT_ID_READ] = {
+		.mh_read = perf_mgmt_read,
+	},
+#if defined(CONFIG_MCUMGR_TRANSPORT_BT)
+	[PERF_MGMT_ID_SUB] = {
+		.mh_write = perf_mgmt_sub,
+	},
+#endif
+};
+
+static struct mgmt_group perf_mgmt_group = {
+	.mg_handlers = perf_mgmt_handlers,
+	.mg_handlers_count = ARRAY_SIZE(perf_mgmt_handlers),
+	.mg_group_id = PERF_MGMT_GROUP_ID,
+};
+
+static void perf_mgmt_register(void)
+{
+	mgmt_register_group(&perf_mgmt_group);
+}
+
+MCUMGR_HANDLER_DEFINE(perf_mgmt, perf_mgmt_register);
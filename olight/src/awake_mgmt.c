@@ -0,0 +1,103 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/mgmt/mcumgr/mgmt/callbacks.h>
+#include <zephyr/mgmt/mcumgr/mgmt/handlers.h>
+#include <zephyr/mgmt/mcumgr/mgmt/mgmt.h>
+#include <zephyr/mgmt/mcumgr/smp/smp.h>
+
+#include <zcbor_common.h>
+#include <zcbor_decode.h>
+#include <zcbor_encode.h>
+
+#include <mgmt/mcumgr/util/zcbor_bulk.h>
+
+#include "awake_mgmt.h"
+#include "ble_sched.h"
+
+static int awake_mgmt_stay_write(struct smp_streamer *ctxt)
+{
+	zcbor_state_t *zse = ctxt->writer->zs;
+	zcbor_state_t *zsd = ctxt->reader->zs;
+	struct ble_sched_state state;
+	uint32_t seconds = 0;
+	size_t decoded;
+	bool ok;
+
+	struct zcbor_map_decode_key_val stay_decode[] = {
+		ZCBOR_MAP_DECODE_KEY_DECODER("s", zcbor_uint32_decode, &seconds),
+	};
+
+	if (zcbor_map_decode_bulk(zsd, stay_decode, ARRAY_SIZE(stay_decode), &decoded) != 0 ||
+	    decoded == 0)
+	{
+		return MGMT_ERR_EINVAL;
+	}
+
+	seconds = ble_sched_stay_awake(seconds);
+	ble_sched_get(&state);
+
+	ok = zcbor_tstr_put_lit(zse, "s") && zcbor_uint32_put(zse, seconds) &&
+	     zcbor_tstr_put_lit(zse, "sleep") && zcbor_uint32_put(zse, state.sleep_ms);
+
+	return ok ? MGMT_ERR_EOK : MGMT_ERR_EMSGSIZE;
+}
+
+static int awake_mgmt_stay_read(struct smp_streamer *ctxt)
+{
+	zcbor_state_t *zse = ctxt->writer->zs;
+	struct ble_sched_state state;
+	bool ok;
+
+	ble_sched_get(&state);
+
+	ok = zcbor_tstr_put_lit(zse, "active") && zcbor_uint32_put(zse, state.active_ms) &&
+	     zcbor_tstr_put_lit(zse, "sleep") && zcbor_uint32_put(zse, state.sleep_ms) &&
+	     zcbor_tstr_put_lit(zse, "stay") && zcbor_uint32_put(zse, state.stay_awake_s) &&
+	     zcbor_tstr_put_lit(zse, "idle") && zcbor_uint32_put(zse, state.idle_cycles);
+
+	return ok ? MGMT_ERR_EOK : MGMT_ERR_EMSGSIZE;
+}
+
+static const struct mgmt_handler awake_mgmt_handlers[] = {
+	[AWAKE_MGMT_ID_STAY] = {
+		.mh_read = awake_mgmt_stay_read,
+		.mh_write = awake_mgmt_stay_write,
+	},
+};
+
+static struct mgmt_group awake_mgmt_group = {
+	.mg_handlers = awake_mgmt_handlers,
+	.mg_handlers_count = ARRAY_SIZE(awake_mgmt_handlers),
+	.mg_group_id = AWAKE_MGMT_GROUP_ID,
+};
+
+#if defined(CONFIG_MCUMGR_SMP_COMMAND_STATUS_HOOKS)
+/* Any SMP command counts as demand and keeps the sleep short. */
+static enum mgmt_cb_return awake_mgmt_cmd_recv(uint32_t event, enum mgmt_cb_return prev_status,
+					       int32_t *rc, uint16_t *group, bool *abort_more,
+					       void *data, size_t data_size)
+{
+	ble_sched_activity();
+
+	return MGMT_CB_OK;
+}
+
+static struct mgmt_callback cmd_recv_callback = {
+	.callback = awake_mgmt_cmd_recv,
+	.event_id = MGMT_EVT_OP_CMD_RECV,
+};
+#endif
+
+static void awake_mgmt_register(void)
+{
+	mgmt_register_group(&awake_mgmt_group);
+
+#if defined(CONFIG_MCUMGR_SMP_COMMAND_STATUS_HOOKS)
+	mgmt_callback_register(&cmd_recv_callback);
+#endif
+}
+
+MCUMGR_HANDLER_DEFINE(awake_mgmt, awake_mgmt_register);
@@ -0,0 +1,149 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include "ble_sched.h"
+
+LOG_MODULE_REGISTER(ble_sched, CONFIG_LOG_DEFAULT_LEVEL);
+
+/* Given by stay-awake requests to re-evaluate the current phase. */
+static K_SEM_DEFINE(sched_sem, 0, 1);
+static atomic_t activity;
+static struct k_spinlock lock;
+static int64_t stay_until_ms;
+/* Inside ble_sched_wait_active(). */
+static bool active;
+static uint32_t active_ms;
+static uint32_t sleep_ms = CONFIG_OLIGHT_SLEEP_MIN_MS;
+static uint32_t idle_cycles;
+
+void ble_sched_activity(void)
+{
+	atomic_set(&activity, 1);
+}
+
+uint32_t ble_sched_stay_awake(uint32_t seconds)
+{
+	k_spinlock_key_t key;
+	bool wake;
+
+	seconds = MIN(seconds, CONFIG_OLIGHT_STAY_AWAKE_MAX_S);
+
+	key = k_spin_lock(&lock);
+	if (seconds == 0)
+	{
+		stay_until_ms = 0;
+		/* Let a held window end now; a sleep is left alone. */
+		wake = active;
+	}
+	else
+	{
+		stay_until_ms = k_uptime_get() + (int64_t)seconds * MSEC_PER_SEC;
+		wake = true;
+	}
+	k_spin_unlock(&lock, key);
+
+	if (seconds == 0)
+	{
+		LOG_INF("Stay awake cancelled");
+	}
+	else
+	{
+		LOG_INF("Stay awake for %u s", seconds);
+		ble_sched_activity();
+	}
+
+	if (wake)
+	{
+		k_sem_give(&sched_sem);
+	}
+
+	return seconds;
+}
+
+void ble_sched_wait_active(void)
+{
+	int64_t start = k_uptime_get();
+	int64_t end;
+	int64_t now;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&lock);
+	active = true;
+	k_spin_unlock(&lock, key);
+
+	while (1)
+	{
+		key = k_spin_lock(&lock);
+		end = MAX(start + CONFIG_OLIGHT_ACTIVE_MS, stay_until_ms);
+		k_spin_unlock(&lock, key);
+
+		now = k_uptime_get();
+		if (now >= end)
+		{
+			break;
+		}
+
+		/* Woken early when a stay-awake request moves the end. */
+		(void)k_sem_take(&sched_sem, K_MSEC(end - now));
+	}
+
+	key = k_spin_lock(&lock);
+	active_ms = (uint32_t)(k_uptime_get() - start);
+	active = false;
+	k_spin_unlock(&lock, key);
+
+	/* A give that came after the last check is stale: the deadline check in
+	 * ble_sched_wait_sleep() catches a request made in the meantime.
+	 */
+	k_sem_reset(&sched_sem);
+}
+
+void ble_sched_wait_sleep(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	bool held = (stay_until_ms > k_uptime_get());
+
+	if (atomic_clear(&activity) != 0)
+	{
+		idle_cycles = 0;
+		sleep_ms = CONFIG_OLIGHT_SLEEP_MIN_MS;
+	}
+	else
+	{
+		idle_cycles++;
+		sleep_ms = MIN(sleep_ms * 2, CONFIG_OLIGHT_SLEEP_MAX_MS);
+	}
+
+	k_spin_unlock(&lock, key);
+
+	if (held)
+	{
+		LOG_INF("Stay-awake request pending, not sleeping");
+		return;
+	}
+
+	LOG_INF("Sleeping for %u ms (%u idle cycles)", sleep_ms, idle_cycles);
+
+	if (k_sem_take(&sched_sem, K_MSEC(sleep_ms)) == 0)
+	{
+		LOG_INF("Woken early by a stay-awake request");
+	}
+}
+
+void ble_sched_get(struct ble_sched_state *state)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	int64_t left_ms = stay_until_ms - k_uptime_get();
+
+	state->active_ms = active_ms;
+	state->sleep_ms = sleep_ms;
+	state->stay_awake_s = (left_ms > 0) ? DIV_ROUND_UP((uint32_t)left_ms, MSEC_PER_SEC) : 0;
+	state->idle_cycles = idle_cycles;
+
+	k_spin_unlock(&lock, key);
+}
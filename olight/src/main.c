@@ -12,6 +12,8 @@
 #include "pdm.h"
 #include "pwm.h"
 #include "file.h"
+#include "ble_sched.h"
+#include "perf.h"
 
 #ifdef CONFIG_MCUMGR_GRP_FS
 #include <zephyr/device.h>
@@ -46,14 +48,26 @@ K_SEM_DEFINE(init_sem, 0, 1);  // Initial count 0, max count 1
 #define STORAGE_PARTITION_LABEL storage_partition
 #define STORAGE_PARTITION_ID FIXED_PARTITION_ID(STORAGE_PARTITION_LABEL)
 
-/* Define an example stats group; approximates seconds since boot. */
+/* Define an example stats group; counts BLE cycles and publishes the
+ * current advertising/sleep schedule.
+ */
 STATS_SECT_START(smp_svr_stats)
 STATS_SECT_ENTRY(ticks)
+STATS_SECT_ENTRY(active_ms)
+STATS_SECT_ENTRY(sleep_ms)
+STATS_SECT_ENTRY(stay_awake_s)
+STATS_SECT_ENTRY(idle_cycles)
+STATS_SECT_ENTRY(wake_lat_us)
 STATS_SECT_END;
 
-/* Assign a name to the `ticks` stat. */
+/* Assign names to the stats. */
 STATS_NAME_START(smp_svr_stats)
 STATS_NAME(smp_svr_stats, ticks)
+STATS_NAME(smp_svr_stats, active_ms)
+STATS_NAME(smp_svr_stats, sleep_ms)
+STATS_NAME(smp_svr_stats, stay_awake_s)
+STATS_NAME(smp_svr_stats, idle_cycles)
+STATS_NAME(smp_svr_stats, wake_lat_us)
 STATS_NAME_END(smp_svr_stats);
 
 /* Define an instance of the stats group. */
@@ -80,7 +94,19 @@ enum ble_state
 // Shared state variable
 static enum ble_state current_state = BLE_ACTIVE;
 
-// Thread function for BLE cycle
+static void publish_schedule(void)
+{
+	struct ble_sched_state sched;
+
+	ble_sched_get(&sched);
+	STATS_SET(smp_svr_stats, active_ms, sched.active_ms);
+	STATS_SET(smp_svr_stats, sleep_ms, sched.sleep_ms);
+	STATS_SET(smp_svr_stats, stay_awake_s, sched.stay_awake_s);
+	STATS_SET(smp_svr_stats, idle_cycles, sched.idle_cycles);
+	STATS_SET(smp_svr_stats, wake_lat_us, smp_bluetooth_wake_latency_us());
+}
+
+// Thread function for BLE cycle; window lengths come from ble_sched
 static void ble_cycle_thread(void *arg1, void *arg2, void *arg3)
 {
 	// Wait for main_init to complete
@@ -91,18 +117,20 @@ static void ble_cycle_thread(void *arg1, void *arg2, void *arg3)
 		switch (current_state)
 		{
 		case BLE_ACTIVE:
+			perf_inc(PERF_ADV_CYCLES);
 			start_smp_bluetooth_adverts();
-			k_sleep(K_MSEC(5000));
+			ble_sched_wait_active();
 			current_state = BLE_SLEEPING;
 			break;
 
 		case BLE_SLEEPING:
 			stop_smp_bluetooth_adverts();
-			k_sleep(K_MSEC(50000));
+			ble_sched_wait_sleep();
 			current_state = BLE_ACTIVE;
 			break;
 		}
 		STATS_INC(smp_svr_stats, ticks);
+		publish_schedule();
 	}
 }
 
@@ -154,6 +182,11 @@ static int main_init(void)
 		return 0;
 	}
 
+	if (IS_ENABLED(CONFIG_OLIGHT_LOG_BENCH))
+	{
+		(void)log_writer_bench();
+	}
+
 	return 1;
 }
 
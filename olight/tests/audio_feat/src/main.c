@@ -0,0 +1,143 @@
+/*
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <zephyr/ztest.h>
+
+#include "audio_feat.h"
+#include "pdm.h"
+
+#define SAMPLE_RATE 16000
+/* One 100 ms PDM block, three whole FFT frames. */
+#define BLOCK_LEN 1600
+#define AMPLITUDE 8000
+
+static int16_t block[BLOCK_LEN];
+
+/* The extractor registers itself at init; there is no capture pipeline here. */
+void pdm_consumer_register(struct pdm_consumer *consumer)
+{
+	ARG_UNUSED(consumer);
+}
+
+static void tone(uint32_t freq, int32_t amplitude)
+{
+	for (size_t i = 0; i < BLOCK_LEN; i++) {
+		/* Off phase, so no sample is exactly on a zero crossing. */
+		double phase = (2.0 * M_PI * freq * i) / SAMPLE_RATE + 0.3;
+
+		block[i] = (int16_t)lround(sin(phase) * amplitude);
+	}
+}
+
+static size_t loudest_band(const struct audio_feat *feat)
+{
+	size_t loudest = 0;
+
+	for (size_t b = 1; b < AUDIO_FEAT_BANDS; b++) {
+		if (feat->band[b] > feat->band[loudest]) {
+			loudest = b;
+		}
+	}
+
+	return loudest;
+}
+
+ZTEST(audio_feat, test_silence)
+{
+	struct audio_feat feat;
+
+	(void)memset(block, 0, sizeof(block));
+	audio_feat_compute(block, BLOCK_LEN, 7, &feat);
+
+	zassert_equal(feat.seq, 7);
+	zassert_equal(feat.rms, 0);
+	zassert_equal(feat.zcr, 0);
+
+	for (size_t b = 0; b < AUDIO_FEAT_BANDS; b++) {
+		zassert_equal(feat.band[b], 0, "band %zu", b);
+	}
+}
+
+ZTEST(audio_feat, test_rms_zcr)
+{
+	struct audio_feat feat;
+
+	tone(1000, AMPLITUDE);
+	audio_feat_compute(block, BLOCK_LEN, 0, &feat);
+
+	/* A / sqrt(2) for a sine. */
+	zassert_within(feat.rms, 5657, 10, "rms %u", feat.rms);
+	/* Two crossings per period: 2 * 1000 Hz / 16 kHz per sample. */
+	zassert_within(feat.zcr, 125, 1, "zcr %u", feat.zcr);
+
+	tone(250, AMPLITUDE);
+	audio_feat_compute(block, BLOCK_LEN, 0, &feat);
+
+	zassert_within(feat.rms, 5657, 10, "rms %u", feat.rms);
+	zassert_within(feat.zcr, 31, 1, "zcr %u", feat.zcr);
+}
+
+ZTEST(audio_feat, test_band_placement)
+{
+	/* One tone inside each octave band, none on an edge. */
+	static const uint32_t freqs[AUDIO_FEAT_BANDS] = {100, 400, 750, 1500, 3000, 6000};
+	struct audio_feat feat;
+
+	for (size_t b = 0; b < AUDIO_FEAT_BANDS; b++) {
+		tone(freqs[b], AMPLITUDE);
+		audio_feat_compute(block, BLOCK_LEN, 0, &feat);
+
+		zassert_equal(loudest_band(&feat), b, "%u Hz in band %zu", freqs[b],
+			      loudest_band(&feat));
+
+		/* Leakage into the other bands stays well below the tone, 6 dB at least. */
+		for (size_t o = 0; o < AUDIO_FEAT_BANDS; o++) {
+			if (o != b) {
+				zassert_true(feat.band[b] >= feat.band[o] + 512,
+					     "%u Hz: band %zu %u, band %zu %u", freqs[b], b,
+					     feat.band[b], o, feat.band[o]);
+			}
+		}
+	}
+}
+
+ZTEST(audio_feat, test_band_level)
+{
+	struct audio_feat quiet;
+	struct audio_feat loud;
+
+	tone(1500, AMPLITUDE / 2);
+	audio_feat_compute(block, BLOCK_LEN, 0, &quiet);
+	tone(1500, AMPLITUDE);
+	audio_feat_compute(block, BLOCK_LEN, 0, &loud);
+
+	/* Twice the amplitude is four times the energy, two doublings of 256. */
+	zassert_within(loud.band[3] - quiet.band[3], 512, 16, "%u -> %u", quiet.band[3],
+		       loud.band[3]);
+}
+
+ZTEST(audio_feat, test_short_block)
+{
+	struct audio_feat feat;
+
+	/* Less than one frame: no spectrum, but RMS and ZCR. */
+	tone(1000, AMPLITUDE);
+	audio_feat_compute(block, AUDIO_FEAT_FFT_LEN - 1, 0, &feat);
+
+	zassert_within(feat.rms, 5657, 20, "rms %u", feat.rms);
+	zassert_true(feat.zcr > 0);
+
+	for (size_t b = 0; b < AUDIO_FEAT_BANDS; b++) {
+		zassert_equal(feat.band[b], 0, "band %zu", b);
+	}
+
+	audio_feat_compute(block, 0, 3, &feat);
+	zassert_equal(feat.seq, 3);
+	zassert_equal(feat.rms, 0);
+}
+
+ZTEST_SUITE(audio_feat, NULL, NULL, NULL, NULL, NULL);